@@ -10,6 +10,17 @@ typedef void (*mmz_free_func)(void *opaque, void *address);
 enum { MMZ_NO_FLUSH = 0, MMZ_PARTIAL_FLUSH = 1, MMZ_SYNC_FLUSH = 2, MMZ_FULL_FLUSH = 3, MMZ_FINISH = 4, MMZ_BLOCK = 5 };
 enum { MMZ_OK = 0, MMZ_STREAM_END = 1, MMZ_NEED_DICT = 2, MMZ_ERRNO = -1, MMZ_STREAM_ERROR = -2, MMZ_DATA_ERROR = -3, MMZ_MEM_ERROR = -4, MMZ_BUF_ERROR = -5, MMZ_VERSION_ERROR = -6, MMZ_PARAM_ERROR = -10000 };
 #define MMZ_DEFAULT_WINDOW_BITS 15
+#define MMZ_DEFLATED 8
+enum { MMZ_NO_COMPRESSION = 0, MMZ_BEST_SPEED = 1, MMZ_BEST_COMPRESSION = 9, MMZ_UBER_COMPRESSION = 10, MMZ_DEFAULT_LEVEL = 6, MMZ_DEFAULT_COMPRESSION = -1 };
+enum { MMZ_DEFAULT_STRATEGY = 0, MMZ_FILTERED = 1, MMZ_HUFFMAN_ONLY = 2, MMZ_RLE = 3, MMZ_FIXED = 4 };
+// mmz_inflateInit2() window_bits: 8..15 for zlib streams, -8..-15 for raw deflate, 0 to take the window from the zlib header, plus 16 for gzip
+// streams or plus 32 to accept either zlib or gzip (detected from the first byte). The internal dictionary is 1 << (window_bits & 15) bytes
+// (32KB for 0), and a zlib header asking for a larger window fails with MMZ_DATA_ERROR. For gzip streams adler holds the CRC-32.
+// mmz_inflateSetOptions() flags. MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT: the caller promises all the output so far stays valid right before next_out, so
+// mmz_inflate decodes straight into next_out instead of through the internal dictionary. MMZ_INFLATE_OPT_MULTI_MEMBER: when a zlib/gzip member
+// (or raw deflate stream) ends and more input follows, decode the next one into the same output, checking each member's header and trailer.
+// MMZ_STREAM_END then means a member ended with no input left; feeding more input afterwards carries on with the next member.
+enum { MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT = 1, MMZ_INFLATE_OPT_MULTI_MEMBER = 2 };
 struct mmz_internal_state;
 typedef struct mmz_stream_s {
     const unsigned char *next_in;     // pointer to next byte to read
@@ -30,9 +41,68 @@ typedef struct mmz_stream_s {
 typedef mmz_stream *mmz_streamp;
 int mmz_inflateInit(mmz_streamp pStream);
 int mmz_inflateInit2(mmz_streamp pStream, int window_bits);
+// mmz_inflateReset() restarts a stream in place, keeping its window_bits and options. mmz_inflateReset2() also changes window_bits, reallocating
+// the state only if the new window doesn't fit.
+int mmz_inflateReset(mmz_streamp pStream);
+int mmz_inflateReset2(mmz_streamp pStream, int window_bits);
+// mmz_inflateEnd() keeps up to MMZ_INFLATE_STATE_POOL_SIZE (default 8) states with a full window from the default allocator for the next
+// mmz_inflateInit(). mmz_inflate_pool_release() frees them, say at exit so leak checkers stay quiet. Both are safe to call from any thread.
+void mmz_inflate_pool_release(void);
+int mmz_inflateSetOptions(mmz_streamp pStream, int options);
+// mmz_inflateSetDictionary() supplies a preset dictionary (only its last window's worth is used): for raw deflate before the first mmz_inflate()
+// call, for zlib streams once mmz_inflate() has returned MMZ_NEED_DICT with the dictionary's Adler-32 in adler (MMZ_DATA_ERROR if it doesn't match).
+// The dictionary is only read, so one copy can serve any number of streams. Decoding then always goes through the internal window, as if
+// MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT weren't set. The one-shot helpers below report streams needing a dictionary as MMZ_DATA_ERROR.
+int mmz_inflateSetDictionary(mmz_streamp pStream, const unsigned char *pDictionary, unsigned int dict_length);
 int mmz_inflate(mmz_streamp pStream, int flush);
+// mmz_inflateSkip() decodes like mmz_inflate() but throws away up to *pSkip output bytes instead of writing them (next_out/avail_out are left alone),
+// leaving the count it didn't reach in *pSkip. total_out, adler and the trailer checks work as usual. Not allowed with MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT.
+int mmz_inflateSkip(mmz_streamp pStream, mmz_ulong *pSkip, int flush);
 int mmz_inflateEnd(mmz_streamp pStream);
 int mmz_uncompress(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong source_len);
+// mmz_uncompress2() takes mmz_inflateInit2() window_bits and mmz_inflateSetOptions() options, and returns the number of input bytes used in *pSource_len.
+int mmz_uncompress2(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong *pSource_len, int window_bits, int options);
+// mmz_validate() checks a whole stream like mmz_uncompress2() without an output buffer, returning its decompressed size in *pDest_len.
+int mmz_validate(mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong *pSource_len, int window_bits, int options);
+// mmz_uncompress_parallel() inflates a whole stream in memory like mmz_uncompress2() (one member, no options) on up to num_threads threads, 0 meaning
+// one per core. Each thread looks for a likely dynamic block header in its share of the input and decodes from there with the unknown history as
+// markers, which are filled in once the data before it is known; chunks whose guess turns out wrong are redone serially. C builds use one thread.
+int mmz_uncompress_parallel(unsigned char *pDest, size_t *pDest_len, const unsigned char *pSource, size_t *pSource_len, int window_bits, int num_threads);
+// The compressor is a port of miniz's tdefl (with its original 3 byte hash chains) taking the same levels (0-10) and strategies as the mz_
+// functions of the same names.
+// Levels 1-3 parse greedily and level 1 uses the single probe fast path. Only window_bits 15 (zlib) and -15 (raw deflate) are supported,
+// mem_level is checked but ignored, and there's no gzip output or preset dictionary.
+int mmz_deflateInit(mmz_streamp pStream, int level);
+int mmz_deflateInit2(mmz_streamp pStream, int level, int method, int window_bits, int mem_level, int strategy);
+int mmz_deflateReset(mmz_streamp pStream);
+int mmz_deflate(mmz_streamp pStream, int flush);
+int mmz_deflateEnd(mmz_streamp pStream);
+// mmz_deflateBound() and mmz_compressBound() are (very) conservative limits on the output when flushing only with MMZ_FINISH.
+mmz_ulong mmz_deflateBound(mmz_streamp pStream, mmz_ulong source_len);
+int mmz_compress(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong source_len);
+int mmz_compress2(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong source_len, int level);
+mmz_ulong mmz_compressBound(mmz_ulong source_len);
+// mmz_compress_parallel() compresses like mmz_compress2() on up to num_threads threads (0: one per core) and still writes one zlib stream. The input
+// is cut into MMZ_COMPRESS_PARALLEL_CHUNK_SIZE pieces, each deflated with the 32 KB before it as history and ended with a sync flush (pigz style),
+// so the output is a little larger than mmz_compress2()'s but within mmz_compressBound(). The pieces are held on the heap until all are done.
+// Sets *pDest_len to the stream's size, or returns MMZ_BUF_ERROR if it doesn't fit. C builds use one thread.
+int mmz_compress_parallel(unsigned char *pDest, size_t *pDest_len, const unsigned char *pSource, size_t source_len, int level, int num_threads);
+// Frees buffers this file returns on the heap (mmz_index_serialize()).
+void mmz_free(void *p);
+// One buffer of a batch call. m_dest_len is the destination size going in and the bytes written coming out; mmz_uncompress_batch() also sets
+// m_source_len to the input used. m_status is what mmz_compress2() or mmz_uncompress2() would have returned for it.
+typedef struct {
+    const unsigned char *m_pSource;
+    size_t m_source_len;
+    unsigned char *m_pDest;
+    size_t m_dest_len;
+    int m_status;
+} mmz_batch_item;
+// mmz_compress_batch() and mmz_uncompress_batch() run mmz_compress2() / mmz_uncompress2() (no options) over many independent buffers. Items are
+// handed out one at a time to up to num_threads threads (0: one per core), each reusing a single compressor or inflate state for all it takes.
+// They return MMZ_OK if every item succeeded, else the first failed item's status (or MMZ_PARAM_ERROR with no item touched). C builds use one thread.
+int mmz_compress_batch(mmz_batch_item *pItems, size_t num_items, int level, int num_threads);
+int mmz_uncompress_batch(mmz_batch_item *pItems, size_t num_items, int window_bits, int num_threads);
 typedef unsigned char Byte;
 typedef unsigned int uInt;
 typedef mmz_ulong uLong;
@@ -52,6 +122,8 @@ typedef unsigned int mmz_uint;
 typedef long long mmz_int64;
 typedef unsigned long long mmz_uint64;
 typedef int mmz_bool;
+#define MMZ_FALSE (0)
+#define MMZ_TRUE (1)
 #ifdef _MSC_VER
 #define MMZ_MACRO_END while (0, 0)
 #else
@@ -61,36 +133,82 @@ enum {
     MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
     MMZ_TINFL_FLAG_HAS_MORE_INPUT = 2,
     MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
-    MMZ_TINFL_FLAG_COMPUTE_ADLER32 = 8
+    MMZ_TINFL_FLAG_COMPUTE_ADLER32 = 8,
+    MMZ_TINFL_FLAG_PARSE_GZIP_HEADER = 16, // with MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER too, the first byte picks the format
+    MMZ_TINFL_FLAG_STOP_AT_BLOCK = 32 // return MMZ_TINFL_STATUS_BLOCK_BOUNDARY before each block header
 };
 struct mmz_tinfl_decompressor_tag; typedef struct mmz_tinfl_decompressor_tag mmz_tinfl_decompressor;
 #define MMZ_TINFL_LZ_DICT_SIZE 32768
 typedef enum {
+    MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4, // the input ran out without MMZ_TINFL_FLAG_HAS_MORE_INPUT (a truncated stream)
     MMZ_TINFL_STATUS_BAD_PARAM = -3,
     MMZ_TINFL_STATUS_ADLER32_MISMATCH = -2,
     MMZ_TINFL_STATUS_FAILED = -1,
     MMZ_TINFL_STATUS_DONE = 0,
     MMZ_TINFL_STATUS_NEEDS_MORE_INPUT = 1,
-    MMZ_TINFL_STATUS_HAS_MORE_OUTPUT = 2
+    MMZ_TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+    MMZ_TINFL_STATUS_BLOCK_BOUNDARY = 3,
+    MMZ_TINFL_STATUS_NEEDS_DICT = 4 // the zlib header asked for a preset dictionary (Adler-32 in m_z_adler32); put it behind the output, call again
 } mmz_tinfl_status;
-#define mmz_tinfl_init(r) do { (r)->m_state = 0; } MMZ_MACRO_END
+#define mmz_tinfl_init(r) do { (r)->m_state = 0; (r)->m_window_size = MMZ_TINFL_LZ_DICT_SIZE; (r)->m_history = 0; } MMZ_MACRO_END
+// The CRC-32 for gzip streams.
 #define mmz_tinfl_get_adler32(r) (r)->m_check_adler32
 mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mmz_uint8 *pOut_buf_start, mmz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mmz_uint32 decomp_flags);
+// mmz_tinfl_init_at_block() sets up a raw deflate decoder to start at a block header, given the bits left over from the byte before it.
+// The history the stream needs must already be right behind the output position of the first call.
+void mmz_tinfl_init_at_block(mmz_tinfl_decompressor *r, mmz_uint32 bits, mmz_uint32 num_bits);
+// Random access index (zran style). mmz_index_build() inflates a whole zlib, gzip or raw deflate stream (window_bits as for mmz_inflateInit2(),
+// one member) and records a checkpoint at the first block boundary after every span output bytes: the input bit position plus the 32 KB of
+// history before it, kept raw deflated. mmz_index_extract() then inflates only from the nearest checkpoint at or before the wanted offset.
+// pRead reads up to len bytes at ofs into pBuf and returns how many it got, 0 at the end of the input.
+typedef size_t (*mmz_index_read_func)(void *pUser, mmz_uint64 ofs, void *pBuf, size_t len);
+typedef struct {
+    mmz_uint64 m_out_ofs, m_in_ofs;       // output offset of the block, input offset of its first whole byte
+    mmz_uint32 m_bits, m_num_bits;        // the block's first m_num_bits (0-7) bits, taken from the byte before m_in_ofs
+    mmz_uint32 m_window_size, m_comp_window_size;
+    mmz_uint8 *m_pComp_window;
+} mmz_index_point;
+typedef struct {
+    int m_window_bits;
+    mmz_uint32 m_num_points, m_capacity;
+    mmz_uint64 m_total_in, m_total_out;
+    mmz_index_point *m_pPoints;
+} mmz_index;
+int mmz_index_build(mmz_index **ppIndex, mmz_index_read_func pRead, void *pUser, int window_bits, mmz_uint64 span);
+// Inflates up to *pDest_len bytes starting at output offset ofs, setting *pDest_len to the count actually produced (short only at the end of the stream).
+int mmz_index_extract(const mmz_index *pIndex, mmz_index_read_func pRead, void *pUser, mmz_uint64 ofs, unsigned char *pDest, size_t *pDest_len);
+// The serialized form is varint coded with the windows still deflated. Release *ppBuf with mmz_free().
+int mmz_index_serialize(const mmz_index *pIndex, unsigned char **ppBuf, size_t *pBuf_len);
+int mmz_index_deserialize(mmz_index **ppIndex, const unsigned char *pBuf, size_t buf_len);
+void mmz_index_free(mmz_index *pIndex);
+// Huffman tables are a main table indexed by the next MMZ_TINFL_*_LOOKUP_BITS of the bit buffer plus subtables for longer codes (at most two loads per symbol).
+// MMZ_TINFL_HUFF_TABLE_SIZE is the lit/len worst case (zlib's "enough 288 10 15"); the distance ("enough 32 8 15" = 402) and code length tables always fit.
 enum {
     MMZ_TINFL_MAX_HUFF_TABLES = 3, MMZ_TINFL_MAX_HUFF_SYMBOLS_0 = 288, MMZ_TINFL_MAX_HUFF_SYMBOLS_1 = 32, MMZ_TINFL_MAX_HUFF_SYMBOLS_2 = 19,
-    MMZ_TINFL_FAST_LOOKUP_BITS = 10, MMZ_TINFL_FAST_LOOKUP_SIZE = 1 << MMZ_TINFL_FAST_LOOKUP_BITS
+    MMZ_TINFL_FAST_LOOKUP_BITS = 10, MMZ_TINFL_FAST_LOOKUP_SIZE = 1 << MMZ_TINFL_FAST_LOOKUP_BITS, MMZ_TINFL_DIST_LOOKUP_BITS = 8, MMZ_TINFL_CODE_SIZE_LOOKUP_BITS = 7,
+    MMZ_TINFL_HUFF_TABLE_SIZE = 1334
 };
+// Entries hold the code length in bits 0-3 and the symbol in bits 16-31, or with MMZ_TINFL_HUFF_SUBTABLE set, a subtable's index bits and start.
+// Literal entries of the lit/len table also carry a literal count in bits 4-5 and the literals in bits 8-31. Main table entries may pack two or three
+// literals whose codes fit in MMZ_TINFL_FAST_LOOKUP_BITS together; bits 0-3 are then their combined length.
+// Length and distance entries hold the base value in bits 16-31 and the extra bit count in bits 8-11 instead of the symbol. The invalid length
+// symbols 286-287 are end of block entries with a non-zero base, and the invalid distance symbols 30-31 have a base past any window.
+enum { MMZ_TINFL_HUFF_LITERALS = 0x30, MMZ_TINFL_HUFF_MULTI_LITERAL = 0x20, MMZ_TINFL_HUFF_END_OF_BLOCK = 0x40, MMZ_TINFL_HUFF_SUBTABLE = 0x80 };
 typedef struct {
-    mmz_uint8 m_code_size[TINFL_MAX_HUFF_SYMBOLS_0];
-    mmz_int16 m_look_up[TINFL_FAST_LOOKUP_SIZE], m_tree[TINFL_MAX_HUFF_SYMBOLS_0 * 2];
+    mmz_uint8 m_code_size[MMZ_TINFL_MAX_HUFF_SYMBOLS_0];
+    mmz_uint32 m_look_up[MMZ_TINFL_HUFF_TABLE_SIZE];
 } mmz_tinfl_huff_table;
 typedef mmz_uint64 mmz_tinfl_bit_buf_t;
 struct mmz_tinfl_decompressor_tag {
-    mmz_uint32 m_state, m_num_bits, m_zhdr0, m_zhdr1, m_z_adler32, m_final, m_type, m_check_adler32, m_dist, m_counter, m_num_extra, m_table_sizes[TINFL_MAX_HUFF_TABLES];
+    mmz_uint32 m_state, m_num_bits, m_zhdr0, m_zhdr1, m_z_adler32, m_final, m_type, m_check_adler32, m_dist, m_counter, m_num_extra, m_table_sizes[MMZ_TINFL_MAX_HUFF_TABLES];
+    mmz_uint32 m_gzip, m_gz_hcrc, m_gz_isize;
+    // The farthest back a match may reach (lower it after mmz_tinfl_init() for a smaller window), and how many bytes of history a wrapping
+    // buffer holds behind the output (set it for a preset dictionary); matches reaching past either fail.
+    mmz_uint32 m_window_size, m_history;
     mmz_tinfl_bit_buf_t m_bit_buf;
     size_t m_dist_from_out_buf_start;
-    mmz_tinfl_huff_table m_tables[TINFL_MAX_HUFF_TABLES];
-    mmz_uint8 m_raw_header[4], m_len_codes[TINFL_MAX_HUFF_SYMBOLS_0 + MMZ_TINFL_MAX_HUFF_SYMBOLS_1 + 137];
+    mmz_tinfl_huff_table m_tables[MMZ_TINFL_MAX_HUFF_TABLES];
+    mmz_uint8 m_raw_header[4], m_len_codes[MMZ_TINFL_MAX_HUFF_SYMBOLS_0 + MMZ_TINFL_MAX_HUFF_SYMBOLS_1 + 137];
 };
 enum {
     MMZ_TDEFL_WRITE_ZLIB_HEADER             = 0x01000,
@@ -102,6 +220,8 @@ enum {
     MMZ_TDEFL_FORCE_ALL_STATIC_BLOCKS       = 0x40000,
     MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS          = 0x80000
 };
+// The low 12 bits of the flags are the number of hash chain probes per match search (0 for Huffman only).
+enum { MMZ_TDEFL_HUFFMAN_ONLY = 0, MMZ_TDEFL_DEFAULT_MAX_PROBES = 128, MMZ_TDEFL_MAX_PROBES_MASK = 0xFFF };
 typedef mmz_bool (*mmz_tdefl_put_buf_func_ptr)(const void* pBuf, int len, void *pUser);
 enum { MMZ_TDEFL_MAX_HUFF_TABLES = 3, MMZ_TDEFL_MAX_HUFF_SYMBOLS_0 = 288, MMZ_TDEFL_MAX_HUFF_SYMBOLS_1 = 32, MMZ_TDEFL_MAX_HUFF_SYMBOLS_2 = 19, MMZ_TDEFL_LZ_DICT_SIZE = 32768, MMZ_TDEFL_LZ_DICT_SIZE_MASK = MMZ_TDEFL_LZ_DICT_SIZE - 1, MMZ_TDEFL_MIN_MATCH_LEN = 3, MMZ_TDEFL_MAX_MATCH_LEN = 258 };
 enum { MMZ_TDEFL_LZ_CODE_BUF_SIZE = 64 * 1024, MMZ_TDEFL_OUT_BUF_SIZE = (MMZ_TDEFL_LZ_CODE_BUF_SIZE * 13 ) / 10, MMZ_TDEFL_MAX_HUFF_SYMBOLS = 288, MMZ_TDEFL_LZ_HASH_BITS = 15, MMZ_TDEFL_LEVEL1_HASH_SIZE_MASK = 4095, MMZ_TDEFL_LZ_HASH_SHIFT = (MMZ_TDEFL_LZ_HASH_BITS + 2) / 3, MMZ_TDEFL_LZ_HASH_SIZE = 1 << MMZ_TDEFL_LZ_HASH_BITS };
@@ -133,15 +253,23 @@ typedef struct {
     mmz_tdefl_flush m_flush;
     const mmz_uint8 *m_pSrc;
     size_t m_src_buf_left, m_out_buf_ofs;
-    mmz_uint8 m_dict[TDEFL_LZ_DICT_SIZE + MMZ_TDEFL_MAX_MATCH_LEN - 1];
-    mmz_uint16 m_huff_count[TDEFL_MAX_HUFF_TABLES][TDEFL_MAX_HUFF_SYMBOLS];
-    mmz_uint16 m_huff_codes[TDEFL_MAX_HUFF_TABLES][TDEFL_MAX_HUFF_SYMBOLS];
-    mmz_uint8 m_huff_code_sizes[TDEFL_MAX_HUFF_TABLES][TDEFL_MAX_HUFF_SYMBOLS];
-    mmz_uint8 m_lz_code_buf[TDEFL_LZ_CODE_BUF_SIZE];
-    mmz_uint16 m_next[TDEFL_LZ_DICT_SIZE];
-    mmz_uint16 m_hash[TDEFL_LZ_HASH_SIZE];
-    mmz_uint8 m_output_buf[TDEFL_OUT_BUF_SIZE];
+    mmz_uint8 m_dict[MMZ_TDEFL_LZ_DICT_SIZE + MMZ_TDEFL_MAX_MATCH_LEN - 1];
+    mmz_uint16 m_huff_count[MMZ_TDEFL_MAX_HUFF_TABLES][MMZ_TDEFL_MAX_HUFF_SYMBOLS];
+    mmz_uint16 m_huff_codes[MMZ_TDEFL_MAX_HUFF_TABLES][MMZ_TDEFL_MAX_HUFF_SYMBOLS];
+    mmz_uint8 m_huff_code_sizes[MMZ_TDEFL_MAX_HUFF_TABLES][MMZ_TDEFL_MAX_HUFF_SYMBOLS];
+    mmz_uint8 m_lz_code_buf[MMZ_TDEFL_LZ_CODE_BUF_SIZE];
+    mmz_uint16 m_next[MMZ_TDEFL_LZ_DICT_SIZE];
+    mmz_uint16 m_hash[MMZ_TDEFL_LZ_HASH_SIZE];
+    mmz_uint8 m_output_buf[MMZ_TDEFL_OUT_BUF_SIZE];
 } mmz_tdefl_compressor;
+// Low-level interface, as tdefl_init()/tdefl_compress() in miniz.h. flags are MMZ_TDEFL_* bits plus the probe count.
+mmz_tdefl_status mmz_tdefl_init(mmz_tdefl_compressor *d, mmz_tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags);
+mmz_tdefl_status mmz_tdefl_compress(mmz_tdefl_compressor *d, const void *pIn_buf, size_t *pIn_buf_size, void *pOut_buf, size_t *pOut_buf_size, mmz_tdefl_flush flush);
+mmz_tdefl_status mmz_tdefl_compress_buffer(mmz_tdefl_compressor *d, const void *pIn_buf, size_t in_buf_size, mmz_tdefl_flush flush);
+mmz_tdefl_status mmz_tdefl_get_prev_return_status(mmz_tdefl_compressor *d);
+#define mmz_tdefl_get_adler32(d) (d)->m_adler32
+// Turns zlib style level (0-10), window_bits and strategy into mmz_tdefl_init() flags.
+mmz_uint mmz_tdefl_create_comp_flags_from_zip_params(int level, int window_bits, int strategy);
 #ifdef __cplusplus
 }
 #endif
@@ -151,11 +279,42 @@ typedef unsigned char mmz_validate_uint16[sizeof(mmz_uint16)==2 ? 1 : -1];
 typedef unsigned char mmz_validate_uint32[sizeof(mmz_uint32)==4 ? 1 : -1];
 typedef unsigned char mmz_validate_uint64[sizeof(mmz_uint64)==8 ? 1 : -1];
 #include <string.h>
+#include <assert.h>
+#if defined(__cplusplus) && !defined(MMZ_NO_THREADS)
+#include <atomic>
+#include <thread>
+#include <vector>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+// Same knob as miniz.h: MINIZ_NO_SIMD_ADLER32 keeps Adler-32 on the scalar loop instead of the runtime-selected SSSE3/AVX2 kernels.
+#ifndef MINIZ_NO_SIMD_ADLER32
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MMZ_SIMD_ADLER32 1
+#define MMZ_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define MMZ_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define MMZ_SIMD_ADLER32 1
+#define MMZ_TARGET_SSSE3
+#define MMZ_TARGET_AVX2
+#endif
+#endif
+#define MMZ_ASSERT(x) assert(x)
 #define MMZ_MAX(a,b) (((a)>(b))?(a):(b))
 #define MMZ_MIN(a,b) (((a)<(b))?(a):(b))
 #define MMZ_CLEAR_OBJ(obj) memset(&(obj), 0, sizeof(obj))
+#ifndef MMZ_MALLOC
+#define MMZ_MALLOC(x) malloc(x)
+#define MMZ_FREE(x) free(x)
+#define MMZ_REALLOC(p, x) realloc(p, x)
+#endif
 #define MMZ_READ_LE16(p) *((const mmz_uint16 *)(p))
 #define MMZ_READ_LE32(p) *((const mmz_uint32 *)(p))
+#define MMZ_READ_LE64(p) *((const mmz_uint64 *)(p))
 #ifdef _MSC_VER
 #define MMZ_FORCEINLINE __forceinline
 #elif defined(__GNUC__)
@@ -166,209 +325,784 @@ typedef unsigned char mmz_validate_uint64[sizeof(mmz_uint64)==8 ? 1 : -1];
 #ifdef __cplusplus
 extern "C" {
 #endif
+static void *mmz_def_alloc_func(void *opaque, size_t items, size_t size) { (void)opaque; return MMZ_MALLOC(items * size); }
+static void mmz_def_free_func(void *opaque, void *address) { (void)opaque; MMZ_FREE(address); }
+void mmz_free(void *p) {
+    MMZ_FREE(p);
+}
+#ifdef MMZ_SIMD_ADLER32
+enum { MMZ_CPU_SSSE3 = 1, MMZ_CPU_AVX2 = 2 };
+static int mmz_cpu_features(void) {
+#ifdef _MSC_VER
+    static volatile int s_features = -1; int features = s_features;
+    if (features < 0) {
+        int regs[4]; features = 0;
+        __cpuid(regs, 1);
+        if (regs[2] & (1 << 9)) features |= MMZ_CPU_SSSE3;
+        if ((regs[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6)) { __cpuidex(regs, 7, 0); if (regs[1] & (1 << 5)) features |= MMZ_CPU_AVX2; }
+        s_features = features;
+    }
+    return features;
+#else
+    return (__builtin_cpu_supports("ssse3") ? MMZ_CPU_SSSE3 : 0) | (__builtin_cpu_supports("avx2") ? MMZ_CPU_AVX2 : 0);
+#endif
+}
+// Sums whole 32 byte blocks and advances *pPtr past them; see mz_adler32_ssse3() in miniz.h.
+static MMZ_TARGET_SSSE3 mmz_uint32 mmz_adler32_ssse3(mmz_uint32 adler, const mmz_uint8 **pPtr, size_t num_blocks) {
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17), tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+    const mmz_uint8 *ptr = *pPtr; mmz_uint32 s1 = adler & 0xffff, s2 = adler >> 16;
+    while (num_blocks) {
+        size_t n = MMZ_MIN(num_blocks, 5552 / 32);
+        __m128i v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n)), v_s1 = zero, v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+        num_blocks -= n;
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)ptr), bytes2 = _mm_loadu_si128((const __m128i *)(ptr + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            ptr += 32;
+        } while (--n);
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1))); v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1))); v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + (mmz_uint32)_mm_cvtsi128_si32(v_s1)) % 65521U; s2 = (mmz_uint32)_mm_cvtsi128_si32(v_s2) % 65521U;
+    }
+    *pPtr = ptr;
+    return (s2 << 16) + s1;
+}
+static MMZ_TARGET_AVX2 mmz_uint32 mmz_adler32_avx2(mmz_uint32 adler, const mmz_uint8 **pPtr, size_t num_blocks) {
+    const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi16(1);
+    const mmz_uint8 *ptr = *pPtr; mmz_uint32 s1 = adler & 0xffff, s2 = adler >> 16;
+    while (num_blocks) {
+        size_t n = MMZ_MIN(num_blocks, 5552 / 32);
+        __m256i v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0), v_s1 = zero, v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+        __m128i s1_sum, s2_sum;
+        num_blocks -= n;
+        do {
+            const __m256i bytes = _mm256_loadu_si256((const __m256i *)ptr);
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+            ptr += 32;
+        } while (--n);
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+        s1_sum = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+        s2_sum = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+        s1_sum = _mm_add_epi32(s1_sum, _mm_shuffle_epi32(s1_sum, _MM_SHUFFLE(2, 3, 0, 1))); s1_sum = _mm_add_epi32(s1_sum, _mm_shuffle_epi32(s1_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2_sum = _mm_add_epi32(s2_sum, _mm_shuffle_epi32(s2_sum, _MM_SHUFFLE(2, 3, 0, 1))); s2_sum = _mm_add_epi32(s2_sum, _mm_shuffle_epi32(s2_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + (mmz_uint32)_mm_cvtsi128_si32(s1_sum)) % 65521U; s2 = (mmz_uint32)_mm_cvtsi128_si32(s2_sum) % 65521U;
+    }
+    *pPtr = ptr;
+    return (s2 << 16) + s1;
+}
+#endif
+static mmz_uint32 mmz_adler32(mmz_uint32 adler, const mmz_uint8 *ptr, size_t buf_len) {
+    mmz_uint32 i, s1, s2; size_t block_len;
+#ifdef MMZ_SIMD_ADLER32
+    if (buf_len >= 64) {
+        int features = mmz_cpu_features();
+        if (features & (MMZ_CPU_SSSE3 | MMZ_CPU_AVX2)) {
+            const mmz_uint8 *pEnd = ptr + buf_len;
+            adler = (features & MMZ_CPU_AVX2) ? mmz_adler32_avx2(adler, &ptr, buf_len / 32) : mmz_adler32_ssse3(adler, &ptr, buf_len / 32);
+            buf_len = pEnd - ptr;
+        }
+    }
+#endif
+    s1 = adler & 0xffff; s2 = adler >> 16; block_len = buf_len % 5552;
+    while (buf_len) {
+        for (i = 0; i + 7 < block_len; i += 8, ptr += 8) {
+            s1 += ptr[0], s2 += s1; s1 += ptr[1], s2 += s1; s1 += ptr[2], s2 += s1; s1 += ptr[3], s2 += s1;
+            s1 += ptr[4], s2 += s1; s1 += ptr[5], s2 += s1; s1 += ptr[6], s2 += s1; s1 += ptr[7], s2 += s1;
+        }
+        for ( ; i < block_len; ++i) s1 += *ptr++, s2 += s1;
+        s1 %= 65521U, s2 %= 65521U; buf_len -= block_len; block_len = 5552;
+    }
+    return (s2 << 16) + s1;
+}
+// CRC-32 for gzip, eight bytes per step. C++ builds the slicing tables once in a function-local static; C uses a 4 bit table like mz_crc32().
+#ifdef __cplusplus
+struct mmz_crc32_tables {
+    mmz_uint32 m_table[8][256];
+    mmz_crc32_tables() {
+        mmz_uint32 i, j, c;
+        for (i = 0; i < 256; i++) { for (c = i, j = 0; j < 8; j++) c = (c >> 1) ^ (0xEDB88320U & (0U - (c & 1))); m_table[0][i] = c; }
+        for (i = 0; i < 256; i++) for (j = 1; j < 8; j++) m_table[j][i] = (m_table[j - 1][i] >> 8) ^ m_table[0][m_table[j - 1][i] & 0xFF];
+    }
+};
+#endif
+static mmz_uint32 mmz_crc32(mmz_uint32 crc, const mmz_uint8 *ptr, size_t buf_len) {
+#ifdef __cplusplus
+    static const mmz_crc32_tables s_crc32;
+    const mmz_uint32 (*t)[256] = s_crc32.m_table;
+    crc = ~crc;
+    for ( ; buf_len >= 8; buf_len -= 8, ptr += 8) {
+        mmz_uint32 lo = MMZ_READ_LE32(ptr) ^ crc, hi = MMZ_READ_LE32(ptr + 4);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    while (buf_len--) crc = (crc >> 8) ^ t[0][(crc ^ *ptr++) & 0xFF];
+#else
+    static const mmz_uint32 s_crc32[16] = { 0, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c };
+    crc = ~crc;
+    while (buf_len--) { mmz_uint8 b = *ptr++; crc = (crc >> 4) ^ s_crc32[(crc & 0xF) ^ (b & 0xF)]; crc = (crc >> 4) ^ s_crc32[(crc & 0xF) ^ (b >> 4)]; }
+#endif
+    return ~crc;
+}
 typedef struct {
     mmz_tinfl_decompressor m_decomp;
-    mmz_uint m_dict_ofs, m_dict_avail, m_first_call, m_has_flushed; int m_window_bits;
-    mmz_uint8 m_dict[TINFL_LZ_DICT_SIZE];
+    mmz_uint m_dict_ofs, m_dict_avail, m_dict_size, m_dict_capacity, m_first_call, m_has_flushed, m_member_done, m_need_dict, m_has_preset_dict; int m_window_bits;
+    mmz_uint8 *m_dict; // m_dict_capacity bytes, allocated right after the state
     mmz_tinfl_status m_last_status;
+    int m_options; mmz_uint8 *m_pOut_buf_start, *m_pOut_buf_next;
 } mmz_inflate_state;
-int mmz_inflateInit2(mmz_streamp pStream, int window_bits) {
-    mmz_inflate_state *pDecomp;
-    if (!pStream) return MMZ_STREAM_ERROR;
-    if ((window_bits != MMZ_DEFAULT_WINDOW_BITS) && (-window_bits != MMZ_DEFAULT_WINDOW_BITS)) return MMZ_PARAM_ERROR;
+// States with a full size dictionary allocated through the default allocator are recycled through a small pool instead of being freed, so
+// one-shot callers like mmz_uncompress() skip malloc/free. A spinlock guards the pool (it's only held to move a pointer), and
+// mmz_inflate_pool_release() frees what it holds. Define MMZ_INFLATE_STATE_POOL_SIZE to 0 to disable it.
+#ifndef MMZ_INFLATE_STATE_POOL_SIZE
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define MMZ_INFLATE_STATE_POOL_SIZE 8
+#else
+#define MMZ_INFLATE_STATE_POOL_SIZE 0
+#endif
+#endif
+#if MMZ_INFLATE_STATE_POOL_SIZE
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MMZ_SPIN_LOCK(p) do { while (_InterlockedExchange((p), 1)) { } } MMZ_MACRO_END
+#define MMZ_SPIN_UNLOCK(p) _InterlockedExchange((p), 0)
+#else
+#define MMZ_SPIN_LOCK(p) do { while (__sync_lock_test_and_set((p), 1)) { } } MMZ_MACRO_END
+#define MMZ_SPIN_UNLOCK(p) __sync_lock_release(p)
+#endif
+static volatile long s_mmz_inflate_pool_lock;
+static mmz_inflate_state *s_mmz_inflate_state_pool[MMZ_INFLATE_STATE_POOL_SIZE];
+static int s_mmz_inflate_pool_count;
+static mmz_inflate_state *mmz_inflate_pool_take(void) {
+    mmz_inflate_state *pState = NULL;
+    MMZ_SPIN_LOCK(&s_mmz_inflate_pool_lock);
+    if (s_mmz_inflate_pool_count) pState = s_mmz_inflate_state_pool[--s_mmz_inflate_pool_count];
+    MMZ_SPIN_UNLOCK(&s_mmz_inflate_pool_lock);
+    return pState;
+}
+static mmz_bool mmz_inflate_pool_give(mmz_inflate_state *pState) {
+    mmz_bool pooled = MMZ_FALSE;
+    MMZ_SPIN_LOCK(&s_mmz_inflate_pool_lock);
+    if (s_mmz_inflate_pool_count < MMZ_INFLATE_STATE_POOL_SIZE) { s_mmz_inflate_state_pool[s_mmz_inflate_pool_count++] = pState; pooled = MMZ_TRUE; }
+    MMZ_SPIN_UNLOCK(&s_mmz_inflate_pool_lock);
+    return pooled;
+}
+#endif
+void mmz_inflate_pool_release(void) {
+#if MMZ_INFLATE_STATE_POOL_SIZE
+    mmz_inflate_state *pState;
+    while ((pState = mmz_inflate_pool_take()) != NULL) mmz_def_free_func(NULL, pState);
+#endif
+}
+// Returns the log2 window size window_bits asks for, or 0 if it's invalid. A zero window (zlib style "from the header") means the largest.
+static int mmz_inflate_window_log2(int window_bits) {
+    int bits = (window_bits < 0) ? -window_bits : ((window_bits >= 16) && (window_bits < 48)) ? (window_bits & 15) : window_bits;
+    if ((!bits) && (window_bits >= 0)) bits = MMZ_DEFAULT_WINDOW_BITS;
+    return ((bits < 8) || (bits > MMZ_DEFAULT_WINDOW_BITS)) ? 0 : bits;
+}
+static mmz_uint mmz_inflate_dict_size(int *pWindow_bits) {
+    int bits;
+    if (!*pWindow_bits) *pWindow_bits = MMZ_DEFAULT_WINDOW_BITS;
+    if (!(bits = mmz_inflate_window_log2(*pWindow_bits))) return 0;
+    return 1U << bits;
+}
+static void mmz_inflate_state_reset(mmz_streamp pStream, mmz_inflate_state *pDecomp, int window_bits, mmz_uint dict_size) {
     pStream->data_type = 0;
     pStream->adler = 0;
     pStream->msg = NULL;
     pStream->total_in = 0;
     pStream->total_out = 0;
     pStream->reserved = 0;
-    if (!pStream->zalloc) pStream->zalloc = def_alloc_func;
-    if (!pStream->zfree) pStream->zfree = def_free_func;
-    pDecomp = (mmz_inflate_state*)pStream->zalloc(pStream->opaque, 1, sizeof(mmz_inflate_state));
-    if (!pDecomp) return MMZ_MEM_ERROR;
-    pStream->state = (struct mmz_internal_state *)pDecomp;
     mmz_tinfl_init(&pDecomp->m_decomp);
+    pDecomp->m_decomp.m_window_size = dict_size;
+    pDecomp->m_dict_size = dict_size;
     pDecomp->m_dict_ofs = 0;
     pDecomp->m_dict_avail = 0;
     pDecomp->m_last_status = MMZ_TINFL_STATUS_NEEDS_MORE_INPUT;
     pDecomp->m_first_call = 1;
     pDecomp->m_has_flushed = 0;
+    pDecomp->m_member_done = 0;
+    pDecomp->m_need_dict = pDecomp->m_has_preset_dict = 0;
     pDecomp->m_window_bits = window_bits;
+    pDecomp->m_pOut_buf_start = pDecomp->m_pOut_buf_next = NULL;
+}
+static mmz_inflate_state *mmz_inflate_state_alloc(mmz_streamp pStream, mmz_uint dict_size) {
+    mmz_inflate_state *pDecomp = NULL;
+#if MMZ_INFLATE_STATE_POOL_SIZE
+    if ((dict_size == MMZ_TINFL_LZ_DICT_SIZE) && (pStream->zalloc == mmz_def_alloc_func) && (pStream->zfree == mmz_def_free_func)) pDecomp = mmz_inflate_pool_take();
+#endif
+    if (!pDecomp) {
+        pDecomp = (mmz_inflate_state*)pStream->zalloc(pStream->opaque, 1, sizeof(mmz_inflate_state) + dict_size);
+        if (!pDecomp) return NULL;
+        pDecomp->m_dict = (mmz_uint8 *)(pDecomp + 1);
+        pDecomp->m_dict_capacity = dict_size;
+    }
+    pDecomp->m_options = 0;
+    return pDecomp;
+}
+static void mmz_inflate_state_free(mmz_streamp pStream, mmz_inflate_state *pDecomp) {
+#if MMZ_INFLATE_STATE_POOL_SIZE
+    if ((pDecomp->m_dict_capacity == MMZ_TINFL_LZ_DICT_SIZE) && (pStream->zalloc == mmz_def_alloc_func) && (pStream->zfree == mmz_def_free_func) && (mmz_inflate_pool_give(pDecomp))) return;
+#endif
+    pStream->zfree(pStream->opaque, pDecomp);
+}
+int mmz_inflateInit2(mmz_streamp pStream, int window_bits) {
+    mmz_inflate_state *pDecomp; mmz_uint dict_size;
+    if (!pStream) return MMZ_STREAM_ERROR;
+    if (!(dict_size = mmz_inflate_dict_size(&window_bits))) return MMZ_PARAM_ERROR;
+    if (!pStream->zalloc) pStream->zalloc = mmz_def_alloc_func;
+    if (!pStream->zfree) pStream->zfree = mmz_def_free_func;
+    pDecomp = mmz_inflate_state_alloc(pStream, dict_size);
+    if (!pDecomp) return MMZ_MEM_ERROR;
+    pStream->state = (struct mmz_internal_state *)pDecomp;
+    mmz_inflate_state_reset(pStream, pDecomp, window_bits, dict_size);
     return MMZ_OK;
 }
 int mmz_inflateInit(mmz_streamp pStream) {
     return mmz_inflateInit2(pStream, MMZ_DEFAULT_WINDOW_BITS);
 }
-int mmz_inflate(mmz_streamp pStream, int flush) {
-    mmz_inflate_state* pState;
-    mmz_uint n, first_call, decomp_flags = MMZ_TINFL_FLAG_COMPUTE_ADLER32;
-    size_t in_bytes, out_bytes, orig_avail_in;
-    mmz_tinfl_status status;
+int mmz_inflateReset(mmz_streamp pStream) {
+    mmz_inflate_state *pDecomp;
     if ((!pStream) || (!pStream->state)) return MMZ_STREAM_ERROR;
-    if (flush == MMZ_PARTIAL_FLUSH) flush = MMZ_SYNC_FLUSH;
-    if ((flush) && (flush != MMZ_SYNC_FLUSH) && (flush != MMZ_FINISH)) return MMZ_STREAM_ERROR;
-    pState = (mmz_inflate_state*)pStream->state;
-    if (pState->m_window_bits > 0) decomp_flags |= MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER;
-    orig_avail_in = pStream->avail_in;
-    first_call = pState->m_first_call; pState->m_first_call = 0;
-    if (pState->m_last_status < 0) return MMZ_DATA_ERROR;
-    if (pState->m_has_flushed && (flush != MMZ_FINISH)) return MMZ_STREAM_ERROR;
-    pState->m_has_flushed |= (flush == MMZ_FINISH);
-    if ((flush == MMZ_FINISH) && (first_call)) {
-        decomp_flags |= MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
-        in_bytes = pStream->avail_in; out_bytes = pStream->avail_out;
-        status = mmz_tinfl_decompress(&pState->m_decomp, pStream->next_in, &in_bytes, pStream->next_out, pStream->next_out, &out_bytes, decomp_flags);
-        pState->m_last_status = status;
-        pStream->next_in += (mmz_uint)in_bytes; pStream->avail_in -= (mmz_uint)in_bytes; pStream->total_in += (mmz_uint)in_bytes;
-        pStream->adler = mmz_tinfl_get_adler32(&pState->m_decomp);
-        pStream->next_out += (mmz_uint)out_bytes; pStream->avail_out -= (mmz_uint)out_bytes; pStream->total_out += (mmz_uint)out_bytes;
-        if (status < 0)
-            return MMZ_DATA_ERROR;
-        else if (status != MMZ_TINFL_STATUS_DONE) {
-            pState->m_last_status = MMZ_TINFL_STATUS_FAILED;
-            return MMZ_BUF_ERROR;
-        }
-        return MMZ_STREAM_END;
+    pDecomp = (mmz_inflate_state*)pStream->state;
+    mmz_inflate_state_reset(pStream, pDecomp, pDecomp->m_window_bits, pDecomp->m_dict_size);
+    return MMZ_OK;
+}
+int mmz_inflateReset2(mmz_streamp pStream, int window_bits) {
+    mmz_inflate_state *pDecomp; mmz_uint dict_size;
+    if ((!pStream) || (!pStream->state)) return MMZ_STREAM_ERROR;
+    if (!(dict_size = mmz_inflate_dict_size(&window_bits))) return MMZ_PARAM_ERROR;
+    pDecomp = (mmz_inflate_state*)pStream->state;
+    if (dict_size > pDecomp->m_dict_capacity) {
+        int options = pDecomp->m_options;
+        if (!(pDecomp = mmz_inflate_state_alloc(pStream, dict_size))) return MMZ_MEM_ERROR;
+        mmz_inflate_state_free(pStream, (mmz_inflate_state*)pStream->state);
+        pStream->state = (struct mmz_internal_state *)pDecomp;
+        pDecomp->m_options = options;
     }
-    // flush != MMZ_FINISH then we must assume there's more input.
-    if (flush != MMZ_FINISH) decomp_flags |= MMZ_TINFL_FLAG_HAS_MORE_INPUT;
+    mmz_inflate_state_reset(pStream, pDecomp, window_bits, dict_size);
+    return MMZ_OK;
+}
+int mmz_inflateSetOptions(mmz_streamp pStream, int options) {
+    mmz_inflate_state *pState;
+    if ((!pStream) || (!pStream->state) || (options & ~(MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT | MMZ_INFLATE_OPT_MULTI_MEMBER))) return MMZ_STREAM_ERROR;
+    pState = (mmz_inflate_state*)pStream->state;
+    // The output path can't change once mmz_inflate() has produced output through it.
+    if (!pState->m_first_call) return MMZ_STREAM_ERROR;
+    pState->m_options = options;
+    return MMZ_OK;
+}
+// The wrapping decoder rejects a zlib header whose window doesn't fit the dictionary, but the non-wrapping paths never look, so check it here too.
+static mmz_tinfl_status mmz_inflate_check_window(const mmz_inflate_state *pState, mmz_tinfl_status status) {
+    if ((status >= 0) && (pState->m_window_bits > 0) && (pState->m_decomp.m_state > 2) && (!pState->m_decomp.m_gzip) && ((8 + (int)(pState->m_decomp.m_zhdr0 >> 4)) > mmz_inflate_window_log2(pState->m_window_bits)))
+        return MMZ_TINFL_STATUS_FAILED;
+    return status;
+}
+// Restarts the decoder for the next member of a MMZ_INFLATE_OPT_MULTI_MEMBER stream. Its matches can't reach back into earlier members.
+static void mmz_inflate_next_member(mmz_inflate_state *pState) {
+    mmz_tinfl_init(&pState->m_decomp);
+    pState->m_decomp.m_window_size = pState->m_dict_size;
+    pState->m_member_done = 0;
+    pState->m_last_status = MMZ_TINFL_STATUS_NEEDS_MORE_INPUT;
+    pState->m_pOut_buf_start = pState->m_pOut_buf_next;
+}
+static int mmz_inflate_need_dict(mmz_streamp pStream, mmz_inflate_state *pState) {
+    pState->m_need_dict = 1; pStream->adler = pState->m_decomp.m_z_adler32;
+    return MMZ_NEED_DICT;
+}
+// Copies out as much of the dictionary's pending output as fits, or just drops it when ppNext_out is NULL.
+static void mmz_inflate_drain_dict(mmz_streamp pStream, mmz_inflate_state *pState, unsigned char **ppNext_out, mmz_ulong *pAvail_out) {
+    mmz_uint n = (mmz_uint)MMZ_MIN(pState->m_dict_avail, *pAvail_out);
+    if (ppNext_out) { memcpy(*ppNext_out, pState->m_dict + pState->m_dict_ofs, n); *ppNext_out += n; }
+    *pAvail_out -= n; pStream->total_out += n;
+    pState->m_dict_avail -= n; pState->m_dict_ofs = (pState->m_dict_ofs + n) & (pState->m_dict_size - 1);
+}
+// The wrapping path: decode into the internal dictionary and drain it into *ppNext_out (or drop it, see mmz_inflate_drain_dict()).
+static int mmz_inflate_dict(mmz_streamp pStream, mmz_inflate_state *pState, int flush, mmz_uint decomp_flags, size_t orig_avail_in, unsigned char **ppNext_out, mmz_ulong *pAvail_out) {
+    mmz_tinfl_status status;
     if (pState->m_dict_avail) {
-        n = MMZ_MIN(pState->m_dict_avail, pStream->avail_out);
-        memcpy(pStream->next_out, pState->m_dict + pState->m_dict_ofs, n);
-        pStream->next_out += n; pStream->avail_out -= n; pStream->total_out += n;
-        pState->m_dict_avail -= n; pState->m_dict_ofs = (pState->m_dict_ofs + n) & (TINFL_LZ_DICT_SIZE - 1);
-        return ((pState->m_last_status == MMZ_TINFL_STATUS_DONE) && (!pState->m_dict_avail)) ? MMZ_STREAM_END : MMZ_OK;
+        mmz_inflate_drain_dict(pStream, pState, ppNext_out, pAvail_out);
+        return ((pState->m_last_status == MMZ_TINFL_STATUS_DONE) && (!pState->m_dict_avail) && (!(pState->m_member_done && pStream->avail_in))) ? MMZ_STREAM_END : MMZ_OK;
     }
     for ( ; ; ) {
-        in_bytes = pStream->avail_in;
-        out_bytes = MMZ_TINFL_LZ_DICT_SIZE - pState->m_dict_ofs;
+        size_t in_bytes = pStream->avail_in;
+        size_t out_bytes = pState->m_dict_size - pState->m_dict_ofs;
         status = mmz_tinfl_decompress(&pState->m_decomp, pStream->next_in, &in_bytes, pState->m_dict, pState->m_dict + pState->m_dict_ofs, &out_bytes, decomp_flags);
         pState->m_last_status = status;
         pStream->next_in += (mmz_uint)in_bytes; pStream->avail_in -= (mmz_uint)in_bytes;
         pStream->total_in += (mmz_uint)in_bytes; pStream->adler = mmz_tinfl_get_adler32(&pState->m_decomp);
         pState->m_dict_avail = (mmz_uint)out_bytes;
-        n = MMZ_MIN(pState->m_dict_avail, pStream->avail_out);
-        memcpy(pStream->next_out, pState->m_dict + pState->m_dict_ofs, n);
-        pStream->next_out += n; pStream->avail_out -= n; pStream->total_out += n;
-        pState->m_dict_avail -= n; pState->m_dict_ofs = (pState->m_dict_ofs + n) & (TINFL_LZ_DICT_SIZE - 1);
+        mmz_inflate_drain_dict(pStream, pState, ppNext_out, pAvail_out);
+        if (status == MMZ_TINFL_STATUS_NEEDS_DICT)
+            return mmz_inflate_need_dict(pStream, pState);
+        if (status == MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS) {
+            // MMZ_FINISH with the input cut short. Like zlib, report it as MMZ_BUF_ERROR and let a later call resume with more input.
+            pState->m_last_status = MMZ_TINFL_STATUS_NEEDS_MORE_INPUT;
+            return MMZ_BUF_ERROR;
+        }
         if (status < 0)
             return MMZ_DATA_ERROR; // Stream is corrupted (there could be some uncompressed data left in the output dictionary - oh well).
-        else if ((status == MMZ_TINFL_STATUS_NEEDS_MORE_INPUT) && (!orig_avail_in))
+        if ((status == MMZ_TINFL_STATUS_DONE) && (pState->m_options & MMZ_INFLATE_OPT_MULTI_MEMBER)) {
+            pState->m_member_done = 1;
+            if ((pStream->avail_in) && (!pState->m_dict_avail)) { mmz_inflate_next_member(pState); continue; }
+        }
+        if ((status == MMZ_TINFL_STATUS_NEEDS_MORE_INPUT) && (!orig_avail_in))
             return MMZ_BUF_ERROR; // Signal caller that we can't make forward progress without supplying more input or by setting flush to MMZ_FINISH.
         else if (flush == MMZ_FINISH) {
             if (status == MMZ_TINFL_STATUS_DONE)
                 return pState->m_dict_avail ? MMZ_BUF_ERROR : MMZ_STREAM_END;
-            else if (!pStream->avail_out)
-                return MMZ_BUF_ERROR;
+            else if ((!*pAvail_out) || ((!in_bytes) && (!out_bytes)))
+                return MMZ_BUF_ERROR; // Out of room, or stuck: a skip with no upper bound mustn't spin on a call that made no progress.
         }
-        else if ((status == MMZ_TINFL_STATUS_DONE) || (!pStream->avail_in) || (!pStream->avail_out) || (pState->m_dict_avail))
+        else if ((status == MMZ_TINFL_STATUS_DONE) || (!pStream->avail_in) || (!*pAvail_out) || (pState->m_dict_avail))
             break;
     }
     return ((status == MMZ_TINFL_STATUS_DONE) && (!pState->m_dict_avail)) ? MMZ_STREAM_END : MMZ_OK;
 }
+// pSkip == NULL: mmz_inflate(). Otherwise decode through the dictionary only, dropping up to *pSkip bytes instead of writing to next_out.
+static int mmz_inflate_impl(mmz_streamp pStream, int flush, mmz_ulong *pSkip) {
+    mmz_inflate_state* pState;
+    mmz_uint first_call, decomp_flags = MMZ_TINFL_FLAG_COMPUTE_ADLER32;
+    size_t in_bytes, out_bytes, orig_avail_in;
+    mmz_ulong avail_out;
+    unsigned char **ppNext_out;
+    mmz_tinfl_status status;
+    int result;
+    if ((!pStream) || (!pStream->state)) return MMZ_STREAM_ERROR;
+    if (flush == MMZ_PARTIAL_FLUSH) flush = MMZ_SYNC_FLUSH;
+    if ((flush) && (flush != MMZ_SYNC_FLUSH) && (flush != MMZ_FINISH)) return MMZ_STREAM_ERROR;
+    pState = (mmz_inflate_state*)pStream->state;
+    if ((pSkip) && (pState->m_options & MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT)) return MMZ_STREAM_ERROR;
+    if (pState->m_window_bits > 0) decomp_flags |= (pState->m_window_bits < 16) ? MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER : (pState->m_window_bits < 32) ? MMZ_TINFL_FLAG_PARSE_GZIP_HEADER : (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_PARSE_GZIP_HEADER);
+    orig_avail_in = pStream->avail_in;
+    first_call = pState->m_first_call; pState->m_first_call = 0;
+    if (pState->m_last_status < 0) return MMZ_DATA_ERROR;
+    if (pState->m_need_dict) return MMZ_NEED_DICT;
+    if (pState->m_has_flushed && (flush != MMZ_FINISH)) return MMZ_STREAM_ERROR;
+    pState->m_has_flushed |= (flush == MMZ_FINISH);
+    if ((pState->m_member_done) && (!pState->m_dict_avail)) {
+        if (!pStream->avail_in) return MMZ_STREAM_END;
+        mmz_inflate_next_member(pState);
+    }
+    if ((pState->m_options & MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT) && (!pState->m_has_preset_dict)) {
+        // Decode in place: the caller's buffer is the history, so a match can reach back to the first byte ever written.
+        if (first_call)
+            pState->m_pOut_buf_start = pState->m_pOut_buf_next = pStream->next_out;
+        else if (pStream->next_out != pState->m_pOut_buf_next)
+            return MMZ_STREAM_ERROR;
+        decomp_flags |= MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+        if (flush != MMZ_FINISH) decomp_flags |= MMZ_TINFL_FLAG_HAS_MORE_INPUT;
+        for ( ; ; ) {
+            in_bytes = pStream->avail_in; out_bytes = pStream->avail_out;
+            status = mmz_inflate_check_window(pState, mmz_tinfl_decompress(&pState->m_decomp, pStream->next_in, &in_bytes, pState->m_pOut_buf_start, pStream->next_out, &out_bytes, decomp_flags));
+            pState->m_last_status = status;
+            pStream->next_in += (mmz_uint)in_bytes; pStream->avail_in -= (mmz_uint)in_bytes; pStream->total_in += (mmz_uint)in_bytes;
+            pStream->adler = mmz_tinfl_get_adler32(&pState->m_decomp);
+            pStream->next_out += (mmz_uint)out_bytes; pStream->avail_out -= (mmz_uint)out_bytes; pStream->total_out += (mmz_uint)out_bytes;
+            pState->m_pOut_buf_next = pStream->next_out;
+            if (status == MMZ_TINFL_STATUS_NEEDS_DICT) return mmz_inflate_need_dict(pStream, pState);
+            if ((status != MMZ_TINFL_STATUS_DONE) || (!(pState->m_options & MMZ_INFLATE_OPT_MULTI_MEMBER))) break;
+            if (!pStream->avail_in) { pState->m_member_done = 1; break; }
+            mmz_inflate_next_member(pState);
+        }
+        if (status == MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS) {
+            pState->m_last_status = MMZ_TINFL_STATUS_NEEDS_MORE_INPUT;
+            return MMZ_BUF_ERROR;
+        } else if (status < 0)
+            return MMZ_DATA_ERROR;
+        else if (status == MMZ_TINFL_STATUS_DONE)
+            return MMZ_STREAM_END;
+        else if (((status == MMZ_TINFL_STATUS_NEEDS_MORE_INPUT) && (!orig_avail_in)) || (flush == MMZ_FINISH))
+            return MMZ_BUF_ERROR;
+        return MMZ_OK;
+    }
+    if ((flush == MMZ_FINISH) && (first_call) && (!pSkip)) {
+        decomp_flags |= MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+        for ( ; ; ) {
+            in_bytes = pStream->avail_in; out_bytes = pStream->avail_out;
+            status = mmz_inflate_check_window(pState, mmz_tinfl_decompress(&pState->m_decomp, pStream->next_in, &in_bytes, pStream->next_out, pStream->next_out, &out_bytes, decomp_flags));
+            pState->m_last_status = status;
+            pStream->next_in += (mmz_uint)in_bytes; pStream->avail_in -= (mmz_uint)in_bytes; pStream->total_in += (mmz_uint)in_bytes;
+            pStream->adler = mmz_tinfl_get_adler32(&pState->m_decomp);
+            pStream->next_out += (mmz_uint)out_bytes; pStream->avail_out -= (mmz_uint)out_bytes; pStream->total_out += (mmz_uint)out_bytes;
+            if (status == MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS)
+                return MMZ_BUF_ERROR;
+            else if (status < 0)
+                return MMZ_DATA_ERROR;
+            else if (status == MMZ_TINFL_STATUS_NEEDS_DICT)
+                return mmz_inflate_need_dict(pStream, pState);
+            else if (status != MMZ_TINFL_STATUS_DONE) {
+                pState->m_last_status = MMZ_TINFL_STATUS_FAILED;
+                return MMZ_BUF_ERROR;
+            }
+            if (!(pState->m_options & MMZ_INFLATE_OPT_MULTI_MEMBER)) break;
+            if (!pStream->avail_in) { pState->m_member_done = 1; break; }
+            mmz_inflate_next_member(pState);
+        }
+        return MMZ_STREAM_END;
+    }
+    // flush != MMZ_FINISH then we must assume there's more input.
+    if (flush != MMZ_FINISH) decomp_flags |= MMZ_TINFL_FLAG_HAS_MORE_INPUT;
+    avail_out = pSkip ? *pSkip : pStream->avail_out;
+    ppNext_out = pSkip ? NULL : &pStream->next_out;
+    result = mmz_inflate_dict(pStream, pState, flush, decomp_flags, orig_avail_in, ppNext_out, &avail_out);
+    if (pSkip) *pSkip = avail_out; else pStream->avail_out = (mmz_uint)avail_out;
+    return result;
+}
+int mmz_inflate(mmz_streamp pStream, int flush) {
+    return mmz_inflate_impl(pStream, flush, NULL);
+}
+int mmz_inflateSetDictionary(mmz_streamp pStream, const unsigned char *pDictionary, unsigned int dict_length) {
+    mmz_inflate_state *pState;
+    mmz_uint n;
+    if ((!pStream) || (!pStream->state) || ((!pDictionary) && (dict_length))) return MMZ_STREAM_ERROR;
+    pState = (mmz_inflate_state*)pStream->state;
+    if (pState->m_need_dict) {
+        if (mmz_adler32(1, pDictionary, dict_length) != pState->m_decomp.m_z_adler32) return MMZ_DATA_ERROR;
+    } else if ((pState->m_window_bits > 0) || (!pState->m_first_call))
+        return MMZ_STREAM_ERROR;
+    // Nothing has been decoded yet, so the dictionary simply becomes the window's first bytes and the output starts right after it.
+    n = MMZ_MIN(dict_length, pState->m_dict_size);
+    if (n) memcpy(pState->m_dict, pDictionary + dict_length - n, n);
+    pState->m_dict_ofs = n & (pState->m_dict_size - 1); pState->m_dict_avail = 0; pState->m_decomp.m_history = n;
+    pState->m_need_dict = 0; pState->m_has_preset_dict = 1; pState->m_first_call = 0;
+    return MMZ_OK;
+}
+int mmz_inflateSkip(mmz_streamp pStream, mmz_ulong *pSkip, int flush) {
+    if (!pSkip) return MMZ_STREAM_ERROR;
+    return mmz_inflate_impl(pStream, flush, pSkip);
+}
 int mmz_inflateEnd(mmz_streamp pStream) {
     if (!pStream)
         return MMZ_STREAM_ERROR;
     if (pStream->state) {
-        pStream->zfree(pStream->opaque, pStream->state);
+        mmz_inflate_state_free(pStream, (mmz_inflate_state*)pStream->state);
         pStream->state = NULL;
     }
     return MMZ_OK;
 }
 int mmz_uncompress(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong source_len) {
+    return mmz_uncompress2(pDest, pDest_len, pSource, &source_len, MMZ_DEFAULT_WINDOW_BITS, 0);
+}
+int mmz_uncompress2(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong *pSource_len, int window_bits, int options) {
     mmz_stream stream;
     int status;
     memset(&stream, 0, sizeof(stream));
-    if ((source_len | *pDest_len) > 0xFFFFFFFFU) return MMZ_PARAM_ERROR;
+    if ((*pSource_len | *pDest_len) > 0xFFFFFFFFU) return MMZ_PARAM_ERROR;
     stream.next_in = pSource;
-    stream.avail_in = (mmz_uint32)source_len;
+    stream.avail_in = (mmz_uint32)*pSource_len;
     stream.next_out = pDest;
     stream.avail_out = (mmz_uint32)*pDest_len;
-    status = mmz_inflateInit(&stream);
+    status = mmz_inflateInit2(&stream, window_bits);
     if (status != MMZ_OK)
         return status;
+    if ((options) && ((status = mmz_inflateSetOptions(&stream, options)) != MMZ_OK)) {
+        mmz_inflateEnd(&stream);
+        return status;
+    }
     status = mmz_inflate(&stream, MMZ_FINISH);
+    *pSource_len = stream.total_in;
     if (status != MMZ_STREAM_END) {
         mmz_inflateEnd(&stream);
-        return ((status == MMZ_BUF_ERROR) && (!stream.avail_in)) ? MMZ_DATA_ERROR : status;
+        return (((status == MMZ_BUF_ERROR) && (!stream.avail_in)) || (status == MMZ_NEED_DICT)) ? MMZ_DATA_ERROR : status;
     }
     *pDest_len = stream.total_out;
     return mmz_inflateEnd(&stream);
 }
+int mmz_validate(mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong *pSource_len, int window_bits, int options) {
+    mmz_stream stream;
+    mmz_ulong skip = (mmz_ulong)-1;
+    int status;
+    memset(&stream, 0, sizeof(stream));
+    if (*pSource_len > 0xFFFFFFFFU) return MMZ_PARAM_ERROR;
+    stream.next_in = pSource;
+    stream.avail_in = (mmz_uint32)*pSource_len;
+    status = mmz_inflateInit2(&stream, window_bits);
+    if (status != MMZ_OK)
+        return status;
+    if ((options) && ((status = mmz_inflateSetOptions(&stream, options)) != MMZ_OK)) {
+        mmz_inflateEnd(&stream);
+        return status;
+    }
+    status = mmz_inflateSkip(&stream, &skip, MMZ_FINISH);
+    *pSource_len = stream.total_in;
+    *pDest_len = stream.total_out;
+    mmz_inflateEnd(&stream);
+    if (status == MMZ_STREAM_END) return MMZ_OK;
+    return (((status == MMZ_BUF_ERROR) && (!stream.avail_in)) || (status == MMZ_NEED_DICT)) ? MMZ_DATA_ERROR : status;
+}
 #define MMZ_TINFL_MEMCPY(d, s, l) memcpy(d, s, l)
 #define MMZ_TINFL_MEMSET(p, c, l) memset(p, c, l)
 #define MMZ_TINFL_CR_BEGIN switch(r->m_state) { case 0:
 #define MMZ_TINFL_CR_RETURN(state_index, result) do { status = result; r->m_state = state_index; goto common_exit; case state_index:; } MMZ_MACRO_END
 #define MMZ_TINFL_CR_RETURN_FOREVER(state_index, result) do { for ( ; ; ) { MMZ_TINFL_CR_RETURN(state_index, result); } } MMZ_MACRO_END
 #define MMZ_TINFL_CR_FINISH }
+// Without MMZ_TINFL_FLAG_HAS_MORE_INPUT, running out of input means the stream is truncated, so fail rather than decode zeros forever.
 #define MMZ_TINFL_GET_BYTE(state_index, c) do { \
-  if (pIn_buf_cur >= pIn_buf_end) { \
-    for ( ; ; ) { \
-      if (decomp_flags & MMZ_TINFL_FLAG_HAS_MORE_INPUT) { \
-        MMZ_TINFL_CR_RETURN(state_index, MMZ_TINFL_STATUS_NEEDS_MORE_INPUT); \
-        if (pIn_buf_cur < pIn_buf_end) { \
-          c = *pIn_buf_cur++; \
-          break; \
-        } \
-      } else { \
-        c = 0; \
-        break; \
-      } \
-    } \
-  } else c = *pIn_buf_cur++; } MMZ_MACRO_END
-#define MMZ_TINFL_NEED_BITS(state_index, n) do { mmz_uint c; MMZ_TINFL_GET_BYTE(state_index, c); bit_buf |= (((tinfl_bit_buf_t)c) << num_bits); num_bits += 8; } while (num_bits < (mmz_uint)(n))
+  while (pIn_buf_cur >= pIn_buf_end) { \
+    MMZ_TINFL_CR_RETURN(state_index, (decomp_flags & MMZ_TINFL_FLAG_HAS_MORE_INPUT) ? MMZ_TINFL_STATUS_NEEDS_MORE_INPUT : MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS); \
+  } \
+  c = *pIn_buf_cur++; } MMZ_MACRO_END
+// Gets a gzip header byte, folding it into the header CRC that FHCRC checks.
+#define MMZ_TINFL_GET_GZIP_BYTE(state_index, c) do { mmz_uint8 gz_byte; MMZ_TINFL_GET_BYTE(state_index, c); gz_byte = (mmz_uint8)(c); r->m_gz_hcrc = mmz_crc32(r->m_gz_hcrc, &gz_byte, 1); } MMZ_MACRO_END
+#define MMZ_TINFL_NEED_BITS(state_index, n) do { mmz_uint c; MMZ_TINFL_GET_BYTE(state_index, c); bit_buf |= (((mmz_tinfl_bit_buf_t)c) << num_bits); num_bits += 8; } while (num_bits < (mmz_uint)(n))
 #define MMZ_TINFL_SKIP_BITS(state_index, n) do { if (num_bits < (mmz_uint)(n)) { MMZ_TINFL_NEED_BITS(state_index, n); } bit_buf >>= (n); num_bits -= (n); } MMZ_MACRO_END
 #define MMZ_TINFL_GET_BITS(state_index, b, n) do { if (num_bits < (mmz_uint)(n)) { MMZ_TINFL_NEED_BITS(state_index, n); } b = bit_buf & ((1 << (n)) - 1); bit_buf >>= (n); num_bits -= (n); } MMZ_MACRO_END
-#define MMZ_TINFL_HUFF_BITBUF_FILL(state_index, pHuff) \
+// Resolves the table entry for the code at the bottom of bit_buf, following a subtable pointer if needed (the main table bits are consumed in that case).
+#define MMZ_TINFL_HUFF_LOOKUP(e, pHuff, table_bits) do { \
+  e = (pHuff)->m_look_up[bit_buf & ((1U << (table_bits)) - 1)]; \
+  if (e & MMZ_TINFL_HUFF_SUBTABLE) { \
+    bit_buf >>= (table_bits); num_bits -= (table_bits); \
+    e = (pHuff)->m_look_up[(e >> 16) + (bit_buf & ((1U << (e & 15)) - 1))]; \
+  } } MMZ_MACRO_END
+#define MMZ_TINFL_HUFF_BITBUF_FILL(state_index, pHuff, table_bits) \
   do { \
-    temp = (pHuff)->m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)]; \
-    if (temp >= 0) { \
-      code_len = temp >> 9; \
+    e = (pHuff)->m_look_up[bit_buf & ((1U << (table_bits)) - 1)]; \
+    if (!(e & MMZ_TINFL_HUFF_SUBTABLE)) { \
+      code_len = (e & MMZ_TINFL_HUFF_MULTI_LITERAL) ? (pHuff)->m_code_size[(e >> 8) & 255] : (e & 15); \
       if ((code_len) && (num_bits >= code_len)) \
-      break; \
-    } else if (num_bits > MMZ_TINFL_FAST_LOOKUP_BITS) { \
-       code_len = MMZ_TINFL_FAST_LOOKUP_BITS; \
-       do { \
-          temp = (pHuff)->m_tree[~temp + ((bit_buf >> code_len++) & 1)]; \
-       } while ((temp < 0) && (num_bits >= (code_len + 1))); if (temp >= 0) break; \
-    } MMZ_TINFL_GET_BYTE(state_index, c); bit_buf |= (((tinfl_bit_buf_t)c) << num_bits); num_bits += 8; \
+        break; \
+    } else if (num_bits > (table_bits)) { \
+      code_len = (pHuff)->m_look_up[(e >> 16) + ((bit_buf >> (table_bits)) & ((1U << (e & 15)) - 1))] & 15; \
+      if ((code_len) && (num_bits >= (table_bits) + code_len)) \
+        break; \
+    } MMZ_TINFL_GET_BYTE(state_index, c); bit_buf |= (((mmz_tinfl_bit_buf_t)c) << num_bits); num_bits += 8; \
   } while (num_bits < 15);
-#define MMZ_TINFL_HUFF_DECODE(state_index, sym, pHuff) do { \
-  int temp; mmz_uint code_len, c; \
+#define MMZ_TINFL_HUFF_DECODE_ENTRY(state_index, entry, pHuff, table_bits) do { \
+  mmz_uint32 e; mmz_uint code_len, c; \
   if (num_bits < 15) { \
     if ((pIn_buf_end - pIn_buf_cur) < 2) { \
-       MMZ_TINFL_HUFF_BITBUF_FILL(state_index, pHuff); \
+       MMZ_TINFL_HUFF_BITBUF_FILL(state_index, pHuff, table_bits); \
     } else { \
-       bit_buf |= (((tinfl_bit_buf_t)pIn_buf_cur[0]) << num_bits) | (((tinfl_bit_buf_t)pIn_buf_cur[1]) << (num_bits + 8)); pIn_buf_cur += 2; num_bits += 16; \
+       bit_buf |= (((mmz_tinfl_bit_buf_t)pIn_buf_cur[0]) << num_bits) | (((mmz_tinfl_bit_buf_t)pIn_buf_cur[1]) << (num_bits + 8)); pIn_buf_cur += 2; num_bits += 16; \
     } \
   } \
-  if ((temp = (pHuff)->m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)]) >= 0) \
-    code_len = temp >> 9, temp &= 511; \
-  else { \
-    code_len = MMZ_TINFL_FAST_LOOKUP_BITS; do { temp = (pHuff)->m_tree[~temp + ((bit_buf >> code_len++) & 1)]; } while (temp < 0); \
-  } sym = temp; bit_buf >>= code_len; num_bits -= code_len; } MMZ_MACRO_END
-mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mmz_uint8 *pOut_buf_start, mmz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mmz_uint32 decomp_flags) {
-    static const int s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
-    static const int s_length_extra[31]= { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
-    static const int s_dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0};
-    static const int s_dist_extra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+  MMZ_TINFL_HUFF_LOOKUP(e, pHuff, table_bits); \
+  if (e & MMZ_TINFL_HUFF_MULTI_LITERAL) { c = (e >> 8) & 255; e = (c << 16) | (c << 8) | 0x10 | (pHuff)->m_code_size[c]; } \
+  code_len = e & 15; entry = e; bit_buf >>= code_len; num_bits -= code_len; } MMZ_MACRO_END
+#define MMZ_TINFL_HUFF_DECODE(state_index, sym, pHuff, table_bits) do { MMZ_TINFL_HUFF_DECODE_ENTRY(state_index, sym, pHuff, table_bits); sym >>= 16; } MMZ_MACRO_END
+// Builds the main table and subtables of r->m_tables[table_num] from its code sizes. Returns MMZ_FALSE if the code is over or under subscribed.
+static mmz_bool mmz_tinfl_build_huff_table(mmz_tinfl_huff_table *pTable, mmz_uint table_num, mmz_uint num_syms) {
+    static const mmz_uint16 s_length_base[31] = { 3,4,5,6,7,8,9,10,11,13, 15,17,19,23,27,31,35,43,51,59, 67,83,99,115,131,163,195,227,258,0,0 };
+    static const mmz_uint8 s_length_extra[31]= { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+    static const mmz_uint16 s_dist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193, 257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0xFFFF,0xFFFF};
+    static const mmz_uint8 s_dist_extra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+    static const mmz_uint8 s_table_bits[MMZ_TINFL_MAX_HUFF_TABLES] = { MMZ_TINFL_FAST_LOOKUP_BITS, MMZ_TINFL_DIST_LOOKUP_BITS, MMZ_TINFL_CODE_SIZE_LOOKUP_BITS };
+    mmz_uint table_bits = s_table_bits[table_num], main_size = 1U << table_bits, i, l, code_size, used_syms = 0, total = 0, cur_code = 0, sub_start = 0, sub_bits = 0;
+    mmz_uint prefix = (mmz_uint)-1, next_free = main_size, total_syms[16], offsets[16]; mmz_uint32 fill;
+    mmz_uint16 sorted_syms[MMZ_TINFL_MAX_HUFF_SYMBOLS_0];
+    MMZ_CLEAR_OBJ(total_syms);
+    for (i = 0; i < num_syms; ++i) total_syms[pTable->m_code_size[i]]++;
+    for (i = 1, offsets[1] = 0; i <= 15; ++i) { used_syms += total_syms[i]; total = (total + total_syms[i]) << 1; if (i < 15) offsets[i + 1] = offsets[i] + total_syms[i]; }
+    // Like zlib, the only incomplete lit/len or distance code allowed is a single code of length 1 (or none at all), and the code length code must be complete.
+    if ((65536U != total) && ((table_num == 2) || (used_syms > 1) || ((used_syms) && (!total_syms[1])))) return MMZ_FALSE;
+    for (i = 0; i < num_syms; ++i) if (pTable->m_code_size[i]) sorted_syms[offsets[pTable->m_code_size[i]]++] = (mmz_uint16)i;
+    // The unused codes of an incomplete code decode as invalid symbols, so a stream using them fails: lit/len slots get the end of block entry with a
+    // non-zero base of symbols 286-287, and distance slots get the out of range base of symbols 30-31.
+    fill = (table_num == 1) ? ((mmz_uint32)s_dist_base[30] << 16) : (!table_num) ? ((1U << 16) | MMZ_TINFL_HUFF_END_OF_BLOCK) : 0;
+    for (i = 0; i < main_size; ++i) pTable->m_look_up[i] = fill;
+    // Assign canonical codes in (length, symbol) order, so the long codes sharing a main table slot are visited together.
+    for (i = 0, code_size = 1; i < used_syms; ++i, ++cur_code) {
+        mmz_uint sym = sorted_syms[i], rev_code = 0, k; mmz_uint32 value = sym << 16;
+        while (!total_syms[code_size]) { code_size++; cur_code <<= 1; }
+        if (table_num == 0)
+            value = (sym < 256) ? ((sym << 16) | (sym << 8) | 0x10) : (sym == 256) ? (mmz_uint32)MMZ_TINFL_HUFF_END_OF_BLOCK : (sym >= 286) ? ((1U << 16) | MMZ_TINFL_HUFF_END_OF_BLOCK) : (((mmz_uint32)s_length_base[sym - 257] << 16) | (s_length_extra[sym - 257] << 8));
+        else if (table_num == 1)
+            value = ((mmz_uint32)s_dist_base[sym] << 16) | (s_dist_extra[sym] << 8);
+        for (l = 0, k = cur_code; l < code_size; l++, k >>= 1) rev_code = (rev_code << 1) | (k & 1);
+        if (code_size <= table_bits) {
+            mmz_uint32 e = value | code_size;
+            for ( ; rev_code < main_size; rev_code += (1U << code_size)) pTable->m_look_up[rev_code] = e;
+        } else {
+            mmz_uint32 e = value | (code_size - table_bits);
+            if ((rev_code & (main_size - 1)) != prefix) {
+                // Size the subtable so it's completely filled by the codes that start with this prefix, as zlib does.
+                mmz_uint space;
+                prefix = rev_code & (main_size - 1); sub_bits = code_size - table_bits; space = total_syms[code_size];
+                while ((space < (1U << sub_bits)) && (table_bits + sub_bits < 15)) { sub_bits++; space = (space << 1) + total_syms[table_bits + sub_bits]; }
+                if (next_free + (1U << sub_bits) > (mmz_uint)MMZ_TINFL_HUFF_TABLE_SIZE) return MMZ_FALSE;
+                sub_start = next_free; next_free += 1U << sub_bits;
+                for (l = 0; l < (1U << sub_bits); ++l) pTable->m_look_up[sub_start + l] = fill;
+                pTable->m_look_up[prefix] = (sub_start << 16) | MMZ_TINFL_HUFF_SUBTABLE | sub_bits;
+            }
+            for (rev_code >>= table_bits; rev_code < (1U << sub_bits); rev_code += (1U << (code_size - table_bits))) pTable->m_look_up[sub_start + rev_code] = e;
+        }
+        total_syms[code_size]--;
+    }
+    if (table_num)
+        return MMZ_TRUE;
+    // Pack the literals that follow a literal into its entry. Going down from the top, the entries at i >> len haven't been packed yet.
+    for (i = main_size; i-- > 0; ) {
+        mmz_uint32 e = pTable->m_look_up[i], e2, e3; mmz_uint len = e & 15;
+        if (((e & (MMZ_TINFL_HUFF_LITERALS | MMZ_TINFL_HUFF_SUBTABLE)) != 0x10) || (!len)) continue;
+        e2 = pTable->m_look_up[i >> len];
+        if (((e2 & (MMZ_TINFL_HUFF_LITERALS | MMZ_TINFL_HUFF_SUBTABLE)) != 0x10) || (len + (e2 & 15) > table_bits)) continue;
+        len += e2 & 15; e = (e & 0xFF00) | ((e2 & 0xFF00) << 8) | 0x20 | len;
+        e3 = pTable->m_look_up[i >> len];
+        if (((e3 & (MMZ_TINFL_HUFF_LITERALS | MMZ_TINFL_HUFF_SUBTABLE)) == 0x10) && (len + (e3 & 15) <= table_bits))
+            e = (e & 0xFFFF00) | ((e3 & 0xFF00) << 16) | 0x30 | (len + (e3 & 15));
+        pTable->m_look_up[i] = e;
+    }
+    return MMZ_TRUE;
+}
+// Copies a len byte match from dist (> 0) bytes back, possibly writing up to MMZ_TINFL_MATCH_COPY_SLACK bytes past the end of the match. Matches at
+// least 16 bytes back are copied 16 or 32 bytes at a time, and shorter distances have their period replicated until they can be copied the same way.
+enum { MMZ_TINFL_MATCH_COPY_SLACK = 32 };
+static MMZ_FORCEINLINE void mmz_tinfl_copy_match(mmz_uint8 *pOut_buf_cur, mmz_uint32 len, mmz_uint32 dist) {
+    const mmz_uint8 *pSrc = pOut_buf_cur - dist; mmz_uint8 *pOut_end = pOut_buf_cur + len;
+    MMZ_ASSERT(dist > 0);
+    if (dist >= 32) {
+        do { memcpy(pOut_buf_cur, pSrc, 32); pOut_buf_cur += 32; pSrc += 32; } while (pOut_buf_cur < pOut_end);
+        return;
+    }
+    if (dist == 1) {
+        memset(pOut_buf_cur, pSrc[0], len);
+        return;
+    }
+    if (dist < 16) {
+#ifdef __SSSE3__
+        static const mmz_uint8 s_pattern_shuffle[16][16] = {
+            { 0 }, { 0 },
+            { 0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,3,0,1,2,3,0,1,2,3,0,1,2,3 }, { 0,1,2,3,4,0,1,2,3,4,0,1,2,3,4,0 },
+            { 0,1,2,3,4,5,0,1,2,3,4,5,0,1,2,3 }, { 0,1,2,3,4,5,6,0,1,2,3,4,5,6,0,1 }, { 0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7 }, { 0,1,2,3,4,5,6,7,8,0,1,2,3,4,5,6 },
+            { 0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5 }, { 0,1,2,3,4,5,6,7,8,9,10,0,1,2,3,4 }, { 0,1,2,3,4,5,6,7,8,9,10,11,0,1,2,3 }, { 0,1,2,3,4,5,6,7,8,9,10,11,12,0,1,2 },
+            { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,0,1 }, { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,0 } };
+        // Broadcast the period across a register and store it at the largest stride that's a multiple of dist.
+        __m128i pattern = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)pSrc), _mm_loadu_si128((const __m128i *)s_pattern_shuffle[dist]));
+        mmz_uint32 stride = 16 - (16 % dist);
+        do { _mm_storeu_si128((__m128i *)pOut_buf_cur, pattern); pOut_buf_cur += stride; } while (pOut_buf_cur < pOut_end);
+        return;
+#else
+        // Repeat the period until it's at least 16 bytes long, after which it can be copied 16 bytes at a time from that far back.
+        mmz_uint32 i, period = dist; while (period < 16) period += dist;
+        for (i = 0; i < period; ++i) pOut_buf_cur[i] = pSrc[i];
+        pSrc = pOut_buf_cur; pOut_buf_cur += period;
+#endif
+    }
+    while (pOut_buf_cur < pOut_end) { memcpy(pOut_buf_cur, pSrc, 16); pOut_buf_cur += 16; pSrc += 16; }
+}
+// Static blocks always use the same tables. C++ builds them once (thread-safe, on first use) and copies them in, C rebuilds them for every static block.
+static void mmz_tinfl_build_fixed_tables(mmz_tinfl_huff_table *pTables) {
+    mmz_uint8 *p = pTables[0].m_code_size; mmz_uint i;
+    for ( i = 0; i <= 143; ++i) *p++ = 8;
+    for ( ; i <= 255; ++i) *p++ = 9;
+    for ( ; i <= 279; ++i) *p++ = 7;
+    for ( ; i <= 287; ++i) *p++ = 8;
+    MMZ_TINFL_MEMSET(pTables[1].m_code_size, 5, 32);
+    mmz_tinfl_build_huff_table(&pTables[0], 0, 288); mmz_tinfl_build_huff_table(&pTables[1], 1, 32);
+}
+#ifdef __cplusplus
+struct mmz_tinfl_fixed_tables {
+    mmz_tinfl_huff_table m_tables[2];
+    mmz_tinfl_fixed_tables() { mmz_tinfl_build_fixed_tables(m_tables); }
+};
+#endif
+static void mmz_tinfl_set_fixed_tables(mmz_tinfl_decompressor *r) {
+    r->m_table_sizes[0] = 288; r->m_table_sizes[1] = 32;
+#ifdef __cplusplus
+    static const mmz_tinfl_fixed_tables s_fixed;
+    // The fixed codes are at most 9 bits, so they fit in the main tables without any subtables.
+    MMZ_TINFL_MEMCPY(r->m_tables[0].m_code_size, s_fixed.m_tables[0].m_code_size, 288); MMZ_TINFL_MEMCPY(r->m_tables[0].m_look_up, s_fixed.m_tables[0].m_look_up, MMZ_TINFL_FAST_LOOKUP_SIZE * sizeof(mmz_uint32));
+    MMZ_TINFL_MEMCPY(r->m_tables[1].m_code_size, s_fixed.m_tables[1].m_code_size, 32); MMZ_TINFL_MEMCPY(r->m_tables[1].m_look_up, s_fixed.m_tables[1].m_look_up, (1 << MMZ_TINFL_DIST_LOOKUP_BITS) * sizeof(mmz_uint32));
+#else
+    mmz_tinfl_build_fixed_tables(r->m_tables);
+#endif
+}
+// Straight-line decoder for the body of a Huffman block in a non-wrapping output buffer. It skips the coroutine's per-symbol input and output checks
+// by only running while MMZ_TINFL_FAST_INPUT_MARGIN input bytes (one 64-bit refill) and MMZ_TINFL_FAST_OUTPUT_MARGIN output bytes (a maximum length
+// match plus the match copy slack) are left. Returns 1 at the end of the block, -1 on bad data, or 0 at the margins to let the coroutine finish.
+enum { MMZ_TINFL_FAST_INPUT_MARGIN = 8, MMZ_TINFL_FAST_OUTPUT_MARGIN = 258 + MMZ_TINFL_MATCH_COPY_SLACK, MMZ_TINFL_ADLER_CHUNK_SIZE = 8192 };
+static int mmz_tinfl_decode_block_fast(mmz_tinfl_decompressor *r, const mmz_uint8 **ppIn_buf_cur, const mmz_uint8 *pIn_buf_end, mmz_uint8 *pOut_buf_start, mmz_uint8 **ppOut_buf_cur, mmz_uint8 *pOut_buf_end, mmz_tinfl_bit_buf_t *pBit_buf, mmz_uint32 *pNum_bits) {
+    const mmz_uint8 *pIn_buf_cur = *ppIn_buf_cur; mmz_uint8 *pOut_buf_cur = *ppOut_buf_cur;
+    mmz_tinfl_bit_buf_t bit_buf = *pBit_buf; mmz_uint32 num_bits = *pNum_bits, e, counter, dist, window_size = r->m_window_size; int result = 0;
+    while (((size_t)(pIn_buf_end - pIn_buf_cur) >= MMZ_TINFL_FAST_INPUT_MARGIN) && ((size_t)(pOut_buf_end - pOut_buf_cur) >= MMZ_TINFL_FAST_OUTPUT_MARGIN)) {
+        // Refill to at least 56 bits, enough for a length, a distance and their extra bits. Bits above num_bits belong to the next unread byte.
+        bit_buf |= ((mmz_tinfl_bit_buf_t)MMZ_READ_LE64(pIn_buf_cur)) << num_bits; pIn_buf_cur += (63 - num_bits) >> 3; num_bits |= 56;
+        MMZ_TINFL_HUFF_LOOKUP(e, &r->m_tables[0], MMZ_TINFL_FAST_LOOKUP_BITS);
+        bit_buf >>= e & 15; num_bits -= e & 15;
+        if (e & MMZ_TINFL_HUFF_LITERALS) {
+            // Nothing past the cursor is history in a non-wrapping buffer, so all three literal slots can be stored.
+            pOut_buf_cur[0] = (mmz_uint8)(e >> 8); pOut_buf_cur[1] = (mmz_uint8)(e >> 16); pOut_buf_cur[2] = (mmz_uint8)(e >> 24);
+            pOut_buf_cur += (e >> 4) & 3;
+            continue;
+        }
+        if (e & MMZ_TINFL_HUFF_END_OF_BLOCK) { result = (e >> 16) ? -1 : 1; break; }
+        counter = (e >> 16) + (mmz_uint32)(bit_buf & ((1U << ((e >> 8) & 15)) - 1)); bit_buf >>= (e >> 8) & 15; num_bits -= (e >> 8) & 15;
+        MMZ_TINFL_HUFF_LOOKUP(e, &r->m_tables[1], MMZ_TINFL_DIST_LOOKUP_BITS);
+        bit_buf >>= e & 15; num_bits -= e & 15;
+        dist = (e >> 16) + (mmz_uint32)(bit_buf & ((1U << ((e >> 8) & 15)) - 1)); bit_buf >>= (e >> 8) & 15; num_bits -= (e >> 8) & 15;
+        if ((!dist) || (dist > window_size) || (dist > (size_t)(pOut_buf_cur - pOut_buf_start))) { result = -1; break; }
+        mmz_tinfl_copy_match(pOut_buf_cur, counter, dist); pOut_buf_cur += counter;
+    }
+    *ppIn_buf_cur = pIn_buf_cur; *ppOut_buf_cur = pOut_buf_cur;
+    *pBit_buf = bit_buf & ((((mmz_tinfl_bit_buf_t)1) << num_bits) - 1); *pNum_bits = num_bits;
+    return result;
+}
+// Folds freshly written output into the stream's check value: Adler-32, or CRC-32 and the byte count for gzip.
+static void mmz_tinfl_update_check(mmz_tinfl_decompressor *r, const mmz_uint8 *ptr, size_t buf_len) {
+    if (r->m_gzip) {
+        r->m_check_adler32 = mmz_crc32(r->m_check_adler32, ptr, buf_len); r->m_gz_isize += (mmz_uint32)buf_len;
+    } else
+        r->m_check_adler32 = mmz_adler32(r->m_check_adler32, ptr, buf_len);
+}
+// The decoder proper. Always inlined so that callers passing partly constant flags get the branches on those bits (and the out_buf_size_mask
+// arithmetic, which is a no-op for non-wrapping buffers) folded away.
+static MMZ_FORCEINLINE mmz_tinfl_status mmz_tinfl_decompress_core(mmz_tinfl_decompressor *r, const mmz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mmz_uint8 *pOut_buf_start, mmz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mmz_uint32 decomp_flags) {
     static const mmz_uint8 s_length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
     static const int s_min_table_sizes[3] = { 257, 1, 4 };
     mmz_tinfl_status status = MMZ_TINFL_STATUS_FAILED; mmz_uint32 num_bits, dist, counter, num_extra; mmz_tinfl_bit_buf_t bit_buf;
     const mmz_uint8 *pIn_buf_cur = pIn_buf_next, *const pIn_buf_end = pIn_buf_next + *pIn_buf_size;
-    mmz_uint8 *pOut_buf_cur = pOut_buf_next, *const pOut_buf_end = pOut_buf_next + *pOut_buf_size;
+    mmz_uint8 *pOut_buf_cur = pOut_buf_next, *const pOut_buf_end = pOut_buf_next + *pOut_buf_size, *pOut_buf_checked = pOut_buf_next;
     size_t out_buf_size_mask = (decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) ? (size_t)-1 : ((pOut_buf_next - pOut_buf_start) + *pOut_buf_size) - 1, dist_from_out_buf_start;
     if (((out_buf_size_mask + 1) & out_buf_size_mask) || (pOut_buf_next < pOut_buf_start)) { *pIn_buf_size = *pOut_buf_size = 0; return MMZ_TINFL_STATUS_BAD_PARAM; }
     num_bits = r->m_num_bits; bit_buf = r->m_bit_buf; dist = r->m_dist; counter = r->m_counter; num_extra = r->m_num_extra; dist_from_out_buf_start = r->m_dist_from_out_buf_start;
     MMZ_TINFL_CR_BEGIN
-            bit_buf = num_bits = dist = counter = num_extra = r->m_zhdr0 = r->m_zhdr1 = 0; r->m_z_adler32 = r->m_check_adler32 = 1;
-            if (decomp_flags & MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER) {
-                MMZ_TINFL_GET_BYTE(1, r->m_zhdr0); MMZ_TINFL_GET_BYTE(2, r->m_zhdr1);
-                counter = (((r->m_zhdr0 * 256 + r->m_zhdr1) % 31 != 0) || (r->m_zhdr1 & 32) || ((r->m_zhdr0 & 15) != 8));
-                if (!(decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) counter |= (((1U << (8U + (r->m_zhdr0 >> 4))) > 32768U) || ((out_buf_size_mask + 1) < (size_t)(1U << (8U + (r->m_zhdr0 >> 4)))));
-                if (counter) { MMZ_TINFL_CR_RETURN_FOREVER(36, MMZ_TINFL_STATUS_FAILED); }
+            bit_buf = num_bits = dist = counter = num_extra = r->m_zhdr0 = r->m_zhdr1 = r->m_gzip = 0; r->m_z_adler32 = r->m_check_adler32 = 1;
+            if (decomp_flags & (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_PARSE_GZIP_HEADER)) {
+                MMZ_TINFL_GET_BYTE(1, r->m_zhdr0);
+                // A zlib header can't start with 0x1F (CM would be 15), so that byte alone tells the formats apart.
+                r->m_gzip = (decomp_flags & MMZ_TINFL_FLAG_PARSE_GZIP_HEADER) && ((r->m_zhdr0 == 0x1F) || (!(decomp_flags & MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER)));
+                if (r->m_gzip) {
+                    // RFC 1952: ID1 ID2 CM FLG MTIME(4) XFL OS, then whichever of FEXTRA, FNAME, FCOMMENT and FHCRC the FLG bits ask for.
+                    { mmz_uint8 id1 = (mmz_uint8)r->m_zhdr0; r->m_gz_hcrc = mmz_crc32(0, &id1, 1); }
+                    MMZ_TINFL_GET_GZIP_BYTE(54, r->m_zhdr1); counter = (r->m_zhdr0 != 0x1F) || (r->m_zhdr1 != 0x8B);
+                    MMZ_TINFL_GET_GZIP_BYTE(55, dist); counter |= (dist != 8);
+                    MMZ_TINFL_GET_GZIP_BYTE(56, r->m_zhdr1); counter |= ((r->m_zhdr1 & 0xE0) != 0);
+                    if (counter) { MMZ_TINFL_CR_RETURN_FOREVER(57, MMZ_TINFL_STATUS_FAILED); }
+                    for (counter = 0; counter < 6; ++counter) { mmz_uint s; MMZ_TINFL_GET_GZIP_BYTE(58, s); }
+                    if (r->m_zhdr1 & 4) {
+                        MMZ_TINFL_GET_GZIP_BYTE(59, counter); MMZ_TINFL_GET_GZIP_BYTE(60, dist); counter |= dist << 8;
+                        while (counter) { mmz_uint s; MMZ_TINFL_GET_GZIP_BYTE(61, s); counter--; }
+                    }
+                    if (r->m_zhdr1 & 8) { do { MMZ_TINFL_GET_GZIP_BYTE(62, dist); } while (dist); }
+                    if (r->m_zhdr1 & 16) { do { MMZ_TINFL_GET_GZIP_BYTE(63, dist); } while (dist); }
+                    if (r->m_zhdr1 & 2) {
+                        MMZ_TINFL_GET_BYTE(64, counter); MMZ_TINFL_GET_BYTE(65, dist);
+                        if ((counter | (dist << 8)) != (r->m_gz_hcrc & 0xFFFF)) { MMZ_TINFL_CR_RETURN_FOREVER(66, MMZ_TINFL_STATUS_FAILED); }
+                    }
+                    r->m_z_adler32 = r->m_check_adler32 = r->m_gz_isize = 0;
+                } else {
+                    MMZ_TINFL_GET_BYTE(2, r->m_zhdr1);
+                    counter = (((r->m_zhdr0 * 256 + r->m_zhdr1) % 31 != 0) || ((r->m_zhdr0 & 15) != 8));
+                    if (!(decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) counter |= (((1U << (8U + (r->m_zhdr0 >> 4))) > 32768U) || ((out_buf_size_mask + 1) < (size_t)(1U << (8U + (r->m_zhdr0 >> 4)))));
+                    if (counter) { MMZ_TINFL_CR_RETURN_FOREVER(36, MMZ_TINFL_STATUS_FAILED); }
+                    if (r->m_zhdr1 & 32) {
+                        // FDICT: the dictionary's Adler-32 follows (the trailer overwrites it later).
+                        for (counter = 0; counter < 4; ++counter) { mmz_uint s; MMZ_TINFL_GET_BYTE(72, s); r->m_z_adler32 = (r->m_z_adler32 << 8) | s; }
+                        MMZ_TINFL_CR_RETURN(73, MMZ_TINFL_STATUS_NEEDS_DICT);
+                    }
+                }
             }
             do {
+                if (decomp_flags & MMZ_TINFL_FLAG_STOP_AT_BLOCK) { MMZ_TINFL_CR_RETURN(71, MMZ_TINFL_STATUS_BLOCK_BOUNDARY); }
                 MMZ_TINFL_GET_BITS(3, r->m_final, 3); r->m_type = r->m_final >> 1;
                 if (r->m_type == 0) {
                     MMZ_TINFL_SKIP_BITS(5, num_bits & 7);
@@ -386,7 +1120,7 @@ mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8
                             if (decomp_flags & MMZ_TINFL_FLAG_HAS_MORE_INPUT) {
                                 MMZ_TINFL_CR_RETURN(38, MMZ_TINFL_STATUS_NEEDS_MORE_INPUT);
                             } else {
-                                MMZ_TINFL_CR_RETURN_FOREVER(40, MMZ_TINFL_STATUS_FAILED);
+                                MMZ_TINFL_CR_RETURN(40, MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS);
                             }
                         }
                         n = MMZ_MIN(MMZ_MIN((size_t)(pOut_buf_end - pOut_buf_cur), (size_t)(pIn_buf_end - pIn_buf_cur)), counter);
@@ -396,96 +1130,93 @@ mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8
                     MMZ_TINFL_CR_RETURN_FOREVER(10, MMZ_TINFL_STATUS_FAILED);
                 } else {
                     if (r->m_type == 1) {
-                        mmz_uint8 *p = r->m_tables[0].m_code_size; mmz_uint i;
-                        r->m_table_sizes[0] = 288; r->m_table_sizes[1] = 32; MMZ_TINFL_MEMSET(r->m_tables[1].m_code_size, 5, 32);
-                        for ( i = 0; i <= 143; ++i) *p++ = 8; for ( ; i <= 255; ++i) *p++ = 9; for ( ; i <= 279; ++i) *p++ = 7; for ( ; i <= 287; ++i) *p++ = 8;
+                        mmz_tinfl_set_fixed_tables(r);
                     } else {
                         for (counter = 0; counter < 3; counter++) { MMZ_TINFL_GET_BITS(11, r->m_table_sizes[counter], "\05\05\04"[counter]); r->m_table_sizes[counter] += s_min_table_sizes[counter]; }
                         MMZ_CLEAR_OBJ(r->m_tables[2].m_code_size); for (counter = 0; counter < r->m_table_sizes[2]; counter++) { mmz_uint s; MMZ_TINFL_GET_BITS(14, s, 3); r->m_tables[2].m_code_size[s_length_dezigzag[counter]] = (mmz_uint8)s; }
                         r->m_table_sizes[2] = 19;
-                    }
-                    for ( ; (int)r->m_type >= 0; r->m_type--) {
-                        int tree_next, tree_cur; mmz_tinfl_huff_table *pTable;
-                        mmz_uint i, j, used_syms, total, sym_index, next_code[17], total_syms[16]; pTable = &r->m_tables[r->m_type]; MMZ_CLEAR_OBJ(total_syms); MMZ_CLEAR_OBJ(pTable->m_look_up); MMZ_CLEAR_OBJ(pTable->m_tree);
-                        for (i = 0; i < r->m_table_sizes[r->m_type]; ++i) total_syms[pTable->m_code_size[i]]++;
-                        used_syms = 0, total = 0; next_code[0] = next_code[1] = 0;
-                        for (i = 1; i <= 15; ++i) { used_syms += total_syms[i]; next_code[i + 1] = (total = ((total + total_syms[i]) << 1)); }
-                        if ((65536 != total) && (used_syms > 1)) {
-                            MMZ_TINFL_CR_RETURN_FOREVER(35, MMZ_TINFL_STATUS_FAILED);
-                        }
-                        for (tree_next = -1, sym_index = 0; sym_index < r->m_table_sizes[r->m_type]; ++sym_index) {
-                            mmz_uint rev_code = 0, l, cur_code, code_size = pTable->m_code_size[sym_index]; if (!code_size) continue;
-                            cur_code = next_code[code_size]++; for (l = code_size; l > 0; l--, cur_code >>= 1) rev_code = (rev_code << 1) | (cur_code & 1);
-                            if (code_size <= MMZ_TINFL_FAST_LOOKUP_BITS) { mmz_int16 k = (mmz_int16)((code_size << 9) | sym_index); while (rev_code < MMZ_TINFL_FAST_LOOKUP_SIZE) { pTable->m_look_up[rev_code] = k; rev_code += (1 << code_size); } continue; }
-                            if (0 == (tree_cur = pTable->m_look_up[rev_code & (TINFL_FAST_LOOKUP_SIZE - 1)])) { pTable->m_look_up[rev_code & (TINFL_FAST_LOOKUP_SIZE - 1)] = (mmz_int16)tree_next; tree_cur = tree_next; tree_next -= 2; }
-                            rev_code >>= (TINFL_FAST_LOOKUP_BITS - 1);
-                            for (j = code_size; j > (TINFL_FAST_LOOKUP_BITS + 1); j--) {
-                                tree_cur -= ((rev_code >>= 1) & 1);
-                                if (!pTable->m_tree[-tree_cur - 1]) { pTable->m_tree[-tree_cur - 1] = (mmz_int16)tree_next; tree_cur = tree_next; tree_next -= 2; } else tree_cur = pTable->m_tree[-tree_cur - 1];
+                        for ( ; (int)r->m_type >= 0; r->m_type--) {
+                            if (!mmz_tinfl_build_huff_table(&r->m_tables[r->m_type], r->m_type, r->m_table_sizes[r->m_type])) {
+                                MMZ_TINFL_CR_RETURN_FOREVER(35, MMZ_TINFL_STATUS_FAILED);
                             }
-                            tree_cur -= ((rev_code >>= 1) & 1); pTable->m_tree[-tree_cur - 1] = (mmz_int16)sym_index;
-                        }
-                        if (r->m_type == 2) {
-                            for (counter = 0; counter < (r->m_table_sizes[0] + r->m_table_sizes[1]); ) {
-                                mmz_uint s; MMZ_TINFL_HUFF_DECODE(16, dist, &r->m_tables[2]); if (dist < 16) { r->m_len_codes[counter++] = (mmz_uint8)dist; continue; }
-                                if ((dist == 16) && (!counter)) {
-                                    MMZ_TINFL_CR_RETURN_FOREVER(17, MMZ_TINFL_STATUS_FAILED);
+                            if (r->m_type == 2) {
+                                for (counter = 0; counter < (r->m_table_sizes[0] + r->m_table_sizes[1]); ) {
+                                    mmz_uint s; MMZ_TINFL_HUFF_DECODE(16, dist, &r->m_tables[2], MMZ_TINFL_CODE_SIZE_LOOKUP_BITS); if (dist < 16) { r->m_len_codes[counter++] = (mmz_uint8)dist; continue; }
+                                    if ((dist == 16) && (!counter)) {
+                                        MMZ_TINFL_CR_RETURN_FOREVER(17, MMZ_TINFL_STATUS_FAILED);
+                                    }
+                                    num_extra = "\02\03\07"[dist - 16]; MMZ_TINFL_GET_BITS(18, s, num_extra); s += "\03\03\013"[dist - 16];
+                                    MMZ_TINFL_MEMSET(r->m_len_codes + counter, (dist == 16) ? r->m_len_codes[counter - 1] : 0, s); counter += s;
                                 }
-                                num_extra = "\02\03\07"[dist - 16]; MMZ_TINFL_GET_BITS(18, s, num_extra); s += "\03\03\013"[dist - 16];
-                                MMZ_TINFL_MEMSET(r->m_len_codes + counter, (dist == 16) ? r->m_len_codes[counter - 1] : 0, s); counter += s;
-                            }
-                            if ((r->m_table_sizes[0] + r->m_table_sizes[1]) != counter) {
-                                MMZ_TINFL_CR_RETURN_FOREVER(21, MMZ_TINFL_STATUS_FAILED);
+                                if ((r->m_table_sizes[0] + r->m_table_sizes[1]) != counter) {
+                                    MMZ_TINFL_CR_RETURN_FOREVER(21, MMZ_TINFL_STATUS_FAILED);
+                                }
+                                MMZ_TINFL_MEMCPY(r->m_tables[0].m_code_size, r->m_len_codes, r->m_table_sizes[0]); MMZ_TINFL_MEMCPY(r->m_tables[1].m_code_size, r->m_len_codes + r->m_table_sizes[0], r->m_table_sizes[1]);
                             }
-                            MMZ_TINFL_MEMCPY(r->m_tables[0].m_code_size, r->m_len_codes, r->m_table_sizes[0]); MMZ_TINFL_MEMCPY(r->m_tables[1].m_code_size, r->m_len_codes + r->m_table_sizes[0], r->m_table_sizes[1]);
                         }
                     }
                     for ( ; ; ) {
                         mmz_uint8 *pSrc;
+                        if (decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) {
+                            int fast_result;
+                            // Decode at most MMZ_TINFL_ADLER_CHUNK_SIZE bytes at a time so the checksum reads them back while they're still in L1.
+                            for ( ; ; ) {
+                                mmz_uint8 *pOut_fast_end; pOut_fast_end = pOut_buf_cur + MMZ_MIN((size_t)(pOut_buf_end - pOut_buf_cur), (size_t)(MMZ_TINFL_ADLER_CHUNK_SIZE + MMZ_TINFL_FAST_OUTPUT_MARGIN));
+                                fast_result = mmz_tinfl_decode_block_fast(r, &pIn_buf_cur, pIn_buf_end, pOut_buf_start, &pOut_buf_cur, pOut_fast_end, &bit_buf, &num_bits);
+                                if (decomp_flags & (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_PARSE_GZIP_HEADER | MMZ_TINFL_FLAG_COMPUTE_ADLER32)) { mmz_tinfl_update_check(r, pOut_buf_checked, pOut_buf_cur - pOut_buf_checked); pOut_buf_checked = pOut_buf_cur; }
+                                if ((fast_result) || (pOut_fast_end == pOut_buf_end) || ((size_t)(pIn_buf_end - pIn_buf_cur) < MMZ_TINFL_FAST_INPUT_MARGIN)) break;
+                            }
+                            if (fast_result < 0) {
+                                MMZ_TINFL_CR_RETURN_FOREVER(43, MMZ_TINFL_STATUS_FAILED);
+                            }
+                            if (fast_result > 0) break;
+                        }
                         for ( ; ; ) {
-                            if (((pIn_buf_end - pIn_buf_cur) < 4) || ((pOut_buf_end - pOut_buf_cur) < 2)) {
-                                MMZ_TINFL_HUFF_DECODE(23, counter, &r->m_tables[0]);
-                                if (counter >= 256)
+                            if (((pIn_buf_end - pIn_buf_cur) < 4) || ((pOut_buf_end - pOut_buf_cur) < 3)) {
+                                MMZ_TINFL_HUFF_DECODE_ENTRY(23, counter, &r->m_tables[0], MMZ_TINFL_FAST_LOOKUP_BITS);
+                                if (!(counter & MMZ_TINFL_HUFF_LITERALS))
                                     break;
                                 while (pOut_buf_cur >= pOut_buf_end) { MMZ_TINFL_CR_RETURN(24, MMZ_TINFL_STATUS_HAS_MORE_OUTPUT); }
-                                *pOut_buf_cur++ = (mmz_uint8)counter;
+                                *pOut_buf_cur++ = (mmz_uint8)(counter >> 8);
                             } else {
-                                int sym2; mmz_uint code_len;
-                                if (num_bits < 30) { bit_buf |= (((tinfl_bit_buf_t)MMZ_READ_LE32(pIn_buf_cur)) << num_bits); pIn_buf_cur += 4; num_bits += 32; }
-                                if ((sym2 = r->m_tables[0].m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)]) >= 0)
-                                    code_len = sym2 >> 9;
-                                else {
-                                    code_len = MMZ_TINFL_FAST_LOOKUP_BITS; do { sym2 = r->m_tables[0].m_tree[~sym2 + ((bit_buf >> code_len++) & 1)]; } while (sym2 < 0);
-                                }
-                                counter = sym2; bit_buf >>= code_len; num_bits -= code_len;
-                                if (counter & 256)
+                                mmz_uint32 e; mmz_uint code_len;
+                                if (num_bits < 15) { bit_buf |= (((mmz_tinfl_bit_buf_t)MMZ_READ_LE32(pIn_buf_cur)) << num_bits); pIn_buf_cur += 4; num_bits += 32; }
+                                MMZ_TINFL_HUFF_LOOKUP(e, &r->m_tables[0], MMZ_TINFL_FAST_LOOKUP_BITS);
+                                code_len = e & 15; bit_buf >>= code_len; num_bits -= code_len;
+                                if (!(e & MMZ_TINFL_HUFF_LITERALS)) {
+                                    counter = e;
                                     break;
-                                if ((sym2 = r->m_tables[0].m_look_up[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)]) >= 0)
-                                    code_len = sym2 >> 9;
-                                else {
-                                    code_len = MMZ_TINFL_FAST_LOOKUP_BITS; do { sym2 = r->m_tables[0].m_tree[~sym2 + ((bit_buf >> code_len++) & 1)]; } while (sym2 < 0);
                                 }
-                                bit_buf >>= code_len; num_bits -= code_len;
-                                pOut_buf_cur[0] = (mmz_uint8)counter;
-                                if (sym2 & 256) {
-                                    pOut_buf_cur++;
-                                    counter = sym2;
-                                    break;
+                                // Bytes past the cursor may still be history in a wrapping buffer, so store only the decoded literals.
+                                pOut_buf_cur[0] = (mmz_uint8)(e >> 8);
+                                if (e & MMZ_TINFL_HUFF_MULTI_LITERAL) {
+                                    pOut_buf_cur[1] = (mmz_uint8)(e >> 16);
+                                    if ((e & MMZ_TINFL_HUFF_LITERALS) == MMZ_TINFL_HUFF_LITERALS)
+                                        pOut_buf_cur[2] = (mmz_uint8)(e >> 24);
                                 }
-                                pOut_buf_cur[1] = (mmz_uint8)sym2;
-                                pOut_buf_cur += 2;
+                                pOut_buf_cur += (e >> 4) & 3;
+                            }
+                        }
+                        if (counter & MMZ_TINFL_HUFF_END_OF_BLOCK) {
+                            if (counter >> 16) {
+                                MMZ_TINFL_CR_RETURN_FOREVER(44, MMZ_TINFL_STATUS_FAILED);
                             }
+                            break;
                         }
-                        if ((counter &= 511) == 256) break;
-                        num_extra = s_length_extra[counter - 257]; counter = s_length_base[counter - 257];
+                        num_extra = (counter >> 8) & 15; counter >>= 16;
                         if (num_extra) { mmz_uint extra_bits; MMZ_TINFL_GET_BITS(25, extra_bits, num_extra); counter += extra_bits; }
-                        MMZ_TINFL_HUFF_DECODE(26, dist, &r->m_tables[1]);
-                        num_extra = s_dist_extra[dist]; dist = s_dist_base[dist];
+                        MMZ_TINFL_HUFF_DECODE_ENTRY(26, dist, &r->m_tables[1], MMZ_TINFL_DIST_LOOKUP_BITS);
+                        num_extra = (dist >> 8) & 15; dist >>= 16;
                         if (num_extra) { mmz_uint extra_bits; MMZ_TINFL_GET_BITS(27, extra_bits, num_extra); dist += extra_bits; }
                         dist_from_out_buf_start = pOut_buf_cur - pOut_buf_start;
-                        if ((dist > dist_from_out_buf_start) && (decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) {
+                        // A wrapping buffer's history is what this call wrote plus m_history; anything further back is stale.
+                        if ((!dist) || (dist > r->m_window_size) || (dist > ((decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) ? dist_from_out_buf_start : (r->m_history + (size_t)(pOut_buf_cur - pOut_buf_next))))) {
                             MMZ_TINFL_CR_RETURN_FOREVER(37, MMZ_TINFL_STATUS_FAILED);
                         }
+                        if ((decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) && ((size_t)(pOut_buf_end - pOut_buf_cur) >= counter + MMZ_TINFL_MATCH_COPY_SLACK)) {
+                            mmz_tinfl_copy_match(pOut_buf_cur, counter, dist); pOut_buf_cur += counter;
+                            continue;
+                        }
                         pSrc = pOut_buf_start + ((dist_from_out_buf_start - dist) & out_buf_size_mask);
                         if ((MMZ_MAX(pOut_buf_cur, pSrc) + counter) > pOut_buf_end) {
                             while (counter--) {
@@ -494,6 +1225,17 @@ mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8
                             }
                             continue;
                         }
+                        else if (dist == 1) {
+                            MMZ_TINFL_MEMSET(pOut_buf_cur, pSrc[0], counter); pOut_buf_cur += counter;
+                            continue;
+                        }
+                        else if ((counter >= 16) && (dist >= 16)) {
+                            // Bytes past the match may still be history in a wrapping buffer, so finish with a 16 byte copy ending exactly at the match end.
+                            mmz_uint8 *pOut_end = pOut_buf_cur + counter;
+                            do { memcpy(pOut_buf_cur, pSrc, 16); pOut_buf_cur += 16; pSrc += 16; } while (pOut_end - pOut_buf_cur >= 16);
+                            memcpy(pOut_end - 16, pSrc - (pOut_buf_cur - (pOut_end - 16)), 16); pOut_buf_cur = pOut_end;
+                            continue;
+                        }
                         else if ((counter >= 9) && (counter <= dist)) {
                             const mmz_uint8 *pSrc_end = pSrc + (counter & ~7);
                             do {
@@ -526,41 +1268,1657 @@ mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8
                     }
                 }
             } while (!(r->m_final & 1));
-            if (decomp_flags & MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER)
+            if (r->m_gzip)
+            {
+                // CRC-32 then ISIZE, both little endian. ISIZE counts this call's output that hasn't gone through the check yet.
+                MMZ_TINFL_SKIP_BITS(67, num_bits & 7); dist = 0;
+                for (counter = 0; counter < 8; ++counter) {
+                    mmz_uint s; if (num_bits) MMZ_TINFL_GET_BITS(68, s, 8); else MMZ_TINFL_GET_BYTE(69, s);
+                    if (counter < 4) r->m_z_adler32 |= s << (counter * 8); else dist |= s << ((counter - 4) * 8);
+                }
+                if (dist != r->m_gz_isize + (mmz_uint32)(pOut_buf_cur - pOut_buf_checked)) { MMZ_TINFL_CR_RETURN_FOREVER(70, MMZ_TINFL_STATUS_FAILED); }
+            }
+            else if (decomp_flags & MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER)
             {
                 MMZ_TINFL_SKIP_BITS(32, num_bits & 7); for (counter = 0; counter < 4; ++counter) { mmz_uint s; if (num_bits) MMZ_TINFL_GET_BITS(41, s, 8); else MMZ_TINFL_GET_BYTE(42, s); r->m_z_adler32 = (r->m_z_adler32 << 8) | s; }
             }
             MMZ_TINFL_CR_RETURN_FOREVER(34, MMZ_TINFL_STATUS_DONE);
     MMZ_TINFL_CR_FINISH
     common_exit:
+    // The bit buffer may have read ahead past the end of the stream (into the next member, say), so give whole unused bytes back, as zlib's
+    // inflate_fast() does, whenever the decoder stops with input left. Running out of input only leaves bits that the pending code needs.
+    if ((status != MMZ_TINFL_STATUS_NEEDS_MORE_INPUT) && (status != MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS)) {
+        while ((pIn_buf_cur > pIn_buf_next) && (num_bits >= 8)) { pIn_buf_cur--; num_bits -= 8; }
+        bit_buf &= (((mmz_tinfl_bit_buf_t)1) << num_bits) - 1;
+    }
     r->m_num_bits = num_bits; r->m_bit_buf = bit_buf; r->m_dist = dist; r->m_counter = counter; r->m_num_extra = num_extra; r->m_dist_from_out_buf_start = dist_from_out_buf_start;
+    if (!(decomp_flags & MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) r->m_history = (mmz_uint32)MMZ_MIN(r->m_history + (size_t)(pOut_buf_cur - pOut_buf_next), out_buf_size_mask + 1);
     *pIn_buf_size = pIn_buf_cur - pIn_buf_next; *pOut_buf_size = pOut_buf_cur - pOut_buf_next;
-    if ((decomp_flags & (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_COMPUTE_ADLER32)) && (status >= 0))
+    if ((decomp_flags & (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_PARSE_GZIP_HEADER | MMZ_TINFL_FLAG_COMPUTE_ADLER32)) && ((status >= 0) || (status == MMZ_TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS)))
     {
-        const mmz_uint8 *ptr = pOut_buf_next; size_t buf_len = *pOut_buf_size;
-        mmz_uint32 i, s1 = r->m_check_adler32 & 0xffff, s2 = r->m_check_adler32 >> 16; size_t block_len = buf_len % 5552;
-        while (buf_len)
-        {
-            for (i = 0; i + 7 < block_len; i += 8, ptr += 8)
-            {
-                s1 += ptr[0], s2 += s1; s1 += ptr[1], s2 += s1; s1 += ptr[2], s2 += s1; s1 += ptr[3], s2 += s1;
-                s1 += ptr[4], s2 += s1; s1 += ptr[5], s2 += s1; s1 += ptr[6], s2 += s1; s1 += ptr[7], s2 += s1;
+        mmz_tinfl_update_check(r, pOut_buf_checked, pOut_buf_cur - pOut_buf_checked);
+        if ((status == MMZ_TINFL_STATUS_DONE) && (decomp_flags & (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_PARSE_GZIP_HEADER)) && (r->m_check_adler32 != r->m_z_adler32)) status = MMZ_TINFL_STATUS_ADLER32_MISMATCH;
+    }
+    return status;
+}
+#ifdef __cplusplus
+// One instance per combination of the two flags the per-symbol paths test: HAS_MORE_INPUT (every input byte) and USING_NON_WRAPPING_OUTPUT_BUF
+// (every output byte and match). The other flags only matter at headers and block boundaries and stay runtime values.
+extern "C++" {
+template <mmz_uint32 Flags>
+static mmz_tinfl_status mmz_tinfl_decompress_t(mmz_tinfl_decompressor *r, const mmz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mmz_uint8 *pOut_buf_start, mmz_uint8 *pOut_buf_next, size_t *pOut_buf_size, mmz_uint32 decomp_flags) {
+    const mmz_uint32 kSpecialized = MMZ_TINFL_FLAG_HAS_MORE_INPUT | MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+    return mmz_tinfl_decompress_core(r, pIn_buf_next, pIn_buf_size, pOut_buf_start, pOut_buf_next, pOut_buf_size, (decomp_flags & ~kSpecialized) | Flags);
+}
+}
+#endif
+mmz_tinfl_status mmz_tinfl_decompress(mmz_tinfl_decompressor *r, const mmz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mmz_uint8 *pOut_buf_start, mmz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mmz_uint32 decomp_flags) {
+#ifdef __cplusplus
+    switch (decomp_flags & (MMZ_TINFL_FLAG_HAS_MORE_INPUT | MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) {
+        case 0: return mmz_tinfl_decompress_t<0>(r, pIn_buf_next, pIn_buf_size, pOut_buf_start, pOut_buf_next, pOut_buf_size, decomp_flags);
+        case MMZ_TINFL_FLAG_HAS_MORE_INPUT: return mmz_tinfl_decompress_t<MMZ_TINFL_FLAG_HAS_MORE_INPUT>(r, pIn_buf_next, pIn_buf_size, pOut_buf_start, pOut_buf_next, pOut_buf_size, decomp_flags);
+        case MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF: return mmz_tinfl_decompress_t<MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF>(r, pIn_buf_next, pIn_buf_size, pOut_buf_start, pOut_buf_next, pOut_buf_size, decomp_flags);
+        default: return mmz_tinfl_decompress_t<MMZ_TINFL_FLAG_HAS_MORE_INPUT | MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF>(r, pIn_buf_next, pIn_buf_size, pOut_buf_start, pOut_buf_next, pOut_buf_size, decomp_flags);
+    }
+#else
+    return mmz_tinfl_decompress_core(r, pIn_buf_next, pIn_buf_size, pOut_buf_start, pOut_buf_next, pOut_buf_size, decomp_flags);
+#endif
+}
+void mmz_tinfl_init_at_block(mmz_tinfl_decompressor *r, mmz_uint32 bits, mmz_uint32 num_bits) {
+    r->m_state = 71;
+    r->m_num_bits = num_bits; r->m_bit_buf = bits & ((1U << num_bits) - 1);
+    r->m_dist = r->m_counter = r->m_num_extra = r->m_final = 0; r->m_dist_from_out_buf_start = 0; r->m_window_size = MMZ_TINFL_LZ_DICT_SIZE; r->m_history = 0;
+    r->m_zhdr0 = r->m_zhdr1 = r->m_gzip = 0; r->m_z_adler32 = r->m_check_adler32 = 1;
+}
+
+// Purposely making these tables static for faster init and thread safety.
+static const mmz_uint16 s_mmz_tdefl_len_sym[256] = {
+    257,258,259,260,261,262,263,264,265,265,266,266,267,267,268,268,269,269,269,269,270,270,270,270,271,271,271,271,272,272,272,272,
+    273,273,273,273,273,273,273,273,274,274,274,274,274,274,274,274,275,275,275,275,275,275,275,275,276,276,276,276,276,276,276,276,
+    277,277,277,277,277,277,277,277,277,277,277,277,277,277,277,277,278,278,278,278,278,278,278,278,278,278,278,278,278,278,278,278,
+    279,279,279,279,279,279,279,279,279,279,279,279,279,279,279,279,280,280,280,280,280,280,280,280,280,280,280,280,280,280,280,280,
+    281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,281,
+    282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,282,
+    283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,283,
+    284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,284,285 };
+static const mmz_uint8 s_mmz_tdefl_len_extra[256] = {
+    0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
+    5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,0 };
+static const mmz_uint8 s_mmz_tdefl_small_dist_sym[512] = {
+    0,1,2,3,4,4,5,5,6,6,6,6,7,7,7,7,8,8,8,8,8,8,8,8,9,9,9,9,9,9,9,9,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,10,11,11,11,11,11,11,
+    11,11,11,11,11,11,11,11,11,11,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,13,
+    13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,14,14,14,14,14,14,14,14,14,14,14,14,
+    14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,14,
+    14,14,14,14,14,14,14,14,14,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,
+    15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,16,16,16,16,16,16,16,16,16,16,16,16,16,
+    16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+    16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,
+    16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,16,17,17,17,17,17,17,17,17,17,17,17,17,17,17,
+    17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,
+    17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,
+    17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17,17 };
+static const mmz_uint8 s_mmz_tdefl_small_dist_extra[512] = {
+    0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,5,5,5,5,5,5,5,5,
+    5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+    6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+    6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,
+    7,7,7,7,7,7,7,7 };
+static const mmz_uint8 s_mmz_tdefl_large_dist_sym[128] = {
+    0,0,18,19,20,20,21,21,22,22,22,22,23,23,23,23,24,24,24,24,24,24,24,24,25,25,25,25,25,25,25,25,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,27,27,27,27,27,27,27,27,27,27,27,27,27,27,27,27,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,28,
+    28,28,28,28,28,28,28,28,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29 };
+static const mmz_uint8 s_mmz_tdefl_large_dist_extra[128] = {
+    0,0,8,8,9,9,9,9,10,10,10,10,10,10,10,10,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,11,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,
+    12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,12,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,
+    13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13,13 };
+// Radix sorts mmz_tdefl_sym_freq[] array by 16-bit key m_key. Returns ptr to sorted values.
+typedef struct { mmz_uint16 m_key, m_sym_index; } mmz_tdefl_sym_freq;
+static mmz_tdefl_sym_freq* mmz_tdefl_radix_sort_syms(mmz_uint num_syms, mmz_tdefl_sym_freq* pSyms0, mmz_tdefl_sym_freq* pSyms1) {
+    mmz_uint32 total_passes = 2, pass_shift, pass, i, hist[256 * 2]; mmz_tdefl_sym_freq* pCur_syms = pSyms0, *pNew_syms = pSyms1; MMZ_CLEAR_OBJ(hist);
+    for (i = 0; i < num_syms; i++) { mmz_uint freq = pSyms0[i].m_key; hist[freq & 0xFF]++; hist[256 + ((freq >> 8) & 0xFF)]++; }
+    while ((total_passes > 1) && (num_syms == hist[(total_passes - 1) * 256])) total_passes--;
+    for (pass_shift = 0, pass = 0; pass < total_passes; pass++, pass_shift += 8) {
+        const mmz_uint32* pHist = &hist[pass << 8];
+        mmz_uint offsets[256], cur_ofs = 0;
+        for (i = 0; i < 256; i++) { offsets[i] = cur_ofs; cur_ofs += pHist[i]; }
+        for (i = 0; i < num_syms; i++) pNew_syms[offsets[(pCur_syms[i].m_key >> pass_shift) & 0xFF]++] = pCur_syms[i];
+        { mmz_tdefl_sym_freq* t = pCur_syms; pCur_syms = pNew_syms; pNew_syms = t; }
+    }
+    return pCur_syms;
+}
+// mmz_tdefl_calculate_minimum_redundancy() originally written by: Alistair Moffat, alistair@cs.mu.oz.au, Jyrki Katajainen, jyrki@diku.dk, November 1996.
+static void mmz_tdefl_calculate_minimum_redundancy(mmz_tdefl_sym_freq *A, int n) {
+    int root, leaf, next, avbl, used, dpth;
+    if (n==0) return; else if (n==1) { A[0].m_key = 1; return; }
+    A[0].m_key += A[1].m_key; root = 0; leaf = 2;
+    for (next=1; next < n-1; next++) {
+        if (leaf>=n || A[root].m_key<A[leaf].m_key) { A[next].m_key = A[root].m_key; A[root++].m_key = (mmz_uint16)next; } else A[next].m_key = A[leaf++].m_key;
+        if (leaf>=n || (root<next && A[root].m_key<A[leaf].m_key)) { A[next].m_key = (mmz_uint16)(A[next].m_key + A[root].m_key); A[root++].m_key = (mmz_uint16)next; } else A[next].m_key = (mmz_uint16)(A[next].m_key + A[leaf++].m_key);
+    }
+    A[n-2].m_key = 0; for (next=n-3; next>=0; next--) A[next].m_key = A[A[next].m_key].m_key+1;
+    avbl = 1; used = dpth = 0; root = n-2; next = n-1;
+    while (avbl>0) {
+        while (root>=0 && (int)A[root].m_key==dpth) { used++; root--; }
+        while (avbl>used) { A[next--].m_key = (mmz_uint16)(dpth); avbl--; }
+        avbl = 2*used; dpth++; used = 0;
+    }
+}
+// Limits canonical Huffman code table's max code size.
+enum { MMZ_TDEFL_MAX_SUPPORTED_HUFF_CODESIZE = 32 };
+static void mmz_tdefl_huffman_enforce_max_code_size(int *pNum_codes, int code_list_len, int max_code_size) {
+    int i; mmz_uint32 total = 0; if (code_list_len <= 1) return;
+    for (i = max_code_size + 1; i <= MMZ_TDEFL_MAX_SUPPORTED_HUFF_CODESIZE; i++) pNum_codes[max_code_size] += pNum_codes[i];
+    for (i = max_code_size; i > 0; i--) total += (((mmz_uint32)pNum_codes[i]) << (max_code_size - i));
+    while (total != (1UL << max_code_size)) {
+        pNum_codes[max_code_size]--;
+        for (i = max_code_size - 1; i > 0; i--) if (pNum_codes[i]) { pNum_codes[i]--; pNum_codes[i + 1] += 2; break; }
+        total--;
+    }
+}
+static void mmz_tdefl_optimize_huffman_table(mmz_tdefl_compressor *d, int table_num, int table_len, int code_size_limit, int static_table) {
+    int i, j, l, num_codes[1 + MMZ_TDEFL_MAX_SUPPORTED_HUFF_CODESIZE]; mmz_uint next_code[MMZ_TDEFL_MAX_SUPPORTED_HUFF_CODESIZE + 1]; MMZ_CLEAR_OBJ(num_codes);
+    if (static_table) {
+        for (i = 0; i < table_len; i++) num_codes[d->m_huff_code_sizes[table_num][i]]++;
+    } else {
+        mmz_tdefl_sym_freq syms0[MMZ_TDEFL_MAX_HUFF_SYMBOLS], syms1[MMZ_TDEFL_MAX_HUFF_SYMBOLS], *pSyms;
+        int num_used_syms = 0;
+        const mmz_uint16 *pSym_count = &d->m_huff_count[table_num][0];
+        for (i = 0; i < table_len; i++) if (pSym_count[i]) { syms0[num_used_syms].m_key = (mmz_uint16)pSym_count[i]; syms0[num_used_syms++].m_sym_index = (mmz_uint16)i; }
+        pSyms = mmz_tdefl_radix_sort_syms(num_used_syms, syms0, syms1); mmz_tdefl_calculate_minimum_redundancy(pSyms, num_used_syms);
+        for (i = 0; i < num_used_syms; i++) num_codes[pSyms[i].m_key]++;
+        mmz_tdefl_huffman_enforce_max_code_size(num_codes, num_used_syms, code_size_limit);
+        MMZ_CLEAR_OBJ(d->m_huff_code_sizes[table_num]); MMZ_CLEAR_OBJ(d->m_huff_codes[table_num]);
+        for (i = 1, j = num_used_syms; i <= code_size_limit; i++)
+            for (l = num_codes[i]; l > 0; l--) d->m_huff_code_sizes[table_num][pSyms[--j].m_sym_index] = (mmz_uint8)(i);
+    }
+    next_code[1] = 0; for (j = 0, i = 2; i <= code_size_limit; i++) next_code[i] = j = ((j + num_codes[i - 1]) << 1);
+    for (i = 0; i < table_len; i++) {
+        mmz_uint rev_code = 0, code, code_size; if ((code_size = d->m_huff_code_sizes[table_num][i]) == 0) continue;
+        code = next_code[code_size]++; for (l = code_size; l > 0; l--, code >>= 1) rev_code = (rev_code << 1) | (code & 1);
+        d->m_huff_codes[table_num][i] = (mmz_uint16)rev_code;
+    }
+}
+#define MMZ_TDEFL_PUT_BITS(b, l) do { \
+    mmz_uint bits = b; mmz_uint len = l; \
+    d->m_bit_buffer |= (bits << d->m_bits_in); d->m_bits_in += len; \
+    while (d->m_bits_in >= 8) { \
+        if (d->m_pOutput_buf < d->m_pOutput_buf_end) \
+            *d->m_pOutput_buf++ = (mmz_uint8)(d->m_bit_buffer); \
+        d->m_bit_buffer >>= 8; \
+        d->m_bits_in -= 8; \
+    } \
+} MMZ_MACRO_END
+#define MMZ_TDEFL_RLE_PREV_CODE_SIZE() { if (rle_repeat_count) { \
+    if (rle_repeat_count < 3) { \
+        d->m_huff_count[2][prev_code_size] = (mmz_uint16)(d->m_huff_count[2][prev_code_size] + rle_repeat_count); \
+        while (rle_repeat_count--) packed_code_sizes[num_packed_code_sizes++] = prev_code_size; \
+    } else { \
+        d->m_huff_count[2][16] = (mmz_uint16)(d->m_huff_count[2][16] + 1); packed_code_sizes[num_packed_code_sizes++] = 16; packed_code_sizes[num_packed_code_sizes++] = (mmz_uint8)(rle_repeat_count - 3); \
+} rle_repeat_count = 0; } }
+#define MMZ_TDEFL_RLE_ZERO_CODE_SIZE() { if (rle_z_count) { \
+    if (rle_z_count < 3) { \
+        d->m_huff_count[2][0] = (mmz_uint16)(d->m_huff_count[2][0] + rle_z_count); while (rle_z_count--) packed_code_sizes[num_packed_code_sizes++] = 0; \
+    } else if (rle_z_count <= 10) { \
+        d->m_huff_count[2][17] = (mmz_uint16)(d->m_huff_count[2][17] + 1); packed_code_sizes[num_packed_code_sizes++] = 17; packed_code_sizes[num_packed_code_sizes++] = (mmz_uint8)(rle_z_count - 3); \
+    } else { \
+        d->m_huff_count[2][18] = (mmz_uint16)(d->m_huff_count[2][18] + 1); packed_code_sizes[num_packed_code_sizes++] = 18; packed_code_sizes[num_packed_code_sizes++] = (mmz_uint8)(rle_z_count - 11); \
+} rle_z_count = 0; } }
+static mmz_uint8 s_mmz_tdefl_packed_code_size_syms_swizzle[] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+static void mmz_tdefl_start_dynamic_block(mmz_tdefl_compressor *d) {
+    int num_lit_codes, num_dist_codes, num_bit_lengths; mmz_uint i, total_code_sizes_to_pack, num_packed_code_sizes, rle_z_count, rle_repeat_count, packed_code_sizes_index;
+    mmz_uint8 code_sizes_to_pack[MMZ_TDEFL_MAX_HUFF_SYMBOLS_0 + MMZ_TDEFL_MAX_HUFF_SYMBOLS_1], packed_code_sizes[MMZ_TDEFL_MAX_HUFF_SYMBOLS_0 + MMZ_TDEFL_MAX_HUFF_SYMBOLS_1], prev_code_size = 0xFF;
+    d->m_huff_count[0][256] = 1;
+    mmz_tdefl_optimize_huffman_table(d, 0, MMZ_TDEFL_MAX_HUFF_SYMBOLS_0, 15, MMZ_FALSE);
+    mmz_tdefl_optimize_huffman_table(d, 1, MMZ_TDEFL_MAX_HUFF_SYMBOLS_1, 15, MMZ_FALSE);
+    for (num_lit_codes = 286; num_lit_codes > 257; num_lit_codes--) if (d->m_huff_code_sizes[0][num_lit_codes - 1]) break;
+    for (num_dist_codes = 30; num_dist_codes > 1; num_dist_codes--) if (d->m_huff_code_sizes[1][num_dist_codes - 1]) break;
+    memcpy(code_sizes_to_pack, &d->m_huff_code_sizes[0][0], num_lit_codes);
+    memcpy(code_sizes_to_pack + num_lit_codes, &d->m_huff_code_sizes[1][0], num_dist_codes);
+    total_code_sizes_to_pack = num_lit_codes + num_dist_codes; num_packed_code_sizes = 0; rle_z_count = 0; rle_repeat_count = 0;
+    memset(&d->m_huff_count[2][0], 0, sizeof(d->m_huff_count[2][0]) * MMZ_TDEFL_MAX_HUFF_SYMBOLS_2);
+    for (i = 0; i < total_code_sizes_to_pack; i++) {
+        mmz_uint8 code_size = code_sizes_to_pack[i];
+        if (!code_size) {
+            MMZ_TDEFL_RLE_PREV_CODE_SIZE();
+            if (++rle_z_count == 138) { MMZ_TDEFL_RLE_ZERO_CODE_SIZE(); }
+        } else {
+            MMZ_TDEFL_RLE_ZERO_CODE_SIZE();
+            if (code_size != prev_code_size) {
+                MMZ_TDEFL_RLE_PREV_CODE_SIZE();
+                d->m_huff_count[2][code_size] = (mmz_uint16)(d->m_huff_count[2][code_size] + 1); packed_code_sizes[num_packed_code_sizes++] = code_size;
+            } else if (++rle_repeat_count == 6) {
+                MMZ_TDEFL_RLE_PREV_CODE_SIZE();
+            }
+        }
+        prev_code_size = code_size;
+    }
+    if (rle_repeat_count) { MMZ_TDEFL_RLE_PREV_CODE_SIZE(); } else { MMZ_TDEFL_RLE_ZERO_CODE_SIZE(); }
+    mmz_tdefl_optimize_huffman_table(d, 2, MMZ_TDEFL_MAX_HUFF_SYMBOLS_2, 7, MMZ_FALSE);
+    MMZ_TDEFL_PUT_BITS(2, 2);
+    MMZ_TDEFL_PUT_BITS(num_lit_codes - 257, 5);
+    MMZ_TDEFL_PUT_BITS(num_dist_codes - 1, 5);
+    for (num_bit_lengths = 18; num_bit_lengths >= 0; num_bit_lengths--) if (d->m_huff_code_sizes[2][s_mmz_tdefl_packed_code_size_syms_swizzle[num_bit_lengths]]) break;
+    num_bit_lengths = MMZ_MAX(4, (num_bit_lengths + 1)); MMZ_TDEFL_PUT_BITS(num_bit_lengths - 4, 4);
+    for (i = 0; (int)i < num_bit_lengths; i++) MMZ_TDEFL_PUT_BITS(d->m_huff_code_sizes[2][s_mmz_tdefl_packed_code_size_syms_swizzle[i]], 3);
+    for (packed_code_sizes_index = 0; packed_code_sizes_index < num_packed_code_sizes; ) {
+        mmz_uint code = packed_code_sizes[packed_code_sizes_index++];
+        MMZ_TDEFL_PUT_BITS(d->m_huff_codes[2][code], d->m_huff_code_sizes[2][code]);
+        if (code >= 16) MMZ_TDEFL_PUT_BITS(packed_code_sizes[packed_code_sizes_index++], "\02\03\07"[code - 16]);
+    }
+}
+static void mmz_tdefl_start_static_block(mmz_tdefl_compressor *d) {
+    mmz_uint i;
+    mmz_uint8 *p = &d->m_huff_code_sizes[0][0];
+    for (i = 0; i <= 143; ++i) *p++ = 8;
+    for ( ; i <= 255; ++i) *p++ = 9;
+    for ( ; i <= 279; ++i) *p++ = 7;
+    for ( ; i <= 287; ++i) *p++ = 8;
+    memset(d->m_huff_code_sizes[1], 5, 32);
+    mmz_tdefl_optimize_huffman_table(d, 0, 288, 15, MMZ_TRUE);
+    mmz_tdefl_optimize_huffman_table(d, 1, 32, 15, MMZ_TRUE);
+    MMZ_TDEFL_PUT_BITS(1, 2);
+}
+static const mmz_uint mmz_bitmasks[17] = { 0x0000, 0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x003F, 0x007F, 0x00FF, 0x01FF, 0x03FF, 0x07FF, 0x0FFF, 0x1FFF, 0x3FFF, 0x7FFF, 0xFFFF };
+static mmz_bool mmz_tdefl_compress_lz_codes(mmz_tdefl_compressor *d) {
+    mmz_uint flags;
+    mmz_uint8 *pLZ_codes;
+    mmz_uint8 *pOutput_buf = d->m_pOutput_buf;
+    mmz_uint8 *pLZ_code_buf_end = d->m_pLZ_code_buf;
+    mmz_uint64 bit_buffer = d->m_bit_buffer;
+    mmz_uint bits_in = d->m_bits_in;
+#define MMZ_TDEFL_PUT_BITS_FAST(b, l) { bit_buffer |= (((mmz_uint64)(b)) << bits_in); bits_in += (l); }
+    flags = 1;
+    for (pLZ_codes = d->m_lz_code_buf; pLZ_codes < pLZ_code_buf_end; flags >>= 1) {
+        if (flags == 1)
+            flags = *pLZ_codes++ | 0x100;
+        if (flags & 1) {
+            mmz_uint s0, s1, n0, n1, sym, num_extra_bits;
+            mmz_uint match_len = pLZ_codes[0], match_dist = MMZ_READ_LE16(pLZ_codes + 1); pLZ_codes += 3;
+            MMZ_TDEFL_PUT_BITS_FAST(d->m_huff_codes[0][s_mmz_tdefl_len_sym[match_len]], d->m_huff_code_sizes[0][s_mmz_tdefl_len_sym[match_len]]);
+            MMZ_TDEFL_PUT_BITS_FAST(match_len & mmz_bitmasks[s_mmz_tdefl_len_extra[match_len]], s_mmz_tdefl_len_extra[match_len]);
+            // This sequence coaxes MSVC into using cmov's vs. jmp's.
+            s0 = s_mmz_tdefl_small_dist_sym[match_dist & 511];
+            n0 = s_mmz_tdefl_small_dist_extra[match_dist & 511];
+            s1 = s_mmz_tdefl_large_dist_sym[match_dist >> 8];
+            n1 = s_mmz_tdefl_large_dist_extra[match_dist >> 8];
+            sym = (match_dist < 512) ? s0 : s1;
+            num_extra_bits = (match_dist < 512) ? n0 : n1;
+            MMZ_TDEFL_PUT_BITS_FAST(d->m_huff_codes[1][sym], d->m_huff_code_sizes[1][sym]);
+            MMZ_TDEFL_PUT_BITS_FAST(match_dist & mmz_bitmasks[num_extra_bits], num_extra_bits);
+        } else {
+            mmz_uint lit = *pLZ_codes++;
+            MMZ_TDEFL_PUT_BITS_FAST(d->m_huff_codes[0][lit], d->m_huff_code_sizes[0][lit]);
+            if (((flags & 2) == 0) && (pLZ_codes < pLZ_code_buf_end)) {
+                flags >>= 1;
+                lit = *pLZ_codes++;
+                MMZ_TDEFL_PUT_BITS_FAST(d->m_huff_codes[0][lit], d->m_huff_code_sizes[0][lit]);
+                if (((flags & 2) == 0) && (pLZ_codes < pLZ_code_buf_end)) {
+                    flags >>= 1;
+                    lit = *pLZ_codes++;
+                    MMZ_TDEFL_PUT_BITS_FAST(d->m_huff_codes[0][lit], d->m_huff_code_sizes[0][lit]);
+                }
+            }
+        }
+        if (pOutput_buf >= d->m_pOutput_buf_end)
+            return MMZ_FALSE;
+        *(mmz_uint64*)pOutput_buf = bit_buffer;
+        pOutput_buf += (bits_in >> 3);
+        bit_buffer >>= (bits_in & ~7);
+        bits_in &= 7;
+    }
+#undef MMZ_TDEFL_PUT_BITS_FAST
+    d->m_pOutput_buf = pOutput_buf;
+    d->m_bits_in = 0;
+    d->m_bit_buffer = 0;
+    while (bits_in) {
+        mmz_uint32 n = MMZ_MIN(bits_in, 16);
+        MMZ_TDEFL_PUT_BITS((mmz_uint)bit_buffer & mmz_bitmasks[n], n);
+        bit_buffer >>= n;
+        bits_in -= n;
+    }
+    MMZ_TDEFL_PUT_BITS(d->m_huff_codes[0][256], d->m_huff_code_sizes[0][256]);
+    return (d->m_pOutput_buf < d->m_pOutput_buf_end);
+}
+static mmz_bool mmz_tdefl_compress_block(mmz_tdefl_compressor *d, mmz_bool static_block) {
+    if (static_block)
+        mmz_tdefl_start_static_block(d);
+    else
+        mmz_tdefl_start_dynamic_block(d);
+    return mmz_tdefl_compress_lz_codes(d);
+}
+static int mmz_tdefl_flush_block(mmz_tdefl_compressor *d, int flush) {
+    mmz_uint saved_bit_buf, saved_bits_in;
+    mmz_uint8 *pSaved_output_buf;
+    mmz_bool comp_block_succeeded = MMZ_FALSE;
+    int n, use_raw_block = ((d->m_flags & MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS) != 0) && (d->m_lookahead_pos - d->m_lz_code_buf_dict_pos) <= d->m_dict_size;
+    mmz_uint8 *pOutput_buf_start = ((d->m_pPut_buf_func == NULL) && ((*d->m_pOut_buf_size - d->m_out_buf_ofs) >= MMZ_TDEFL_OUT_BUF_SIZE)) ? ((mmz_uint8 *)d->m_pOut_buf + d->m_out_buf_ofs) : d->m_output_buf;
+    d->m_pOutput_buf = pOutput_buf_start;
+    d->m_pOutput_buf_end = d->m_pOutput_buf + MMZ_TDEFL_OUT_BUF_SIZE - 16;
+    d->m_output_flush_ofs = 0;
+    d->m_output_flush_remaining = 0;
+    *d->m_pLZ_flags = (mmz_uint8)(*d->m_pLZ_flags >> d->m_num_flags_left);
+    d->m_pLZ_code_buf -= (d->m_num_flags_left == 8);
+    if ((d->m_flags & MMZ_TDEFL_WRITE_ZLIB_HEADER) && (!d->m_block_index)) {
+        MMZ_TDEFL_PUT_BITS(0x78, 8); MMZ_TDEFL_PUT_BITS(0x01, 8);
+    }
+    MMZ_TDEFL_PUT_BITS(flush == MMZ_TDEFL_FINISH, 1);
+    pSaved_output_buf = d->m_pOutput_buf; saved_bit_buf = d->m_bit_buffer; saved_bits_in = d->m_bits_in;
+    if (!use_raw_block)
+        comp_block_succeeded = mmz_tdefl_compress_block(d, (d->m_flags & MMZ_TDEFL_FORCE_ALL_STATIC_BLOCKS) || (d->m_total_lz_bytes < 48));
+    // If the block gets expanded, forget the current contents of the output buffer and send a raw block instead.
+    if ( ((use_raw_block) || ((d->m_total_lz_bytes) && ((d->m_pOutput_buf - pSaved_output_buf + 1U) >= d->m_total_lz_bytes))) &&
+              ((d->m_lookahead_pos - d->m_lz_code_buf_dict_pos) <= d->m_dict_size) ) {
+        mmz_uint i; d->m_pOutput_buf = pSaved_output_buf; d->m_bit_buffer = saved_bit_buf, d->m_bits_in = saved_bits_in;
+        MMZ_TDEFL_PUT_BITS(0, 2);
+        if (d->m_bits_in) { MMZ_TDEFL_PUT_BITS(0, 8 - d->m_bits_in); }
+        for (i = 2; i; --i, d->m_total_lz_bytes ^= 0xFFFF) {
+            MMZ_TDEFL_PUT_BITS(d->m_total_lz_bytes & 0xFFFF, 16);
+        }
+        for (i = 0; i < d->m_total_lz_bytes; ++i) {
+            MMZ_TDEFL_PUT_BITS(d->m_dict[(d->m_lz_code_buf_dict_pos + i) & MMZ_TDEFL_LZ_DICT_SIZE_MASK], 8);
+        }
+    }
+    // Check for the extremely unlikely (if not impossible) case of the compressed block not fitting into the output buffer when using dynamic codes.
+    else if (!comp_block_succeeded) {
+        d->m_pOutput_buf = pSaved_output_buf; d->m_bit_buffer = saved_bit_buf, d->m_bits_in = saved_bits_in;
+        mmz_tdefl_compress_block(d, MMZ_TRUE);
+    }
+    if (flush) {
+        if (flush == MMZ_TDEFL_FINISH) {
+            if (d->m_bits_in) { MMZ_TDEFL_PUT_BITS(0, 8 - d->m_bits_in); }
+            if (d->m_flags & MMZ_TDEFL_WRITE_ZLIB_HEADER) { mmz_uint i, a = d->m_adler32; for (i = 0; i < 4; i++) { MMZ_TDEFL_PUT_BITS((a >> 24) & 0xFF, 8); a <<= 8; } }
+        } else {
+            mmz_uint i, z = 0; MMZ_TDEFL_PUT_BITS(0, 3); if (d->m_bits_in) { MMZ_TDEFL_PUT_BITS(0, 8 - d->m_bits_in); } for (i = 2; i; --i, z ^= 0xFFFF) { MMZ_TDEFL_PUT_BITS(z & 0xFFFF, 16); }
+        }
+    }
+    memset(&d->m_huff_count[0][0], 0, sizeof(d->m_huff_count[0][0]) * MMZ_TDEFL_MAX_HUFF_SYMBOLS_0);
+    memset(&d->m_huff_count[1][0], 0, sizeof(d->m_huff_count[1][0]) * MMZ_TDEFL_MAX_HUFF_SYMBOLS_1);
+    d->m_pLZ_code_buf = d->m_lz_code_buf + 1; d->m_pLZ_flags = d->m_lz_code_buf; d->m_num_flags_left = 8; d->m_lz_code_buf_dict_pos += d->m_total_lz_bytes; d->m_total_lz_bytes = 0; d->m_block_index++;
+    if ((n = (int)(d->m_pOutput_buf - pOutput_buf_start)) != 0) {
+        if (d->m_pPut_buf_func) {
+            *d->m_pIn_buf_size = d->m_pSrc - (const mmz_uint8 *)d->m_pIn_buf;
+            if (!(*d->m_pPut_buf_func)(d->m_output_buf, n, d->m_pPut_buf_user))
+                return (d->m_prev_return_status = MMZ_TDEFL_STATUS_PUT_BUF_FAILED);
+        } else if (pOutput_buf_start == d->m_output_buf) {
+            int bytes_to_copy = (int)MMZ_MIN((size_t)n, (size_t)(*d->m_pOut_buf_size - d->m_out_buf_ofs));
+            memcpy((mmz_uint8 *)d->m_pOut_buf + d->m_out_buf_ofs, d->m_output_buf, bytes_to_copy);
+            d->m_out_buf_ofs += bytes_to_copy;
+            if ((n -= bytes_to_copy) != 0) {
+                d->m_output_flush_ofs = bytes_to_copy;
+                d->m_output_flush_remaining = n;
+            }
+        } else {
+            d->m_out_buf_ofs += n;
+        }
+    }
+    return d->m_output_flush_remaining;
+}
+#define MMZ_TDEFL_READ_UNALIGNED_WORD(p) MMZ_READ_LE16(p)
+// Length of the common prefix of p and q, at most MMZ_TDEFL_MAX_MATCH_LEN, compared eight bytes at a time. Reads up to that many bytes from
+// both, which the mirrored tail of m_dict always has room for.
+static MMZ_FORCEINLINE mmz_uint mmz_tdefl_match_len(const mmz_uint8 *p, const mmz_uint8 *q) {
+    mmz_uint len;
+    for (len = 0; len < 256; len += 8) {
+        mmz_uint64 x = MMZ_READ_LE64(p + len) ^ MMZ_READ_LE64(q + len);
+        if (x) {
+#if defined(__GNUC__) || defined(__clang__)
+            return len + ((mmz_uint)__builtin_ctzll(x) >> 3);
+#else
+            while (!(x & 0xFF)) { x >>= 8; len++; }
+            return len;
+#endif
+        }
+    }
+    return (p[256] != q[256]) ? 256 : (p[257] != q[257]) ? 257 : 258;
+}
+static MMZ_FORCEINLINE void mmz_tdefl_find_match(mmz_tdefl_compressor *d, mmz_uint lookahead_pos, mmz_uint max_dist, mmz_uint max_match_len, mmz_uint *pMatch_dist, mmz_uint *pMatch_len) {
+    mmz_uint dist, pos = lookahead_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK, match_len = *pMatch_len, probe_pos = pos, next_probe_pos, probe_len;
+    mmz_uint num_probes_left = d->m_max_probes[match_len >= 32];
+    mmz_uint16 c01 = MMZ_TDEFL_READ_UNALIGNED_WORD(&d->m_dict[pos + match_len - 1]);
+    if (max_match_len <= match_len) return;
+    for ( ; ; ) {
+        for ( ; ; ) {
+            if (--num_probes_left == 0) return;
+            #define MMZ_TDEFL_PROBE \
+                next_probe_pos = d->m_next[probe_pos]; \
+                if ((!next_probe_pos) || ((dist = (mmz_uint16)(lookahead_pos - next_probe_pos)) > max_dist)) return; \
+                probe_pos = next_probe_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK; \
+                if (MMZ_TDEFL_READ_UNALIGNED_WORD(&d->m_dict[probe_pos + match_len - 1]) == c01) break;
+            MMZ_TDEFL_PROBE; MMZ_TDEFL_PROBE; MMZ_TDEFL_PROBE;
+        }
+        if (!dist) break;
+        if ((probe_len = mmz_tdefl_match_len(d->m_dict + pos, d->m_dict + probe_pos)) > match_len) {
+            *pMatch_dist = dist; if ((*pMatch_len = match_len = MMZ_MIN(max_match_len, probe_len)) == max_match_len) break;
+            c01 = MMZ_TDEFL_READ_UNALIGNED_WORD(&d->m_dict[pos + match_len - 1]);
+        }
+    }
+}
+#define MMZ_TDEFL_USES_FAST_PATH(flags) ((((flags) & MMZ_TDEFL_MAX_PROBES_MASK) == 1) && (((flags) & MMZ_TDEFL_GREEDY_PARSING_FLAG) != 0) && (((flags) & (MMZ_TDEFL_FILTER_MATCHES | MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS | MMZ_TDEFL_RLE_MATCHES)) == 0))
+#define MMZ_TDEFL_LEVEL1_HASH(trigram) (((trigram) ^ ((trigram) >> (24 - (MMZ_TDEFL_LZ_HASH_BITS - 8)))) & MMZ_TDEFL_LEVEL1_HASH_SIZE_MASK)
+static mmz_bool mmz_tdefl_compress_fast(mmz_tdefl_compressor *d) {
+    // Faster, minimally featured LZRW1-style match+parse loop with better register utilization. Intended for applications where raw throughput is valued more highly than ratio.
+    mmz_uint lookahead_pos = d->m_lookahead_pos, lookahead_size = d->m_lookahead_size, dict_size = d->m_dict_size, total_lz_bytes = d->m_total_lz_bytes, num_flags_left = d->m_num_flags_left;
+    mmz_uint8 *pLZ_code_buf = d->m_pLZ_code_buf, *pLZ_flags = d->m_pLZ_flags;
+    mmz_uint cur_pos = lookahead_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+    while ((d->m_src_buf_left) || ((d->m_flush) && (lookahead_size))) {
+        const mmz_uint MMZ_TDEFL_COMP_FAST_LOOKAHEAD_SIZE = 4096;
+        mmz_uint dst_pos = (lookahead_pos + lookahead_size) & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+        mmz_uint num_bytes_to_process = (mmz_uint)MMZ_MIN(d->m_src_buf_left, MMZ_TDEFL_COMP_FAST_LOOKAHEAD_SIZE - lookahead_size);
+        d->m_src_buf_left -= num_bytes_to_process;
+        lookahead_size += num_bytes_to_process;
+        while (num_bytes_to_process) {
+            mmz_uint32 n = MMZ_MIN(MMZ_TDEFL_LZ_DICT_SIZE - dst_pos, num_bytes_to_process);
+            memcpy(d->m_dict + dst_pos, d->m_pSrc, n);
+            if (dst_pos < (MMZ_TDEFL_MAX_MATCH_LEN - 1))
+                memcpy(d->m_dict + MMZ_TDEFL_LZ_DICT_SIZE + dst_pos, d->m_pSrc, MMZ_MIN(n, (MMZ_TDEFL_MAX_MATCH_LEN - 1) - dst_pos));
+            d->m_pSrc += n;
+            dst_pos = (dst_pos + n) & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+            num_bytes_to_process -= n;
+        }
+        dict_size = MMZ_MIN(MMZ_TDEFL_LZ_DICT_SIZE - lookahead_size, dict_size);
+        if ((!d->m_flush) && (lookahead_size < MMZ_TDEFL_COMP_FAST_LOOKAHEAD_SIZE)) break;
+        while (lookahead_size >= 4) {
+            mmz_uint cur_match_dist, cur_match_len = 1;
+            mmz_uint8 *pCur_dict = d->m_dict + cur_pos;
+            mmz_uint first_trigram = MMZ_READ_LE32(pCur_dict) & 0xFFFFFF;
+            mmz_uint hash = MMZ_TDEFL_LEVEL1_HASH(first_trigram);
+            mmz_uint probe_pos = d->m_hash[hash];
+            d->m_hash[hash] = (mmz_uint16)lookahead_pos;
+            if (((cur_match_dist = (mmz_uint16)(lookahead_pos - probe_pos)) <= dict_size) && ((MMZ_READ_LE32(d->m_dict + (probe_pos &= MMZ_TDEFL_LZ_DICT_SIZE_MASK)) & 0xFFFFFF) == first_trigram)) {
+                // A zero distance is the current position itself (the table still holds it from 64KB ago).
+                cur_match_len = cur_match_dist ? mmz_tdefl_match_len(pCur_dict, d->m_dict + probe_pos) : 0;
+                if ((cur_match_len < MMZ_TDEFL_MIN_MATCH_LEN) || ((cur_match_len == MMZ_TDEFL_MIN_MATCH_LEN) && (cur_match_dist >= 8U*1024U))) {
+                    cur_match_len = 1;
+                    *pLZ_code_buf++ = (mmz_uint8)first_trigram;
+                    *pLZ_flags = (mmz_uint8)(*pLZ_flags >> 1);
+                    d->m_huff_count[0][(mmz_uint8)first_trigram]++;
+                } else {
+                    mmz_uint32 s0, s1;
+                    cur_match_len = MMZ_MIN(cur_match_len, lookahead_size);
+                    cur_match_dist--;
+                    pLZ_code_buf[0] = (mmz_uint8)(cur_match_len - MMZ_TDEFL_MIN_MATCH_LEN);
+                    *(mmz_uint16 *)(&pLZ_code_buf[1]) = (mmz_uint16)cur_match_dist;
+                    pLZ_code_buf += 3;
+                    *pLZ_flags = (mmz_uint8)((*pLZ_flags >> 1) | 0x80);
+                    s0 = s_mmz_tdefl_small_dist_sym[cur_match_dist & 511];
+                    s1 = s_mmz_tdefl_large_dist_sym[cur_match_dist >> 8];
+                    d->m_huff_count[1][(cur_match_dist < 512) ? s0 : s1]++;
+                    d->m_huff_count[0][s_mmz_tdefl_len_sym[cur_match_len - MMZ_TDEFL_MIN_MATCH_LEN]]++;
+                }
+            } else {
+                *pLZ_code_buf++ = (mmz_uint8)first_trigram;
+                *pLZ_flags = (mmz_uint8)(*pLZ_flags >> 1);
+                d->m_huff_count[0][(mmz_uint8)first_trigram]++;
+            }
+            if (--num_flags_left == 0) { num_flags_left = 8; pLZ_flags = pLZ_code_buf++; }
+            total_lz_bytes += cur_match_len;
+            lookahead_pos += cur_match_len;
+            dict_size = MMZ_MIN(dict_size + cur_match_len, (mmz_uint)MMZ_TDEFL_LZ_DICT_SIZE);
+            cur_pos = (cur_pos + cur_match_len) & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+            lookahead_size -= cur_match_len;
+            if (pLZ_code_buf > &d->m_lz_code_buf[MMZ_TDEFL_LZ_CODE_BUF_SIZE - 8]) {
+                int n;
+                d->m_lookahead_pos = lookahead_pos; d->m_lookahead_size = lookahead_size; d->m_dict_size = dict_size;
+                d->m_total_lz_bytes = total_lz_bytes; d->m_pLZ_code_buf = pLZ_code_buf; d->m_pLZ_flags = pLZ_flags; d->m_num_flags_left = num_flags_left;
+                if ((n = mmz_tdefl_flush_block(d, 0)) != 0)
+                    return (n < 0) ? MMZ_FALSE : MMZ_TRUE;
+                total_lz_bytes = d->m_total_lz_bytes; pLZ_code_buf = d->m_pLZ_code_buf; pLZ_flags = d->m_pLZ_flags; num_flags_left = d->m_num_flags_left;
+            }
+        }
+        while (lookahead_size) {
+            mmz_uint8 lit = d->m_dict[cur_pos];
+            total_lz_bytes++;
+            *pLZ_code_buf++ = lit;
+            *pLZ_flags = (mmz_uint8)(*pLZ_flags >> 1);
+            if (--num_flags_left == 0) { num_flags_left = 8; pLZ_flags = pLZ_code_buf++; }
+            d->m_huff_count[0][lit]++;
+            lookahead_pos++;
+            dict_size = MMZ_MIN(dict_size + 1, (mmz_uint)MMZ_TDEFL_LZ_DICT_SIZE);
+            cur_pos = (cur_pos + 1) & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+            lookahead_size--;
+            if (pLZ_code_buf > &d->m_lz_code_buf[MMZ_TDEFL_LZ_CODE_BUF_SIZE - 8]) {
+                int n;
+                d->m_lookahead_pos = lookahead_pos; d->m_lookahead_size = lookahead_size; d->m_dict_size = dict_size;
+                d->m_total_lz_bytes = total_lz_bytes; d->m_pLZ_code_buf = pLZ_code_buf; d->m_pLZ_flags = pLZ_flags; d->m_num_flags_left = num_flags_left;
+                if ((n = mmz_tdefl_flush_block(d, 0)) != 0)
+                    return (n < 0) ? MMZ_FALSE : MMZ_TRUE;
+                total_lz_bytes = d->m_total_lz_bytes; pLZ_code_buf = d->m_pLZ_code_buf; pLZ_flags = d->m_pLZ_flags; num_flags_left = d->m_num_flags_left;
+            }
+        }
+    }
+    d->m_lookahead_pos = lookahead_pos; d->m_lookahead_size = lookahead_size; d->m_dict_size = dict_size;
+    d->m_total_lz_bytes = total_lz_bytes; d->m_pLZ_code_buf = pLZ_code_buf; d->m_pLZ_flags = pLZ_flags; d->m_num_flags_left = num_flags_left;
+    return MMZ_TRUE;
+}
+static MMZ_FORCEINLINE void mmz_tdefl_record_literal(mmz_tdefl_compressor *d, mmz_uint8 lit) {
+    d->m_total_lz_bytes++;
+    *d->m_pLZ_code_buf++ = lit;
+    *d->m_pLZ_flags = (mmz_uint8)(*d->m_pLZ_flags >> 1); if (--d->m_num_flags_left == 0) { d->m_num_flags_left = 8; d->m_pLZ_flags = d->m_pLZ_code_buf++; }
+    d->m_huff_count[0][lit]++;
+}
+static MMZ_FORCEINLINE void mmz_tdefl_record_match(mmz_tdefl_compressor *d, mmz_uint match_len, mmz_uint match_dist) {
+    mmz_uint32 s0, s1;
+    d->m_total_lz_bytes += match_len;
+    d->m_pLZ_code_buf[0] = (mmz_uint8)(match_len - MMZ_TDEFL_MIN_MATCH_LEN);
+    match_dist -= 1;
+    d->m_pLZ_code_buf[1] = (mmz_uint8)(match_dist & 0xFF);
+    d->m_pLZ_code_buf[2] = (mmz_uint8)(match_dist >> 8); d->m_pLZ_code_buf += 3;
+    *d->m_pLZ_flags = (mmz_uint8)((*d->m_pLZ_flags >> 1) | 0x80); if (--d->m_num_flags_left == 0) { d->m_num_flags_left = 8; d->m_pLZ_flags = d->m_pLZ_code_buf++; }
+    s0 = s_mmz_tdefl_small_dist_sym[match_dist & 511]; s1 = s_mmz_tdefl_large_dist_sym[(match_dist >> 8) & 127];
+    d->m_huff_count[1][(match_dist < 512) ? s0 : s1]++;
+    if (match_len >= MMZ_TDEFL_MIN_MATCH_LEN) d->m_huff_count[0][s_mmz_tdefl_len_sym[match_len - MMZ_TDEFL_MIN_MATCH_LEN]]++;
+}
+static mmz_bool mmz_tdefl_compress_normal(mmz_tdefl_compressor *d) {
+    const mmz_uint8 *pSrc = d->m_pSrc; size_t src_buf_left = d->m_src_buf_left;
+    mmz_tdefl_flush flush = d->m_flush;
+    while ((src_buf_left) || ((flush) && (d->m_lookahead_size))) {
+        mmz_uint len_to_move, cur_match_dist, cur_match_len, cur_pos;
+        // Update dictionary and hash chains. Keeps the lookahead size equal to MMZ_TDEFL_MAX_MATCH_LEN.
+        if ((d->m_lookahead_size + d->m_dict_size) >= (MMZ_TDEFL_MIN_MATCH_LEN - 1)) {
+            mmz_uint dst_pos = (d->m_lookahead_pos + d->m_lookahead_size) & MMZ_TDEFL_LZ_DICT_SIZE_MASK, ins_pos = d->m_lookahead_pos + d->m_lookahead_size - 2;
+            mmz_uint hash = (d->m_dict[ins_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK] << MMZ_TDEFL_LZ_HASH_SHIFT) ^ d->m_dict[(ins_pos + 1) & MMZ_TDEFL_LZ_DICT_SIZE_MASK];
+            mmz_uint num_bytes_to_process = (mmz_uint)MMZ_MIN(src_buf_left, MMZ_TDEFL_MAX_MATCH_LEN - d->m_lookahead_size);
+            const mmz_uint8 *pSrc_end = pSrc + num_bytes_to_process;
+            src_buf_left -= num_bytes_to_process;
+            d->m_lookahead_size += num_bytes_to_process;
+            while (pSrc != pSrc_end) {
+                mmz_uint8 c = *pSrc++; d->m_dict[dst_pos] = c; if (dst_pos < (MMZ_TDEFL_MAX_MATCH_LEN - 1)) d->m_dict[MMZ_TDEFL_LZ_DICT_SIZE + dst_pos] = c;
+                hash = ((hash << MMZ_TDEFL_LZ_HASH_SHIFT) ^ c) & (MMZ_TDEFL_LZ_HASH_SIZE - 1);
+                d->m_next[ins_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mmz_uint16)(ins_pos);
+                dst_pos = (dst_pos + 1) & MMZ_TDEFL_LZ_DICT_SIZE_MASK; ins_pos++;
+            }
+        } else {
+            while ((src_buf_left) && (d->m_lookahead_size < MMZ_TDEFL_MAX_MATCH_LEN)) {
+                mmz_uint8 c = *pSrc++;
+                mmz_uint dst_pos = (d->m_lookahead_pos + d->m_lookahead_size) & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+                src_buf_left--;
+                d->m_dict[dst_pos] = c;
+                if (dst_pos < (MMZ_TDEFL_MAX_MATCH_LEN - 1))
+                    d->m_dict[MMZ_TDEFL_LZ_DICT_SIZE + dst_pos] = c;
+                if ((++d->m_lookahead_size + d->m_dict_size) >= MMZ_TDEFL_MIN_MATCH_LEN) {
+                    mmz_uint ins_pos = d->m_lookahead_pos + (d->m_lookahead_size - 1) - 2;
+                    mmz_uint hash = ((d->m_dict[ins_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK] << (MMZ_TDEFL_LZ_HASH_SHIFT * 2)) ^ (d->m_dict[(ins_pos + 1) & MMZ_TDEFL_LZ_DICT_SIZE_MASK] << MMZ_TDEFL_LZ_HASH_SHIFT) ^ c) & (MMZ_TDEFL_LZ_HASH_SIZE - 1);
+                    d->m_next[ins_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mmz_uint16)(ins_pos);
+                }
+            }
+        }
+        d->m_dict_size = MMZ_MIN(MMZ_TDEFL_LZ_DICT_SIZE - d->m_lookahead_size, d->m_dict_size);
+        if ((!flush) && (d->m_lookahead_size < MMZ_TDEFL_MAX_MATCH_LEN))
+            break;
+        // Simple lazy/greedy parsing state machine.
+        len_to_move = 1; cur_match_dist = 0; cur_match_len = d->m_saved_match_len ? d->m_saved_match_len : (MMZ_TDEFL_MIN_MATCH_LEN - 1); cur_pos = d->m_lookahead_pos & MMZ_TDEFL_LZ_DICT_SIZE_MASK;
+        if (d->m_flags & (MMZ_TDEFL_RLE_MATCHES | MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS)) {
+            if ((d->m_dict_size) && (!(d->m_flags & MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS))) {
+                mmz_uint8 c = d->m_dict[(cur_pos - 1) & MMZ_TDEFL_LZ_DICT_SIZE_MASK];
+                cur_match_len = 0; while (cur_match_len < d->m_lookahead_size) { if (d->m_dict[cur_pos + cur_match_len] != c) break; cur_match_len++; }
+                if (cur_match_len < MMZ_TDEFL_MIN_MATCH_LEN) cur_match_len = 0; else cur_match_dist = 1;
             }
-            for ( ; i < block_len; ++i) s1 += *ptr++, s2 += s1;
-            s1 %= 65521U, s2 %= 65521U; buf_len -= block_len; block_len = 5552;
+        } else {
+            mmz_tdefl_find_match(d, d->m_lookahead_pos, d->m_dict_size, d->m_lookahead_size, &cur_match_dist, &cur_match_len);
+        }
+        if (((cur_match_len == MMZ_TDEFL_MIN_MATCH_LEN) && (cur_match_dist >= 8U*1024U)) || (cur_pos == cur_match_dist) || ((d->m_flags & MMZ_TDEFL_FILTER_MATCHES) && (cur_match_len <= 5))) {
+            cur_match_dist = cur_match_len = 0;
+        }
+        if (d->m_saved_match_len) {
+            if (cur_match_len > d->m_saved_match_len) {
+                mmz_tdefl_record_literal(d, (mmz_uint8)d->m_saved_lit);
+                if (cur_match_len >= 128) {
+                    mmz_tdefl_record_match(d, cur_match_len, cur_match_dist);
+                    d->m_saved_match_len = 0; len_to_move = cur_match_len;
+                } else {
+                    d->m_saved_lit = d->m_dict[cur_pos]; d->m_saved_match_dist = cur_match_dist; d->m_saved_match_len = cur_match_len;
+                }
+            } else {
+                mmz_tdefl_record_match(d, d->m_saved_match_len, d->m_saved_match_dist);
+                len_to_move = d->m_saved_match_len - 1; d->m_saved_match_len = 0;
+            }
+        } else if (!cur_match_dist)
+            mmz_tdefl_record_literal(d, d->m_dict[MMZ_MIN(cur_pos, sizeof(d->m_dict) - 1)]);
+        else if ((d->m_greedy_parsing) || (d->m_flags & MMZ_TDEFL_RLE_MATCHES) || (cur_match_len >= 128)) {
+            mmz_tdefl_record_match(d, cur_match_len, cur_match_dist);
+            len_to_move = cur_match_len;
+        } else {
+            d->m_saved_lit = d->m_dict[MMZ_MIN(cur_pos, sizeof(d->m_dict) - 1)]; d->m_saved_match_dist = cur_match_dist; d->m_saved_match_len = cur_match_len;
+        }
+        // Move the lookahead forward by len_to_move bytes.
+        d->m_lookahead_pos += len_to_move;
+        d->m_lookahead_size -= len_to_move;
+        d->m_dict_size = MMZ_MIN(d->m_dict_size + len_to_move, (mmz_uint)MMZ_TDEFL_LZ_DICT_SIZE);
+        // Check if it's time to flush the current LZ codes to the internal output buffer.
+        if ( (d->m_pLZ_code_buf > &d->m_lz_code_buf[MMZ_TDEFL_LZ_CODE_BUF_SIZE - 8]) ||
+                  ( (d->m_total_lz_bytes > 31*1024) && (((((mmz_uint)(d->m_pLZ_code_buf - d->m_lz_code_buf) * 115) >> 7) >= d->m_total_lz_bytes) || (d->m_flags & MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS))) ) {
+            int n;
+            d->m_pSrc = pSrc; d->m_src_buf_left = src_buf_left;
+            if ((n = mmz_tdefl_flush_block(d, 0)) != 0)
+                return (n < 0) ? MMZ_FALSE : MMZ_TRUE;
+        }
+    }
+    d->m_pSrc = pSrc; d->m_src_buf_left = src_buf_left;
+    return MMZ_TRUE;
+}
+static mmz_tdefl_status mmz_tdefl_flush_output_buffer(mmz_tdefl_compressor *d) {
+    if (d->m_pIn_buf_size) {
+        *d->m_pIn_buf_size = d->m_pSrc - (const mmz_uint8 *)d->m_pIn_buf;
+    }
+    if (d->m_pOut_buf_size) {
+        size_t n = MMZ_MIN(*d->m_pOut_buf_size - d->m_out_buf_ofs, d->m_output_flush_remaining);
+        memcpy((mmz_uint8 *)d->m_pOut_buf + d->m_out_buf_ofs, d->m_output_buf + d->m_output_flush_ofs, n);
+        d->m_output_flush_ofs += (mmz_uint)n;
+        d->m_output_flush_remaining -= (mmz_uint)n;
+        d->m_out_buf_ofs += n;
+        *d->m_pOut_buf_size = d->m_out_buf_ofs;
+    }
+    return (d->m_finished && !d->m_output_flush_remaining) ? MMZ_TDEFL_STATUS_DONE : MMZ_TDEFL_STATUS_OKAY;
+}
+mmz_tdefl_status mmz_tdefl_compress(mmz_tdefl_compressor *d, const void *pIn_buf, size_t *pIn_buf_size, void *pOut_buf, size_t *pOut_buf_size, mmz_tdefl_flush flush) {
+    if (!d) {
+        if (pIn_buf_size) *pIn_buf_size = 0;
+        if (pOut_buf_size) *pOut_buf_size = 0;
+        return MMZ_TDEFL_STATUS_BAD_PARAM;
+    }
+    d->m_pIn_buf = pIn_buf; d->m_pIn_buf_size = pIn_buf_size;
+    d->m_pOut_buf = pOut_buf; d->m_pOut_buf_size = pOut_buf_size;
+    d->m_pSrc = (const mmz_uint8 *)(pIn_buf); d->m_src_buf_left = pIn_buf_size ? *pIn_buf_size : 0;
+    d->m_out_buf_ofs = 0;
+    d->m_flush = flush;
+    if ( ((d->m_pPut_buf_func != NULL) == ((pOut_buf != NULL) || (pOut_buf_size != NULL))) || (d->m_prev_return_status != MMZ_TDEFL_STATUS_OKAY) ||
+                (d->m_wants_to_finish && (flush != MMZ_TDEFL_FINISH)) || (pIn_buf_size && *pIn_buf_size && !pIn_buf) || (pOut_buf_size && *pOut_buf_size && !pOut_buf) ) {
+        if (pIn_buf_size) *pIn_buf_size = 0;
+        if (pOut_buf_size) *pOut_buf_size = 0;
+        return (d->m_prev_return_status = MMZ_TDEFL_STATUS_BAD_PARAM);
+    }
+    d->m_wants_to_finish |= (flush == MMZ_TDEFL_FINISH);
+    if ((d->m_output_flush_remaining) || (d->m_finished))
+        return (d->m_prev_return_status = mmz_tdefl_flush_output_buffer(d));
+    if (MMZ_TDEFL_USES_FAST_PATH(d->m_flags)) {
+        if (!mmz_tdefl_compress_fast(d))
+            return d->m_prev_return_status;
+    } else {
+        if (!mmz_tdefl_compress_normal(d))
+            return d->m_prev_return_status;
+    }
+    if ((d->m_flags & (MMZ_TDEFL_WRITE_ZLIB_HEADER | MMZ_TDEFL_COMPUTE_ADLER32)) && (pIn_buf))
+        d->m_adler32 = (mmz_uint32)mmz_adler32(d->m_adler32, (const mmz_uint8 *)pIn_buf, d->m_pSrc - (const mmz_uint8 *)pIn_buf);
+    if ((flush) && (!d->m_lookahead_size) && (!d->m_src_buf_left) && (!d->m_output_flush_remaining)) {
+        if (mmz_tdefl_flush_block(d, flush) < 0)
+            return d->m_prev_return_status;
+        d->m_finished = (flush == MMZ_TDEFL_FINISH);
+        if (flush == MMZ_TDEFL_FULL_FLUSH) { MMZ_CLEAR_OBJ(d->m_hash); MMZ_CLEAR_OBJ(d->m_next); d->m_dict_size = 0; }
+    }
+    return (d->m_prev_return_status = mmz_tdefl_flush_output_buffer(d));
+}
+mmz_tdefl_status mmz_tdefl_compress_buffer(mmz_tdefl_compressor *d, const void *pIn_buf, size_t in_buf_size, mmz_tdefl_flush flush) {
+    return mmz_tdefl_compress(d, pIn_buf, &in_buf_size, NULL, NULL, flush);
+}
+mmz_tdefl_status mmz_tdefl_init(mmz_tdefl_compressor *d, mmz_tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags) {
+    d->m_pPut_buf_func = pPut_buf_func; d->m_pPut_buf_user = pPut_buf_user;
+    d->m_flags = (mmz_uint)(flags); d->m_max_probes[0] = 1 + ((flags & 0xFFF) + 2) / 3; d->m_greedy_parsing = (flags & MMZ_TDEFL_GREEDY_PARSING_FLAG) != 0;
+    d->m_max_probes[1] = 1 + (((flags & 0xFFF) >> 2) + 2) / 3;
+    if (!(flags & MMZ_TDEFL_NONDETERMINISTIC_PARSING_FLAG)) MMZ_CLEAR_OBJ(d->m_hash);
+    d->m_lookahead_pos = d->m_lookahead_size = d->m_dict_size = d->m_total_lz_bytes = d->m_lz_code_buf_dict_pos = d->m_bits_in = 0;
+    d->m_output_flush_ofs = d->m_output_flush_remaining = d->m_finished = d->m_block_index = d->m_bit_buffer = d->m_wants_to_finish = 0;
+    d->m_pLZ_code_buf = d->m_lz_code_buf + 1; d->m_pLZ_flags = d->m_lz_code_buf; d->m_num_flags_left = 8;
+    d->m_pOutput_buf = d->m_output_buf; d->m_pOutput_buf_end = d->m_output_buf; d->m_prev_return_status = MMZ_TDEFL_STATUS_OKAY;
+    d->m_saved_match_dist = d->m_saved_match_len = d->m_saved_lit = 0; d->m_adler32 = 1;
+    d->m_pIn_buf = NULL; d->m_pOut_buf = NULL;
+    d->m_pIn_buf_size = NULL; d->m_pOut_buf_size = NULL;
+    d->m_flush = MMZ_TDEFL_NO_FLUSH; d->m_pSrc = NULL; d->m_src_buf_left = 0; d->m_out_buf_ofs = 0;
+    memset(&d->m_huff_count[0][0], 0, sizeof(d->m_huff_count[0][0]) * MMZ_TDEFL_MAX_HUFF_SYMBOLS_0);
+    memset(&d->m_huff_count[1][0], 0, sizeof(d->m_huff_count[1][0]) * MMZ_TDEFL_MAX_HUFF_SYMBOLS_1);
+    return MMZ_TDEFL_STATUS_OKAY;
+}
+mmz_tdefl_status mmz_tdefl_get_prev_return_status(mmz_tdefl_compressor *d) {
+    return d->m_prev_return_status;
+}
+// Puts the last MMZ_TDEFL_LZ_DICT_SIZE bytes of pHistory in front of the input of a freshly initialized compressor, hashed as if they had just
+// been compressed, so matches can reach back into them. Nothing about them goes into the output (unlike a zlib preset dictionary).
+static void mmz_tdefl_set_history(mmz_tdefl_compressor *d, const mmz_uint8 *pHistory, size_t len) {
+    mmz_uint size = (mmz_uint)MMZ_MIN(len, (size_t)MMZ_TDEFL_LZ_DICT_SIZE), i;
+    mmz_bool fast = MMZ_TDEFL_USES_FAST_PATH(d->m_flags);
+    if (!size) return;
+    memcpy(d->m_dict, pHistory + len - size, size);
+    memcpy(d->m_dict + MMZ_TDEFL_LZ_DICT_SIZE, d->m_dict, MMZ_MIN(size, (mmz_uint)(MMZ_TDEFL_MAX_MATCH_LEN - 1)));
+    for (i = 0; i + 2 < size; i++) {
+        const mmz_uint8 *p = d->m_dict + i;
+        if (fast) {
+            mmz_uint trigram = p[0] | (p[1] << 8) | (p[2] << 16);
+            d->m_hash[MMZ_TDEFL_LEVEL1_HASH(trigram)] = (mmz_uint16)i;
+        } else {
+            mmz_uint hash = ((p[0] << (MMZ_TDEFL_LZ_HASH_SHIFT * 2)) ^ (p[1] << MMZ_TDEFL_LZ_HASH_SHIFT) ^ p[2]) & (MMZ_TDEFL_LZ_HASH_SIZE - 1);
+            d->m_next[i] = d->m_hash[hash]; d->m_hash[hash] = (mmz_uint16)i;
+        }
+    }
+    d->m_lookahead_pos = d->m_dict_size = d->m_lz_code_buf_dict_pos = size;
+}
+static const mmz_uint s_mmz_tdefl_num_probes[11] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500 };
+// level may actually range from [0,10] (10 is a "hidden" max level, where we want a bit more compression and it's fine if throughput to fall off a cliff on some files).
+mmz_uint mmz_tdefl_create_comp_flags_from_zip_params(int level, int window_bits, int strategy) {
+    mmz_uint comp_flags = s_mmz_tdefl_num_probes[(level >= 0) ? MMZ_MIN(10, level) : MMZ_DEFAULT_LEVEL] | ((level <= 3) ? MMZ_TDEFL_GREEDY_PARSING_FLAG : 0);
+    if (window_bits > 0) comp_flags |= MMZ_TDEFL_WRITE_ZLIB_HEADER;
+    if (!level) comp_flags |= MMZ_TDEFL_FORCE_ALL_RAW_BLOCKS;
+    else if (strategy == MMZ_FILTERED) comp_flags |= MMZ_TDEFL_FILTER_MATCHES;
+    else if (strategy == MMZ_HUFFMAN_ONLY) comp_flags &= ~MMZ_TDEFL_MAX_PROBES_MASK;
+    else if (strategy == MMZ_FIXED) comp_flags |= MMZ_TDEFL_FORCE_ALL_STATIC_BLOCKS;
+    else if (strategy == MMZ_RLE) comp_flags |= MMZ_TDEFL_RLE_MATCHES;
+    return comp_flags;
+}
+typedef struct {
+    size_t m_size, m_capacity;
+    mmz_uint8 *m_pBuf;
+} mmz_tdefl_output_buffer;
+static mmz_bool mmz_tdefl_output_buffer_putter(const void *pBuf, int len, void *pUser) {
+    mmz_tdefl_output_buffer *p = (mmz_tdefl_output_buffer *)pUser;
+    size_t new_size = p->m_size + len;
+    if (new_size > p->m_capacity) {
+        size_t new_capacity = p->m_capacity; mmz_uint8 *pNew_buf;
+        do { new_capacity = MMZ_MAX(128U, new_capacity << 1U); } while (new_size > new_capacity);
+        if (!(pNew_buf = (mmz_uint8 *)MMZ_REALLOC(p->m_pBuf, new_capacity))) return MMZ_FALSE;
+        p->m_pBuf = pNew_buf; p->m_capacity = new_capacity;
+    }
+    memcpy(p->m_pBuf + p->m_size, pBuf, len); p->m_size = new_size;
+    return MMZ_TRUE;
+}
+// Compresses a whole buffer into a new heap block (free with MMZ_FREE), returning NULL on failure.
+static void *mmz_tdefl_compress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, size_t *pOut_len, int flags) {
+    mmz_tdefl_output_buffer out_buf; mmz_tdefl_compressor *pComp; mmz_bool succeeded;
+    MMZ_CLEAR_OBJ(out_buf); *pOut_len = 0;
+    if (!(pComp = (mmz_tdefl_compressor *)MMZ_MALLOC(sizeof(mmz_tdefl_compressor)))) return NULL;
+    succeeded = (mmz_tdefl_init(pComp, mmz_tdefl_output_buffer_putter, &out_buf, flags) == MMZ_TDEFL_STATUS_OKAY);
+    succeeded = succeeded && (mmz_tdefl_compress_buffer(pComp, pSrc_buf, src_buf_len, MMZ_TDEFL_FINISH) == MMZ_TDEFL_STATUS_DONE);
+    MMZ_FREE(pComp);
+    if (!succeeded) { MMZ_FREE(out_buf.m_pBuf); return NULL; }
+    *pOut_len = out_buf.m_size; return out_buf.m_pBuf;
+}
+int mmz_deflateInit(mmz_streamp pStream, int level) {
+    return mmz_deflateInit2(pStream, level, MMZ_DEFLATED, MMZ_DEFAULT_WINDOW_BITS, 9, MMZ_DEFAULT_STRATEGY);
+}
+int mmz_deflateInit2(mmz_streamp pStream, int level, int method, int window_bits, int mem_level, int strategy) {
+    mmz_tdefl_compressor *pComp;
+    mmz_uint comp_flags = MMZ_TDEFL_COMPUTE_ADLER32 | mmz_tdefl_create_comp_flags_from_zip_params(level, window_bits, strategy);
+    if (!pStream) return MMZ_STREAM_ERROR;
+    if ((method != MMZ_DEFLATED) || ((mem_level < 1) || (mem_level > 9)) || ((window_bits != MMZ_DEFAULT_WINDOW_BITS) && (-window_bits != MMZ_DEFAULT_WINDOW_BITS))) return MMZ_PARAM_ERROR;
+    pStream->data_type = 0;
+    pStream->adler = 1;
+    pStream->msg = NULL;
+    pStream->reserved = 0;
+    pStream->total_in = 0;
+    pStream->total_out = 0;
+    if (!pStream->zalloc) pStream->zalloc = mmz_def_alloc_func;
+    if (!pStream->zfree) pStream->zfree = mmz_def_free_func;
+    pComp = (mmz_tdefl_compressor *)pStream->zalloc(pStream->opaque, 1, sizeof(mmz_tdefl_compressor));
+    if (!pComp) return MMZ_MEM_ERROR;
+    pStream->state = (struct mmz_internal_state *)pComp;
+    if (mmz_tdefl_init(pComp, NULL, NULL, comp_flags) != MMZ_TDEFL_STATUS_OKAY) {
+        mmz_deflateEnd(pStream);
+        return MMZ_PARAM_ERROR;
+    }
+    return MMZ_OK;
+}
+int mmz_deflateReset(mmz_streamp pStream) {
+    if ((!pStream) || (!pStream->state) || (!pStream->zalloc) || (!pStream->zfree)) return MMZ_STREAM_ERROR;
+    pStream->total_in = pStream->total_out = 0;
+    mmz_tdefl_init((mmz_tdefl_compressor*)pStream->state, NULL, NULL, ((mmz_tdefl_compressor*)pStream->state)->m_flags);
+    return MMZ_OK;
+}
+int mmz_deflate(mmz_streamp pStream, int flush) {
+    size_t in_bytes, out_bytes;
+    mmz_ulong orig_total_in, orig_total_out;
+    int status = MMZ_OK;
+    if ((!pStream) || (!pStream->state) || (flush < 0) || (flush > MMZ_FINISH) || (!pStream->next_out)) return MMZ_STREAM_ERROR;
+    if (!pStream->avail_out) return MMZ_BUF_ERROR;
+    if (flush == MMZ_PARTIAL_FLUSH) flush = MMZ_SYNC_FLUSH;
+    if (((mmz_tdefl_compressor*)pStream->state)->m_prev_return_status == MMZ_TDEFL_STATUS_DONE)
+        return (flush == MMZ_FINISH) ? MMZ_STREAM_END : MMZ_BUF_ERROR;
+    orig_total_in = pStream->total_in; orig_total_out = pStream->total_out;
+    for ( ; ; ) {
+        mmz_tdefl_status defl_status;
+        in_bytes = pStream->avail_in; out_bytes = pStream->avail_out;
+        defl_status = mmz_tdefl_compress((mmz_tdefl_compressor*)pStream->state, pStream->next_in, &in_bytes, pStream->next_out, &out_bytes, (mmz_tdefl_flush)flush);
+        pStream->next_in += (mmz_uint)in_bytes; pStream->avail_in -= (mmz_uint)in_bytes;
+        pStream->total_in += (mmz_uint)in_bytes; pStream->adler = mmz_tdefl_get_adler32((mmz_tdefl_compressor*)pStream->state);
+        pStream->next_out += (mmz_uint)out_bytes; pStream->avail_out -= (mmz_uint)out_bytes;
+        pStream->total_out += (mmz_uint)out_bytes;
+        if (defl_status < 0) {
+            status = MMZ_STREAM_ERROR;
+            break;
+        } else if (defl_status == MMZ_TDEFL_STATUS_DONE) {
+            status = MMZ_STREAM_END;
+            break;
+        } else if (!pStream->avail_out) {
+            break;
+        } else if ((!pStream->avail_in) && (flush != MMZ_FINISH)) {
+            if ((flush) || (pStream->total_in != orig_total_in) || (pStream->total_out != orig_total_out)) break;
+            return MMZ_BUF_ERROR; // Can't make forward progress without some input.
         }
-        r->m_check_adler32 = (s2 << 16) + s1; if ((status == MMZ_TINFL_STATUS_DONE) && (decomp_flags & MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER) && (r->m_check_adler32 != r->m_z_adler32)) status = MMZ_TINFL_STATUS_ADLER32_MISMATCH;
     }
     return status;
 }
+int mmz_deflateEnd(mmz_streamp pStream) {
+    if (!pStream) return MMZ_STREAM_ERROR;
+    if (pStream->state) {
+        pStream->zfree(pStream->opaque, pStream->state);
+        pStream->state = NULL;
+    }
+    return MMZ_OK;
+}
+mmz_ulong mmz_deflateBound(mmz_streamp pStream, mmz_ulong source_len) {
+    (void)pStream;
+    return MMZ_MAX(128 + (source_len * 110) / 100, 128 + source_len + ((source_len / (31 * 1024)) + 1) * 5);
+}
+int mmz_compress2(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong source_len, int level) {
+    int status;
+    mmz_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // In case mmz_ulong is 64-bits.
+    if ((source_len | *pDest_len) > 0xFFFFFFFFU) return MMZ_PARAM_ERROR;
+    stream.next_in = pSource;
+    stream.avail_in = (mmz_uint32)source_len;
+    stream.next_out = pDest;
+    stream.avail_out = (mmz_uint32)*pDest_len;
+    status = mmz_deflateInit(&stream, level);
+    if (status != MMZ_OK) return status;
+    status = mmz_deflate(&stream, MMZ_FINISH);
+    if (status != MMZ_STREAM_END) {
+        mmz_deflateEnd(&stream);
+        return (status == MMZ_OK) ? MMZ_BUF_ERROR : status;
+    }
+    *pDest_len = stream.total_out;
+    return mmz_deflateEnd(&stream);
+}
+int mmz_compress(unsigned char *pDest, mmz_ulong *pDest_len, const unsigned char *pSource, mmz_ulong source_len) {
+    return mmz_compress2(pDest, pDest_len, pSource, source_len, MMZ_DEFAULT_COMPRESSION);
+}
+mmz_ulong mmz_compressBound(mmz_ulong source_len) {
+    return mmz_deflateBound(NULL, source_len);
+}
 
-#ifdef _MSC_VER
-#pragma warning (push)
-#pragma warning (disable:4204) // nonstandard extension used : non-constant aggregate initializer (also supported by GNU C and C99, so no big deal)
+#define MMZ_INDEX_IN_BUF_SIZE 65536
+// Scratch space shared by building and extracting: the decoder, its wrapping dictionary and an input buffer.
+typedef struct {
+    mmz_tinfl_decompressor m_decomp;
+    mmz_uint8 m_dict[MMZ_TINFL_LZ_DICT_SIZE], m_in_buf[MMZ_INDEX_IN_BUF_SIZE];
+    mmz_uint64 m_in_ofs;
+    size_t m_in_pos, m_in_len;
+    int m_eof;
+} mmz_index_work;
+static mmz_uint32 mmz_index_stream_flags(int window_bits) {
+    if (window_bits <= 0) return 0;
+    return (window_bits < 16) ? MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER : (window_bits < 32) ? MMZ_TINFL_FLAG_PARSE_GZIP_HEADER : (MMZ_TINFL_FLAG_PARSE_ZLIB_HEADER | MMZ_TINFL_FLAG_PARSE_GZIP_HEADER);
+}
+// Decodes the next piece of output into the dictionary, reading more input first if the buffer has run dry.
+static mmz_tinfl_status mmz_index_step(mmz_index_work *pWork, mmz_index_read_func pRead, void *pUser, mmz_uint32 flags, size_t dict_ofs, size_t *pOut_bytes) {
+    size_t in_bytes; mmz_tinfl_status status;
+    if ((pWork->m_in_pos == pWork->m_in_len) && (!pWork->m_eof)) {
+        pWork->m_in_ofs += pWork->m_in_len; pWork->m_in_pos = 0;
+        pWork->m_in_len = pRead(pUser, pWork->m_in_ofs, pWork->m_in_buf, MMZ_INDEX_IN_BUF_SIZE);
+        if (pWork->m_in_len > MMZ_INDEX_IN_BUF_SIZE) return MMZ_TINFL_STATUS_BAD_PARAM;
+        pWork->m_eof = !pWork->m_in_len;
+    }
+    in_bytes = pWork->m_in_len - pWork->m_in_pos; *pOut_bytes = MMZ_TINFL_LZ_DICT_SIZE - dict_ofs;
+    status = mmz_tinfl_decompress(&pWork->m_decomp, pWork->m_in_buf + pWork->m_in_pos, &in_bytes, pWork->m_dict, pWork->m_dict + dict_ofs, pOut_bytes, flags | (pWork->m_eof ? 0 : MMZ_TINFL_FLAG_HAS_MORE_INPUT));
+    pWork->m_in_pos += in_bytes;
+    return status;
+}
+static int mmz_index_add_point(mmz_index *pIndex, const mmz_index_work *pWork, mmz_uint64 out_ofs, size_t dict_ofs) {
+    mmz_index_point *pPoint;
+    mmz_uint8 window[MMZ_TINFL_LZ_DICT_SIZE];
+    mmz_uint32 num_bits = pWork->m_decomp.m_num_bits;
+    size_t window_size = (size_t)MMZ_MIN(out_ofs, (mmz_uint64)MMZ_TINFL_LZ_DICT_SIZE), comp_size = 0;
+    if (pIndex->m_num_points == pIndex->m_capacity) {
+        mmz_uint32 capacity = pIndex->m_capacity ? (pIndex->m_capacity * 2) : 16;
+        mmz_index_point *pPoints = (mmz_index_point *)MMZ_REALLOC(pIndex->m_pPoints, capacity * sizeof(mmz_index_point));
+        if (!pPoints) return MMZ_MEM_ERROR;
+        pIndex->m_pPoints = pPoints; pIndex->m_capacity = capacity;
+    }
+    pPoint = &pIndex->m_pPoints[pIndex->m_num_points];
+    // Whole bytes in the bit buffer are just read ahead, so the block starts num_bits / 8 bytes back plus the odd bits.
+    pPoint->m_out_ofs = out_ofs;
+    pPoint->m_in_ofs = pWork->m_in_ofs + pWork->m_in_pos - (num_bits >> 3);
+    pPoint->m_num_bits = num_bits & 7;
+    pPoint->m_bits = (mmz_uint32)pWork->m_decomp.m_bit_buf & ((1U << pPoint->m_num_bits) - 1);
+    memcpy(window, pWork->m_dict + dict_ofs, MMZ_TINFL_LZ_DICT_SIZE - dict_ofs); memcpy(window + MMZ_TINFL_LZ_DICT_SIZE - dict_ofs, pWork->m_dict, dict_ofs);
+    pPoint->m_pComp_window = (mmz_uint8 *)mmz_tdefl_compress_mem_to_heap(window + MMZ_TINFL_LZ_DICT_SIZE - window_size, window_size, &comp_size, MMZ_TDEFL_DEFAULT_MAX_PROBES);
+    if (!pPoint->m_pComp_window) return MMZ_MEM_ERROR;
+    pPoint->m_window_size = (mmz_uint32)window_size; pPoint->m_comp_window_size = (mmz_uint32)comp_size;
+    pIndex->m_num_points++;
+    return MMZ_OK;
+}
+int mmz_index_build(mmz_index **ppIndex, mmz_index_read_func pRead, void *pUser, int window_bits, mmz_uint64 span) {
+    mmz_index *pIndex; mmz_index_work *pWork;
+    mmz_uint32 flags;
+    mmz_uint64 out_ofs = 0, next_point = span;
+    size_t dict_ofs = 0, out_bytes;
+    mmz_tinfl_status status;
+    int result = MMZ_OK;
+    if (!ppIndex) return MMZ_STREAM_ERROR;
+    *ppIndex = NULL;
+    if ((!pRead) || (!span) || (!mmz_inflate_window_log2(window_bits))) return MMZ_PARAM_ERROR;
+    if (!window_bits) window_bits = MMZ_DEFAULT_WINDOW_BITS;
+    flags = mmz_index_stream_flags(window_bits) | MMZ_TINFL_FLAG_COMPUTE_ADLER32 | MMZ_TINFL_FLAG_STOP_AT_BLOCK;
+    pIndex = (mmz_index *)MMZ_MALLOC(sizeof(mmz_index)); pWork = (mmz_index_work *)MMZ_MALLOC(sizeof(mmz_index_work));
+    if ((!pIndex) || (!pWork)) { MMZ_FREE(pIndex); MMZ_FREE(pWork); return MMZ_MEM_ERROR; }
+    memset(pIndex, 0, sizeof(mmz_index)); pIndex->m_window_bits = window_bits;
+    mmz_tinfl_init(&pWork->m_decomp); pWork->m_decomp.m_window_size = 1U << mmz_inflate_window_log2(window_bits); pWork->m_in_ofs = 0; pWork->m_in_pos = pWork->m_in_len = 0; pWork->m_eof = 0;
+    for ( ; ; ) {
+        status = mmz_index_step(pWork, pRead, pUser, flags, dict_ofs, &out_bytes);
+        out_ofs += out_bytes; dict_ofs = (dict_ofs + out_bytes) & (MMZ_TINFL_LZ_DICT_SIZE - 1);
+        if ((status < 0) || (status == MMZ_TINFL_STATUS_NEEDS_DICT)) { result = (status == MMZ_TINFL_STATUS_BAD_PARAM) ? MMZ_PARAM_ERROR : MMZ_DATA_ERROR; break; }
+        if (status == MMZ_TINFL_STATUS_DONE) break;
+        if ((status == MMZ_TINFL_STATUS_BLOCK_BOUNDARY) && (out_ofs >= next_point)) {
+            if ((result = mmz_index_add_point(pIndex, pWork, out_ofs, dict_ofs)) != MMZ_OK) break;
+            next_point = out_ofs + span;
+        }
+    }
+    pIndex->m_total_in = pWork->m_in_ofs + pWork->m_in_pos; pIndex->m_total_out = out_ofs;
+    MMZ_FREE(pWork);
+    if (result != MMZ_OK) { mmz_index_free(pIndex); return result; }
+    *ppIndex = pIndex;
+    return MMZ_OK;
+}
+int mmz_index_extract(const mmz_index *pIndex, mmz_index_read_func pRead, void *pUser, mmz_uint64 ofs, unsigned char *pDest, size_t *pDest_len) {
+    const mmz_index_point *pPoint = NULL;
+    mmz_index_work *pWork;
+    mmz_uint32 lo = 0, hi, flags;
+    mmz_uint64 skip;
+    size_t want, got = 0, dict_ofs = 0, out_bytes;
+    mmz_tinfl_status status;
+    int result = MMZ_OK;
+    if (!pDest_len) return MMZ_STREAM_ERROR;
+    want = *pDest_len; *pDest_len = 0;
+    if ((!pIndex) || (!pRead) || ((!pDest) && (want))) return MMZ_PARAM_ERROR;
+    if ((ofs >= pIndex->m_total_out) || (!want)) return MMZ_OK;
+    // Binary search for the last checkpoint at or before ofs.
+    hi = pIndex->m_num_points;
+    while (lo < hi) { mmz_uint32 mid = lo + ((hi - lo) >> 1); if (pIndex->m_pPoints[mid].m_out_ofs <= ofs) lo = mid + 1; else hi = mid; }
+    if (lo) pPoint = &pIndex->m_pPoints[lo - 1];
+    if (!(pWork = (mmz_index_work *)MMZ_MALLOC(sizeof(mmz_index_work)))) return MMZ_MEM_ERROR;
+    mmz_tinfl_init(&pWork->m_decomp); pWork->m_in_ofs = 0; pWork->m_in_pos = pWork->m_in_len = 0; pWork->m_eof = 0;
+    if (pPoint) {
+        size_t in_bytes = pPoint->m_comp_window_size;
+        out_bytes = pPoint->m_window_size;
+        status = mmz_tinfl_decompress(&pWork->m_decomp, pPoint->m_pComp_window, &in_bytes, pWork->m_dict, pWork->m_dict, &out_bytes, MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+        if ((status != MMZ_TINFL_STATUS_DONE) || (out_bytes != pPoint->m_window_size)) { MMZ_FREE(pWork); return MMZ_DATA_ERROR; }
+        mmz_tinfl_init_at_block(&pWork->m_decomp, pPoint->m_bits, pPoint->m_num_bits); pWork->m_decomp.m_history = pPoint->m_window_size;
+        pWork->m_in_ofs = pPoint->m_in_ofs;
+        dict_ofs = pPoint->m_window_size & (MMZ_TINFL_LZ_DICT_SIZE - 1);
+        skip = ofs - pPoint->m_out_ofs; flags = 0;
+    } else {
+        skip = ofs; flags = mmz_index_stream_flags(pIndex->m_window_bits);
+    }
+    pWork->m_decomp.m_window_size = 1U << mmz_inflate_window_log2(pIndex->m_window_bits);
+    for ( ; ; ) {
+        const mmz_uint8 *pSrc;
+        status = mmz_index_step(pWork, pRead, pUser, flags, dict_ofs, &out_bytes);
+        pSrc = pWork->m_dict + dict_ofs; dict_ofs = (dict_ofs + out_bytes) & (MMZ_TINFL_LZ_DICT_SIZE - 1);
+        if (skip) { size_t n = (size_t)MMZ_MIN(skip, (mmz_uint64)out_bytes); skip -= n; pSrc += n; out_bytes -= n; }
+        out_bytes = MMZ_MIN(out_bytes, want - got);
+        memcpy(pDest + got, pSrc, out_bytes); got += out_bytes;
+        if (status < 0) { result = (status == MMZ_TINFL_STATUS_BAD_PARAM) ? MMZ_PARAM_ERROR : MMZ_DATA_ERROR; break; }
+        if ((got == want) || (status == MMZ_TINFL_STATUS_DONE)) break;
+    }
+    MMZ_FREE(pWork);
+    *pDest_len = got;
+    return result;
+}
+void mmz_index_free(mmz_index *pIndex) {
+    mmz_uint32 i;
+    if (!pIndex) return;
+    for (i = 0; i < pIndex->m_num_points; i++) MMZ_FREE(pIndex->m_pPoints[i].m_pComp_window);
+    MMZ_FREE(pIndex->m_pPoints);
+    MMZ_FREE(pIndex);
+}
+static mmz_uint8 *mmz_index_put_varint(mmz_uint8 *p, mmz_uint64 v) {
+    while (v >= 0x80) { *p++ = (mmz_uint8)(v | 0x80); v >>= 7; }
+    *p++ = (mmz_uint8)v;
+    return p;
+}
+static const mmz_uint8 *mmz_index_get_varint(const mmz_uint8 *p, const mmz_uint8 *pEnd, mmz_uint64 *pV) {
+    int shift;
+    *pV = 0;
+    for (shift = 0; (p < pEnd) && (shift < 64); shift += 7) {
+        mmz_uint8 c = *p++;
+        *pV |= (mmz_uint64)(c & 0x7F) << shift;
+        if (!(c & 0x80)) return p;
+    }
+    return NULL;
+}
+// "MMZI", window_bits as a signed byte, then varints: total_in, total_out, num_points and per point the out/in offset deltas, (bits << 3) | num_bits,
+// window size and deflated window size followed by the deflated window.
+int mmz_index_serialize(const mmz_index *pIndex, unsigned char **ppBuf, size_t *pBuf_len) {
+    mmz_uint8 *pBuf, *p;
+    mmz_uint64 prev_out = 0, prev_in = 0;
+    size_t bound = 4 + 1 + 3 * 10;
+    mmz_uint32 i;
+    if ((!ppBuf) || (!pBuf_len)) return MMZ_STREAM_ERROR;
+    *ppBuf = NULL; *pBuf_len = 0;
+    if (!pIndex) return MMZ_PARAM_ERROR;
+    for (i = 0; i < pIndex->m_num_points; i++) bound += 5 * 10 + pIndex->m_pPoints[i].m_comp_window_size;
+    if (!(p = pBuf = (mmz_uint8 *)MMZ_MALLOC(bound))) return MMZ_MEM_ERROR;
+    memcpy(p, "MMZI", 4); p += 4;
+    *p++ = (mmz_uint8)pIndex->m_window_bits;
+    p = mmz_index_put_varint(p, pIndex->m_total_in); p = mmz_index_put_varint(p, pIndex->m_total_out); p = mmz_index_put_varint(p, pIndex->m_num_points);
+    for (i = 0; i < pIndex->m_num_points; i++) {
+        const mmz_index_point *pPoint = &pIndex->m_pPoints[i];
+        p = mmz_index_put_varint(p, pPoint->m_out_ofs - prev_out); p = mmz_index_put_varint(p, pPoint->m_in_ofs - prev_in);
+        p = mmz_index_put_varint(p, (pPoint->m_bits << 3) | pPoint->m_num_bits);
+        p = mmz_index_put_varint(p, pPoint->m_window_size); p = mmz_index_put_varint(p, pPoint->m_comp_window_size);
+        memcpy(p, pPoint->m_pComp_window, pPoint->m_comp_window_size); p += pPoint->m_comp_window_size;
+        prev_out = pPoint->m_out_ofs; prev_in = pPoint->m_in_ofs;
+    }
+    *ppBuf = pBuf; *pBuf_len = p - pBuf;
+    return MMZ_OK;
+}
+int mmz_index_deserialize(mmz_index **ppIndex, const unsigned char *pBuf, size_t buf_len) {
+    const mmz_uint8 *p = pBuf, *pEnd = pBuf + buf_len;
+    mmz_index *pIndex;
+    mmz_uint64 num_points, v, prev_out = 0, prev_in = 0;
+    if (!ppIndex) return MMZ_STREAM_ERROR;
+    *ppIndex = NULL;
+    if ((!pBuf) || (buf_len < 5) || (memcmp(pBuf, "MMZI", 4))) return MMZ_DATA_ERROR;
+    if (!(pIndex = (mmz_index *)MMZ_MALLOC(sizeof(mmz_index)))) return MMZ_MEM_ERROR;
+    memset(pIndex, 0, sizeof(mmz_index));
+    pIndex->m_window_bits = (signed char)pBuf[4]; p += 5;
+    if ((!mmz_inflate_window_log2(pIndex->m_window_bits)) || (!(p = mmz_index_get_varint(p, pEnd, &pIndex->m_total_in))) || (!(p = mmz_index_get_varint(p, pEnd, &pIndex->m_total_out))) ||
+        (!(p = mmz_index_get_varint(p, pEnd, &num_points))) || (num_points > (mmz_uint64)(pEnd - p) / 5)) {
+        MMZ_FREE(pIndex); return MMZ_DATA_ERROR;
+    }
+    if ((num_points) && (!(pIndex->m_pPoints = (mmz_index_point *)MMZ_MALLOC((size_t)num_points * sizeof(mmz_index_point))))) { MMZ_FREE(pIndex); return MMZ_MEM_ERROR; }
+    pIndex->m_capacity = (mmz_uint32)num_points;
+    while (pIndex->m_num_points < num_points) {
+        mmz_index_point *pPoint = &pIndex->m_pPoints[pIndex->m_num_points];
+        mmz_uint64 window_size, comp_size;
+        if ((!(p = mmz_index_get_varint(p, pEnd, &v))) || (!v)) break;
+        pPoint->m_out_ofs = prev_out + v;
+        if (!(p = mmz_index_get_varint(p, pEnd, &v))) break;
+        pPoint->m_in_ofs = prev_in + v;
+        if ((!(p = mmz_index_get_varint(p, pEnd, &v))) || (v >= (1U << 10)) || ((v >> 3) >= (1U << (v & 7)))) break;
+        pPoint->m_bits = (mmz_uint32)(v >> 3); pPoint->m_num_bits = (mmz_uint32)(v & 7);
+        if ((!(p = mmz_index_get_varint(p, pEnd, &window_size))) || (window_size > MMZ_MIN(pPoint->m_out_ofs, (mmz_uint64)MMZ_TINFL_LZ_DICT_SIZE))) break;
+        if ((!(p = mmz_index_get_varint(p, pEnd, &comp_size))) || (comp_size > (mmz_uint64)(pEnd - p))) break;
+        if (!(pPoint->m_pComp_window = (mmz_uint8 *)MMZ_MALLOC(comp_size ? (size_t)comp_size : 1))) { mmz_index_free(pIndex); return MMZ_MEM_ERROR; }
+        memcpy(pPoint->m_pComp_window, p, (size_t)comp_size); p += comp_size;
+        pPoint->m_window_size = (mmz_uint32)window_size; pPoint->m_comp_window_size = (mmz_uint32)comp_size;
+        prev_out = pPoint->m_out_ofs; prev_in = pPoint->m_in_ofs;
+        pIndex->m_num_points++;
+    }
+    if ((pIndex->m_num_points != num_points) || (p != pEnd)) { mmz_index_free(pIndex); return MMZ_DATA_ERROR; }
+    *ppIndex = pIndex;
+    return MMZ_OK;
+}
+
+#ifndef MMZ_PARALLEL_CHUNK_SIZE
+#define MMZ_PARALLEL_CHUNK_SIZE (4 << 20)
 #endif
-#ifdef _MSC_VER
-#pragma warning (pop)
+#define MMZ_PARALLEL_MIN_CHUNK_SIZE (64 << 10)
+// How far into its range a chunk looks for a block header; longer than any dynamic block real compressors write but short enough to give up fast.
+#define MMZ_PARALLEL_SEARCH_SIZE (256 << 10)
+enum { MMZ_PAR_FAILED = -1, MMZ_PAR_STOPPED = 0, MMZ_PAR_DONE = 1, MMZ_PAR_SWITCH = 2, MMZ_PAR_FULL = 3 };
+typedef void (*mmz_par_task_func)(void *pCtx, size_t index);
+// Runs tasks 0..num_tasks-1 at once and waits for them. Task 0, and any the system won't give a thread, run on the calling thread.
+static void mmz_par_run(mmz_par_task_func pTask, void *pCtx, size_t num_tasks) {
+    size_t i;
+#if defined(__cplusplus) && !defined(MMZ_NO_THREADS)
+    std::vector<std::thread> threads;
+    try {
+        threads.reserve(num_tasks);
+        for (i = 1; i < num_tasks; i++) threads.push_back(std::thread(pTask, pCtx, i));
+    } catch (...) { }
+    pTask(pCtx, 0);
+    for (i = threads.size() + 1; i < num_tasks; i++) pTask(pCtx, i);
+    for (i = 0; i < threads.size(); i++) threads[i].join();
+#else
+    for (i = 0; i < num_tasks; i++) pTask(pCtx, i);
 #endif
+}
+static int mmz_par_default_threads(void) {
+#if defined(__cplusplus) && !defined(MMZ_NO_THREADS)
+    return MMZ_MAX((int)std::thread::hardware_concurrency(), 1);
+#else
+    return 1;
+#endif
+}
+// zlib's adler32_combine() and crc32_combine(): the check value of two pieces from theirs and the second one's length.
+static mmz_uint32 mmz_adler32_combine(mmz_uint32 adler1, mmz_uint32 adler2, mmz_uint64 len2) {
+    mmz_uint32 rem = (mmz_uint32)(len2 % 65521U), sum1 = adler1 & 0xFFFF, sum2 = (mmz_uint32)(((mmz_uint64)rem * sum1) % 65521U);
+    sum1 += (adler2 & 0xFFFF) + 65521U - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + 65521U - rem;
+    if (sum1 >= 65521U) sum1 -= 65521U;
+    if (sum1 >= 65521U) sum1 -= 65521U;
+    if (sum2 >= (65521U << 1)) sum2 -= (65521U << 1);
+    if (sum2 >= 65521U) sum2 -= 65521U;
+    return sum1 | (sum2 << 16);
+}
+static mmz_uint32 mmz_crc32_multmodp(mmz_uint32 a, mmz_uint32 b) {
+    mmz_uint32 m = 1U << 31, p = 0;
+    for ( ; ; ) {
+        if (a & m) { p ^= b; if (!(a & (m - 1))) break; }
+        m >>= 1; b = (b >> 1) ^ (0xEDB88320U & (0U - (b & 1)));
+    }
+    return p;
+}
+static mmz_uint32 mmz_crc32_combine(mmz_uint32 crc1, mmz_uint32 crc2, mmz_uint64 len2) {
+    // Multiply crc1 by x^(8 * len2) modulo the CRC polynomial, squaring x^8 along the way.
+    mmz_uint32 x2n = 1U << 23, p = 1U << 31;
+    for ( ; len2; len2 >>= 1, x2n = mmz_crc32_multmodp(x2n, x2n)) if (len2 & 1) p = mmz_crc32_multmodp(x2n, p);
+    return mmz_crc32_multmodp(p, crc1) ^ crc2;
+}
+// Bit reader over the whole input for the speculative decoder. Reads past the end give zero bits, so callers check the position.
+typedef struct {
+    const mmz_uint8 *m_pIn;
+    size_t m_in_len, m_ofs;
+    mmz_uint64 m_bit_buf;
+    mmz_uint32 m_num_bits;
+} mmz_par_bits;
+#define MMZ_PAR_BIT_POS(b) ((b)->m_ofs * 8 - (b)->m_num_bits)
+// Tops the bit buffer up to at least 56 bits. As in mmz_tinfl_decode_block_fast(), bits above m_num_bits belong to the next unread byte.
+static MMZ_FORCEINLINE void mmz_par_refill(mmz_par_bits *b) {
+    if (b->m_ofs + 8 <= b->m_in_len) {
+        b->m_bit_buf |= MMZ_READ_LE64(b->m_pIn + b->m_ofs) << b->m_num_bits; b->m_ofs += (63 - b->m_num_bits) >> 3; b->m_num_bits |= 56;
+        return;
+    }
+    while (b->m_num_bits <= 56) {
+        mmz_uint64 c = (b->m_ofs < b->m_in_len) ? b->m_pIn[b->m_ofs] : 0;
+        b->m_bit_buf |= c << b->m_num_bits; b->m_ofs++; b->m_num_bits += 8;
+    }
+}
+static MMZ_FORCEINLINE mmz_uint32 mmz_par_get_bits(mmz_par_bits *b, mmz_uint32 n) {
+    mmz_uint32 v = (mmz_uint32)b->m_bit_buf & ((1U << n) - 1);
+    b->m_bit_buf >>= n; b->m_num_bits -= n;
+    return v;
+}
+// Decodes one entry of pHuff and consumes its code. Entries with a zero length are unused codes, which the caller must reject.
+static MMZ_FORCEINLINE mmz_uint32 mmz_par_decode_entry(mmz_par_bits *b, const mmz_tinfl_huff_table *pHuff, mmz_uint32 table_bits) {
+    mmz_uint64 bit_buf = b->m_bit_buf; mmz_uint32 num_bits = b->m_num_bits, e;
+    MMZ_TINFL_HUFF_LOOKUP(e, pHuff, table_bits);
+    b->m_bit_buf = bit_buf >> (e & 15); b->m_num_bits = num_bits - (e & 15);
+    return e;
+}
+static mmz_uint32 mmz_par_peek_bits(const mmz_uint8 *pIn, size_t in_len, size_t bit_pos, mmz_uint32 n) {
+    size_t ofs = bit_pos >> 3; mmz_uint32 v = 0, i;
+    for (i = 0; (i < 4) && (ofs + i < in_len); i++) v |= (mmz_uint32)pIn[ofs + i] << (i * 8);
+    return (v >> (bit_pos & 7)) & ((1U << n) - 1);
+}
+// Reads a block's code tables into r. Stricter than mmz_tinfl_decompress() so that random bits rarely pass: the code length code must be complete,
+// and the lit/len code must have an end of block code and at least one more. A real header that fails this just gets decoded serially.
+static mmz_bool mmz_par_read_tables(mmz_par_bits *b, mmz_tinfl_decompressor *r, mmz_uint32 type) {
+    static const mmz_uint8 s_length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+    mmz_uint32 num_lit, num_dist, num_codes, i, total = 0, used = 0;
+    if (type == 1) { mmz_tinfl_set_fixed_tables(r); return MMZ_TRUE; }
+    mmz_par_refill(b);
+    num_lit = mmz_par_get_bits(b, 5) + 257; num_dist = mmz_par_get_bits(b, 5) + 1; num_codes = mmz_par_get_bits(b, 4) + 4;
+    if ((num_lit > 286) || (num_dist > 30)) return MMZ_FALSE;
+    MMZ_CLEAR_OBJ(r->m_tables[2].m_code_size);
+    for (i = 0; i < num_codes; i++) {
+        mmz_uint32 s;
+        if (i == 14) mmz_par_refill(b);
+        s = mmz_par_get_bits(b, 3); r->m_tables[2].m_code_size[s_length_dezigzag[i]] = (mmz_uint8)s;
+        if (s) total += 128 >> s;
+    }
+    if ((total != 128) || (!mmz_tinfl_build_huff_table(&r->m_tables[2], 2, 19))) return MMZ_FALSE;
+    for (i = 0; i < num_lit + num_dist; ) {
+        mmz_uint32 e, sym, rep; mmz_uint8 fill;
+        mmz_par_refill(b);
+        e = mmz_par_decode_entry(b, &r->m_tables[2], MMZ_TINFL_CODE_SIZE_LOOKUP_BITS); sym = e >> 16;
+        if (sym < 16) { r->m_len_codes[i++] = (mmz_uint8)sym; continue; }
+        if ((sym == 16) && (!i)) return MMZ_FALSE;
+        fill = (sym == 16) ? r->m_len_codes[i - 1] : 0;
+        rep = (sym == 16) ? (3 + mmz_par_get_bits(b, 2)) : (sym == 17) ? (3 + mmz_par_get_bits(b, 3)) : (11 + mmz_par_get_bits(b, 7));
+        if (i + rep > num_lit + num_dist) return MMZ_FALSE;
+        memset(r->m_len_codes + i, fill, rep); i += rep;
+    }
+    for (i = 0; i < num_lit; i++) used += (r->m_len_codes[i] != 0);
+    if ((!r->m_len_codes[256]) || (used < 2)) return MMZ_FALSE;
+    memcpy(r->m_tables[0].m_code_size, r->m_len_codes, num_lit); memcpy(r->m_tables[1].m_code_size, r->m_len_codes + num_lit, num_dist);
+    r->m_table_sizes[0] = num_lit; r->m_table_sizes[1] = num_dist;
+    return mmz_tinfl_build_huff_table(&r->m_tables[0], 0, num_lit) && mmz_tinfl_build_huff_table(&r->m_tables[1], 1, num_dist);
+}
+// One thread's share of the input. Its output is m_num_syms 16-bit symbols (256 + i standing for byte i of the unknown 32 KB window before the chunk,
+// m_min_marker being the lowest used) followed by m_num_bytes plain bytes, which sit in m_pBytes after m_bytes_ofs bytes of history. Chunks decoded
+// in place have only m_num_bytes. The first m_head bytes of the output are written by mmz_par_finish_task().
+typedef struct {
+    size_t m_start_bit, m_stop_bit, m_end_bit;
+    int m_status;
+    mmz_uint16 *m_pSyms;
+    mmz_uint8 *m_pBytes;
+    size_t m_num_syms, m_syms_capacity, m_num_bytes, m_bytes_ofs, m_bytes_capacity;
+    size_t m_check_ofs, m_check_len, m_head;
+    mmz_uint32 m_check, m_min_marker;
+    mmz_tinfl_decompressor m_decomp;
+} mmz_par_chunk;
+typedef struct {
+    const mmz_uint8 *m_pIn;
+    mmz_uint8 *m_pDest;
+    size_t m_in_len, m_dest_capacity, m_out_ofs, m_chunk_size;
+    int m_gzip, m_check;
+    mmz_uint32 m_window_size;
+    mmz_par_chunk *m_pChunks;
+} mmz_par_ctx;
+// Runs the regular decoder from the block header at start_bit, writing at *pOut_ofs in *ppBuf, until the stream ends or it reaches a non-final
+// dynamic block header at or past stop_bit. A heap buffer is grown as needed; a fixed one gives MMZ_PAR_FULL when it runs out.
+static int mmz_par_decode_bytes(mmz_tinfl_decompressor *r, const mmz_uint8 *pIn, size_t in_len, size_t start_bit, size_t stop_bit, mmz_uint32 window_size, mmz_uint8 **ppBuf, size_t *pCapacity, size_t *pOut_ofs, mmz_bool can_grow, size_t *pEnd_bit) {
+    size_t in_ofs = start_bit >> 3;
+    mmz_uint32 num_bits = (8 - (mmz_uint32)(start_bit & 7)) & 7;
+    mmz_tinfl_init_at_block(r, num_bits ? (mmz_uint32)(pIn[in_ofs] >> (start_bit & 7)) : 0, num_bits); r->m_window_size = window_size;
+    in_ofs += (num_bits != 0);
+    for ( ; ; ) {
+        size_t in_bytes = in_len - in_ofs, out_bytes = *pCapacity - *pOut_ofs, bit_pos;
+        mmz_tinfl_status status = mmz_tinfl_decompress(r, pIn + in_ofs, &in_bytes, *ppBuf, *ppBuf + *pOut_ofs, &out_bytes, MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | MMZ_TINFL_FLAG_STOP_AT_BLOCK);
+        in_ofs += in_bytes; *pOut_ofs += out_bytes;
+        bit_pos = in_ofs * 8 - r->m_num_bits;
+        if (status == MMZ_TINFL_STATUS_DONE) { *pEnd_bit = bit_pos; return MMZ_PAR_DONE; }
+        if (status == MMZ_TINFL_STATUS_BLOCK_BOUNDARY) {
+            if ((bit_pos >= stop_bit) && (mmz_par_peek_bits(pIn, in_len, bit_pos, 3) == 4)) { *pEnd_bit = bit_pos; return MMZ_PAR_STOPPED; }
+        } else if (status == MMZ_TINFL_STATUS_HAS_MORE_OUTPUT) {
+            mmz_uint8 *pBuf;
+            if (!can_grow) return MMZ_PAR_FULL;
+            if (!(pBuf = (mmz_uint8 *)MMZ_REALLOC(*ppBuf, *pCapacity * 2))) return MMZ_PAR_FAILED;
+            *ppBuf = pBuf; *pCapacity *= 2;
+        } else
+            return MMZ_PAR_FAILED;
+    }
+}
+static mmz_bool mmz_par_reserve_syms(mmz_par_chunk *pChunk, size_t num_syms) {
+    size_t capacity = MMZ_MAX(MMZ_MAX(num_syms, pChunk->m_syms_capacity * 2), (size_t)65536);
+    mmz_uint16 *pSyms = (mmz_uint16 *)MMZ_REALLOC(pChunk->m_pSyms, capacity * sizeof(mmz_uint16));
+    if (!pSyms) return MMZ_FALSE;
+    pChunk->m_pSyms = pSyms; pChunk->m_syms_capacity = capacity;
+    return MMZ_TRUE;
+}
+static mmz_bool mmz_par_has_markers(const mmz_uint16 *pSyms, size_t num_syms) {
+    mmz_uint32 bits = 0; size_t i;
+    for (i = 0; i < num_syms; i++) bits |= pSyms[i];
+    return bits >= 256;
+}
+// Decodes blocks from the header at start_bit into pChunk's symbols, stopping like mmz_par_decode_bytes() or with MMZ_PAR_SWITCH at a block header
+// once the last 32 KB hold no markers. With probe set it only checks that the first block decodes and that the header after it parses.
+static int mmz_par_decode_markers(mmz_par_chunk *pChunk, const mmz_uint8 *pIn, size_t in_len, size_t start_bit, mmz_uint32 window_size, mmz_bool probe) {
+    mmz_tinfl_decompressor *r = &pChunk->m_decomp;
+    mmz_par_bits b;
+    mmz_uint32 num_blocks = 0, final = 0, type;
+    size_t n = 0;
+    b.m_pIn = pIn; b.m_in_len = in_len; b.m_ofs = start_bit >> 3; b.m_bit_buf = 0; b.m_num_bits = 0;
+    mmz_par_refill(&b); mmz_par_get_bits(&b, (mmz_uint32)(start_bit & 7));
+    pChunk->m_min_marker = 256 + MMZ_TINFL_LZ_DICT_SIZE;
+    for ( ; ; num_blocks++) {
+        size_t bit_pos = MMZ_PAR_BIT_POS(&b);
+        pChunk->m_num_syms = n; pChunk->m_end_bit = bit_pos;
+        if (bit_pos > in_len * 8) return MMZ_PAR_FAILED;
+        if (final) return MMZ_PAR_DONE;
+        if (num_blocks) {
+            if ((bit_pos >= pChunk->m_stop_bit) && (mmz_par_peek_bits(pIn, in_len, bit_pos, 3) == 4)) return MMZ_PAR_STOPPED;
+            if ((!probe) && (n >= MMZ_TINFL_LZ_DICT_SIZE) && (!mmz_par_has_markers(pChunk->m_pSyms + n - MMZ_TINFL_LZ_DICT_SIZE, MMZ_TINFL_LZ_DICT_SIZE))) return MMZ_PAR_SWITCH;
+        }
+        mmz_par_refill(&b);
+        final = mmz_par_get_bits(&b, 1); type = mmz_par_get_bits(&b, 2);
+        if (type == 0) {
+            mmz_uint32 len, nlen; size_t ofs, i;
+            mmz_par_get_bits(&b, b.m_num_bits & 7);
+            len = mmz_par_get_bits(&b, 16); nlen = mmz_par_get_bits(&b, 16);
+            // Whole bytes left in the bit buffer are just read ahead; the stored data starts right after the length.
+            ofs = b.m_ofs - (b.m_num_bits >> 3);
+            if ((len != (~nlen & 0xFFFF)) || (ofs > in_len) || (len > in_len - ofs)) return MMZ_PAR_FAILED;
+            if (probe && num_blocks) return MMZ_PAR_STOPPED;
+            if ((n + len > pChunk->m_syms_capacity) && (!mmz_par_reserve_syms(pChunk, n + len))) return MMZ_PAR_FAILED;
+            for (i = 0; i < len; i++) pChunk->m_pSyms[n + i] = pIn[ofs + i];
+            n += len; b.m_ofs = ofs + len; b.m_bit_buf = 0; b.m_num_bits = 0;
+            continue;
+        }
+        if ((type == 3) || (!mmz_par_read_tables(&b, r, type))) return MMZ_PAR_FAILED;
+        if (probe && num_blocks) return MMZ_PAR_STOPPED;
+        for ( ; ; ) {
+            mmz_uint32 e, len, dist; mmz_uint16 *pOut;
+            // A maximum length match plus the copy's overrun.
+            if ((n + 258 + 16 > pChunk->m_syms_capacity) && (!mmz_par_reserve_syms(pChunk, n + 258 + 16))) return MMZ_PAR_FAILED;
+            if (b.m_ofs > in_len + 8) return MMZ_PAR_FAILED;
+            mmz_par_refill(&b);
+            e = mmz_par_decode_entry(&b, &r->m_tables[0], MMZ_TINFL_FAST_LOOKUP_BITS); pOut = pChunk->m_pSyms + n;
+            if (!(e & 15)) return MMZ_PAR_FAILED;
+            if (e & MMZ_TINFL_HUFF_LITERALS) {
+                pOut[0] = (mmz_uint8)(e >> 8); pOut[1] = (mmz_uint8)(e >> 16); pOut[2] = (mmz_uint8)(e >> 24);
+                n += (e >> 4) & 3;
+                continue;
+            }
+            if (e & MMZ_TINFL_HUFF_END_OF_BLOCK) { if (e >> 16) return MMZ_PAR_FAILED; break; }
+            len = (e >> 16) + mmz_par_get_bits(&b, (e >> 8) & 15);
+            e = mmz_par_decode_entry(&b, &r->m_tables[1], MMZ_TINFL_DIST_LOOKUP_BITS);
+            if (!(e & 15)) return MMZ_PAR_FAILED;
+            dist = (e >> 16) + mmz_par_get_bits(&b, (e >> 8) & 15);
+            if (dist > window_size) return MMZ_PAR_FAILED;
+            if (dist <= n) {
+                // Like mmz_tinfl_copy_match(), 16 symbols at a time when the match is at least that far back.
+                const mmz_uint16 *pSrc = pOut - dist; mmz_uint32 i;
+                if (dist >= 16)
+                    for (i = 0; i < len; i += 16) memcpy(pOut + i, pSrc + i, 16 * sizeof(mmz_uint16));
+                else
+                    for (i = 0; i < len; i++) pOut[i] = pSrc[i];
+            } else {
+                mmz_uint32 i;
+                pChunk->m_min_marker = MMZ_MIN(pChunk->m_min_marker, (mmz_uint32)(256 + MMZ_TINFL_LZ_DICT_SIZE + n - dist));
+                for (i = 0; i < len; i++) pOut[i] = (n + i >= dist) ? pOut[(int)i - (int)dist] : (mmz_uint16)(256 + MMZ_TINFL_LZ_DICT_SIZE + n + i - dist);
+            }
+            n += len;
+        }
+    }
+}
+// Finds the first bit near the start of the chunk's range where a non-final dynamic block plausibly starts and decodes from there, switching
+// to the byte decoder once it has a marker free window. A candidate that later turns out not to decode moves the search on.
+static void mmz_par_speculate(mmz_par_ctx *pCtx, mmz_par_chunk *pChunk) {
+    const mmz_uint8 *pIn = pCtx->m_pIn; size_t in_len = pCtx->m_in_len, bit_pos, end_bit = MMZ_MIN(pChunk->m_start_bit + MMZ_MIN(pCtx->m_chunk_size / 4, (size_t)MMZ_PARALLEL_SEARCH_SIZE) * 8, in_len * 8);
+    pChunk->m_status = MMZ_PAR_FAILED; pChunk->m_num_bytes = 0;
+    for (bit_pos = pChunk->m_start_bit; bit_pos < end_bit; bit_pos++) {
+        mmz_uint64 v;
+        mmz_uint32 i, num_codes, total = 0;
+        int status;
+        // Cheap checks on the next 56 bits first: the block type, the table sizes and the first 13 code length code lengths not oversubscribing.
+        if ((bit_pos >> 3) + 8 > in_len) break;
+        v = MMZ_READ_LE64(pIn + (bit_pos >> 3)) >> (bit_pos & 7);
+        if (((v & 7) != 4) || (((v >> 3) & 31) > 29) || (((v >> 8) & 31) > 29)) continue;
+        num_codes = MMZ_MIN((mmz_uint32)((v >> 13) & 15) + 4, 13U);
+        for (i = 0; i < num_codes; i++) { mmz_uint32 l = (mmz_uint32)(v >> (17 + i * 3)) & 7; if (l) total += 128 >> l; }
+        if (total > 128) continue;
+        if (mmz_par_decode_markers(pChunk, pIn, in_len, bit_pos, pCtx->m_window_size, MMZ_TRUE) != MMZ_PAR_STOPPED) continue;
+        status = mmz_par_decode_markers(pChunk, pIn, in_len, bit_pos, pCtx->m_window_size, MMZ_FALSE);
+        if (status == MMZ_PAR_SWITCH) {
+            size_t capacity = MMZ_TINFL_LZ_DICT_SIZE + 4 * pCtx->m_chunk_size, out_ofs = MMZ_TINFL_LZ_DICT_SIZE, j;
+            const mmz_uint16 *pWindow = pChunk->m_pSyms + pChunk->m_num_syms - MMZ_TINFL_LZ_DICT_SIZE;
+            if (pChunk->m_bytes_capacity < capacity) {
+                MMZ_FREE(pChunk->m_pBytes); pChunk->m_bytes_capacity = 0;
+                if (!(pChunk->m_pBytes = (mmz_uint8 *)MMZ_MALLOC(capacity))) return;
+                pChunk->m_bytes_capacity = capacity;
+            }
+            for (j = 0; j < MMZ_TINFL_LZ_DICT_SIZE; j++) pChunk->m_pBytes[j] = (mmz_uint8)pWindow[j];
+            status = mmz_par_decode_bytes(&pChunk->m_decomp, pIn, in_len, pChunk->m_end_bit, pChunk->m_stop_bit, pCtx->m_window_size, &pChunk->m_pBytes, &pChunk->m_bytes_capacity, &out_ofs, MMZ_TRUE, &pChunk->m_end_bit);
+            pChunk->m_bytes_ofs = MMZ_TINFL_LZ_DICT_SIZE; pChunk->m_num_bytes = out_ofs - MMZ_TINFL_LZ_DICT_SIZE;
+        }
+        if (status == MMZ_PAR_FAILED) { pChunk->m_num_bytes = 0; continue; }
+        pChunk->m_start_bit = bit_pos; pChunk->m_status = status;
+        return;
+    }
+}
+// Chunk 0 of a round starts where the last one ended, so it decodes straight into the destination; the rest guess where their first block is.
+static void mmz_par_decode_task(void *pCtx_, size_t index) {
+    mmz_par_ctx *pCtx = (mmz_par_ctx *)pCtx_; mmz_par_chunk *pChunk = &pCtx->m_pChunks[index];
+    if (index) { mmz_par_speculate(pCtx, pChunk); return; }
+    pChunk->m_num_syms = 0; pChunk->m_num_bytes = pCtx->m_out_ofs;
+    pChunk->m_status = mmz_par_decode_bytes(&pChunk->m_decomp, pCtx->m_pIn, pCtx->m_in_len, pChunk->m_start_bit, pChunk->m_stop_bit, pCtx->m_window_size, &pCtx->m_pDest, &pCtx->m_dest_capacity, &pChunk->m_num_bytes, MMZ_FALSE, &pChunk->m_end_bit);
+    pChunk->m_num_bytes -= pCtx->m_out_ofs;
+}
+// Writes bytes from up to end of a chunk's output to the destination. Markers always refer to the same 32 KB before the chunk, so the symbols
+// are resolved through a table of the 256 literals followed by that window.
+static void mmz_par_emit(mmz_par_ctx *pCtx, const mmz_par_chunk *pChunk, size_t from, size_t end) {
+    mmz_uint8 *pOut = pCtx->m_pDest + pChunk->m_check_ofs;
+    size_t i, split = MMZ_MIN(end, pChunk->m_num_syms);
+    if (from < split) {
+        mmz_uint8 look_up[256 + MMZ_TINFL_LZ_DICT_SIZE];
+        size_t window_size = MMZ_MIN(pChunk->m_check_ofs, (size_t)MMZ_TINFL_LZ_DICT_SIZE);
+        for (i = 0; i < 256; i++) look_up[i] = (mmz_uint8)i;
+        memset(look_up + 256, 0, MMZ_TINFL_LZ_DICT_SIZE - window_size); memcpy(look_up + 256 + MMZ_TINFL_LZ_DICT_SIZE - window_size, pOut - window_size, window_size);
+        for (i = from; i < split; i++) pOut[i] = look_up[pChunk->m_pSyms[i]];
+    }
+    from = MMZ_MAX(from, pChunk->m_num_syms);
+    if (from < end) memcpy(pOut + from, pChunk->m_pBytes + pChunk->m_bytes_ofs + from - pChunk->m_num_syms, end - from);
+}
+// Writes the head of a chunk's output, which no later chunk needs as history, then sums the whole output.
+static void mmz_par_finish_task(void *pCtx_, size_t index) {
+    mmz_par_ctx *pCtx = (mmz_par_ctx *)pCtx_; mmz_par_chunk *pChunk = &pCtx->m_pChunks[index];
+    const mmz_uint8 *pOut = pCtx->m_pDest + pChunk->m_check_ofs;
+    mmz_par_emit(pCtx, pChunk, 0, pChunk->m_head);
+    if (pCtx->m_check) pChunk->m_check = pCtx->m_gzip ? mmz_crc32(0, pOut, pChunk->m_check_len) : mmz_adler32(1, pOut, pChunk->m_check_len);
+}
+// Places a verified speculative chunk at out_ofs, writing just its last 32 KB now as the next chunk's history.
+static int mmz_par_place_chunk(mmz_par_ctx *pCtx, mmz_par_chunk *pChunk, size_t out_ofs) {
+    size_t out_len = pChunk->m_num_syms + pChunk->m_num_bytes;
+    if (out_len > pCtx->m_dest_capacity - out_ofs) return MMZ_BUF_ERROR;
+    // A marker for a byte before the start of the stream.
+    if (pChunk->m_min_marker < 256 + MMZ_TINFL_LZ_DICT_SIZE - MMZ_MIN(out_ofs, (size_t)MMZ_TINFL_LZ_DICT_SIZE)) return MMZ_DATA_ERROR;
+    pChunk->m_head = out_len - MMZ_MIN(out_len, (size_t)MMZ_TINFL_LZ_DICT_SIZE);
+    mmz_par_emit(pCtx, pChunk, pChunk->m_head, out_len);
+    return MMZ_OK;
+}
+int mmz_uncompress_parallel(unsigned char *pDest, size_t *pDest_len, const unsigned char *pSource, size_t *pSource_len, int window_bits, int num_threads) {
+    mmz_par_ctx ctx;
+    mmz_par_chunk *pChunks;
+    mmz_tinfl_decompressor *r;
+    mmz_tinfl_status status;
+    mmz_uint32 flags, check;
+    size_t num_chunks, chunk, cur_bit, out_ofs = 0, in_bytes, out_bytes = 0, i, serial_rounds = 0, backoff = 0;
+    int result = MMZ_OK, done = 0;
+    if ((!pDest_len) || (!pSource_len)) return MMZ_STREAM_ERROR;
+    if (((!pDest) && (*pDest_len)) || (!pSource) || (!mmz_inflate_window_log2(window_bits))) return MMZ_PARAM_ERROR;
+    if (!window_bits) window_bits = MMZ_DEFAULT_WINDOW_BITS;
+    if (num_threads <= 0) num_threads = mmz_par_default_threads();
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.m_pIn = pSource; ctx.m_in_len = *pSource_len; ctx.m_pDest = pDest; ctx.m_dest_capacity = *pDest_len; ctx.m_window_size = 1U << mmz_inflate_window_log2(window_bits);
+    ctx.m_chunk_size = MMZ_MAX(MMZ_MIN((size_t)MMZ_PARALLEL_CHUNK_SIZE, ctx.m_in_len / num_threads), (size_t)MMZ_PARALLEL_MIN_CHUNK_SIZE);
+    num_chunks = (ctx.m_in_len + ctx.m_chunk_size - 1) / ctx.m_chunk_size;
+    num_threads = (int)MMZ_MAX(MMZ_MIN((size_t)num_threads, num_chunks), (size_t)1);
+    if (!(pChunks = ctx.m_pChunks = (mmz_par_chunk *)MMZ_MALLOC(num_threads * sizeof(mmz_par_chunk)))) return MMZ_MEM_ERROR;
+    for (i = 0; i < (size_t)num_threads; i++) { pChunks[i].m_pSyms = NULL; pChunks[i].m_pBytes = NULL; pChunks[i].m_syms_capacity = pChunks[i].m_bytes_capacity = 0; }
+    // Let the regular decoder read the zlib or gzip header, stopping at the first block.
+    r = &pChunks[0].m_decomp; mmz_tinfl_init(r);
+    flags = mmz_index_stream_flags(window_bits);
+    in_bytes = ctx.m_in_len;
+    status = mmz_tinfl_decompress(r, pSource, &in_bytes, pDest, pDest, &out_bytes, flags | MMZ_TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF | MMZ_TINFL_FLAG_STOP_AT_BLOCK);
+    if ((status != MMZ_TINFL_STATUS_BLOCK_BOUNDARY) || ((flags) && (!r->m_gzip) && ((8 + (int)(r->m_zhdr0 >> 4)) > mmz_inflate_window_log2(window_bits)))) {
+        MMZ_FREE(pChunks); *pSource_len = in_bytes;
+        return MMZ_DATA_ERROR;
+    }
+    ctx.m_gzip = (int)r->m_gzip; ctx.m_check = (flags != 0); check = ctx.m_gzip ? 0 : 1;
+    cur_bit = in_bytes * 8 - r->m_num_bits;
+    // Each round hands the chunks from the one holding cur_bit on to the threads. Chunk i's decoding ends at the first non-final dynamic block at
+    // or past the start of chunk i + 1's range, which is also the first place chunk i + 1 looks, so a correct guess starts exactly where the last ended.
+    // After a round without a single good guess (all stored blocks, say) the next rounds run serially, twice as many each time it happens again.
+    while (!done) {
+        size_t num = 0, first = cur_bit / (ctx.m_chunk_size * 8), width = serial_rounds ? 1 : (size_t)num_threads, hits = 0;
+        serial_rounds -= (serial_rounds != 0);
+        for (num = 0; (num < width) && ((!num) || (first + num < num_chunks)); num++) {
+            mmz_par_chunk *pChunk = &pChunks[num];
+            size_t next = (first + num + 1) * ctx.m_chunk_size;
+            pChunk->m_start_bit = num ? ((first + num) * ctx.m_chunk_size * 8) : cur_bit;
+            pChunk->m_stop_bit = (next < ctx.m_in_len) ? (next * 8) : (size_t)-1;
+            pChunk->m_head = 0;
+        }
+        ctx.m_out_ofs = out_ofs;
+        mmz_par_run(mmz_par_decode_task, &ctx, num);
+        for (i = 0; (i < num) && (!done); i++) {
+            mmz_par_chunk *pChunk = &pChunks[i];
+            pChunk->m_check_ofs = out_ofs;
+            if ((i) && ((pChunk->m_status == MMZ_PAR_FAILED) || (pChunk->m_start_bit != cur_bit))) {
+                // A bad guess: decode it again from where the previous chunk really ended.
+                size_t end_ofs = out_ofs;
+                pChunk->m_start_bit = cur_bit;
+                pChunk->m_status = mmz_par_decode_bytes(&pChunk->m_decomp, pSource, ctx.m_in_len, cur_bit, pChunk->m_stop_bit, ctx.m_window_size, &ctx.m_pDest, &ctx.m_dest_capacity, &end_ofs, MMZ_FALSE, &pChunk->m_end_bit);
+                pChunk->m_num_syms = 0; pChunk->m_num_bytes = end_ofs - out_ofs; pChunk->m_head = 0;
+            } else if (i) {
+                if ((result = mmz_par_place_chunk(&ctx, pChunk, out_ofs)) != MMZ_OK) break;
+                hits++;
+            }
+            if (pChunk->m_status == MMZ_PAR_FULL) { result = MMZ_BUF_ERROR; break; }
+            if (pChunk->m_status == MMZ_PAR_FAILED) { result = MMZ_DATA_ERROR; break; }
+            out_ofs += pChunk->m_num_syms + pChunk->m_num_bytes;
+            pChunk->m_check_len = out_ofs - pChunk->m_check_ofs;
+            cur_bit = pChunk->m_end_bit; done = (pChunk->m_status == MMZ_PAR_DONE);
+        }
+        if (result != MMZ_OK) break;
+        if ((num > 1) && (!hits)) { backoff = backoff ? MMZ_MIN(backoff * 2, (size_t)64) : 1; serial_rounds = backoff; }
+        else if (hits) backoff = 0;
+        mmz_par_run(mmz_par_finish_task, &ctx, i);
+        for (chunk = 0; (ctx.m_check) && (chunk < i); chunk++)
+            check = ctx.m_gzip ? mmz_crc32_combine(check, pChunks[chunk].m_check, pChunks[chunk].m_check_len) : mmz_adler32_combine(check, pChunks[chunk].m_check, pChunks[chunk].m_check_len);
+    }
+    for (i = 0; i < (size_t)num_threads; i++) { MMZ_FREE(pChunks[i].m_pSyms); MMZ_FREE(pChunks[i].m_pBytes); }
+    MMZ_FREE(pChunks);
+    in_bytes = (cur_bit + 7) >> 3;
+    if ((result == MMZ_OK) && (ctx.m_check)) {
+        const mmz_uint8 *pTrailer = pSource + in_bytes;
+        if (ctx.m_gzip) {
+            if ((ctx.m_in_len - in_bytes < 8) || (MMZ_READ_LE32(pTrailer) != check) || (MMZ_READ_LE32(pTrailer + 4) != (mmz_uint32)out_ofs)) result = MMZ_DATA_ERROR;
+            in_bytes += 8;
+        } else {
+            if ((ctx.m_in_len - in_bytes < 4) || ((((mmz_uint32)pTrailer[0] << 24) | ((mmz_uint32)pTrailer[1] << 16) | ((mmz_uint32)pTrailer[2] << 8) | pTrailer[3]) != check)) result = MMZ_DATA_ERROR;
+            in_bytes += 4;
+        }
+    }
+    *pSource_len = MMZ_MIN(in_bytes, ctx.m_in_len);
+    if (result == MMZ_OK) *pDest_len = out_ofs;
+    return result;
+}
+
+// Batches smaller than this much input per thread use fewer threads, as starting one costs about as much as compressing that.
+#define MMZ_BATCH_MIN_BYTES_PER_THREAD (64 << 10)
+typedef struct {
+    mmz_batch_item *m_pItems;
+    size_t m_num_items;
+    int m_param;
+#if defined(__cplusplus) && !defined(MMZ_NO_THREADS)
+    std::atomic<size_t> m_next_item;
+#else
+    size_t m_next_item;
+#endif
+} mmz_batch_ctx;
+static mmz_batch_item *mmz_batch_next(mmz_batch_ctx *pCtx) {
+    size_t i = pCtx->m_next_item++;
+    return (i < pCtx->m_num_items) ? &pCtx->m_pItems[i] : NULL;
+}
+static void mmz_compress_batch_task(void *pCtx_, size_t index) {
+    mmz_batch_ctx *pCtx = (mmz_batch_ctx *)pCtx_;
+    mmz_uint flags = mmz_tdefl_create_comp_flags_from_zip_params(pCtx->m_param, MMZ_DEFAULT_WINDOW_BITS, MMZ_DEFAULT_STRATEGY);
+    mmz_tdefl_compressor *pComp = NULL;
+    mmz_batch_item *pItem;
+    (void)index;
+    while ((pItem = mmz_batch_next(pCtx)) != NULL) {
+        size_t in_len = pItem->m_source_len, out_len = pItem->m_dest_len;
+        mmz_tdefl_status status;
+        if ((!pComp) && ((pComp = (mmz_tdefl_compressor *)MMZ_MALLOC(sizeof(mmz_tdefl_compressor))) == NULL)) { pItem->m_status = MMZ_MEM_ERROR; continue; }
+        mmz_tdefl_init(pComp, NULL, NULL, (int)flags);
+        status = mmz_tdefl_compress(pComp, pItem->m_pSource, &in_len, pItem->m_pDest, &out_len, MMZ_TDEFL_FINISH);
+        pItem->m_status = (status == MMZ_TDEFL_STATUS_DONE) ? MMZ_OK : (status == MMZ_TDEFL_STATUS_OKAY) ? MMZ_BUF_ERROR : MMZ_STREAM_ERROR;
+        if (status == MMZ_TDEFL_STATUS_DONE) pItem->m_dest_len = out_len;
+    }
+    MMZ_FREE(pComp);
+}
+static void mmz_uncompress_batch_task(void *pCtx_, size_t index) {
+    mmz_batch_ctx *pCtx = (mmz_batch_ctx *)pCtx_;
+    mmz_stream stream;
+    mmz_batch_item *pItem;
+    int status = MMZ_OK;
+    (void)index;
+    memset(&stream, 0, sizeof(stream));
+    while ((pItem = mmz_batch_next(pCtx)) != NULL) {
+        if ((pItem->m_source_len | pItem->m_dest_len) > 0xFFFFFFFFU) { pItem->m_status = MMZ_PARAM_ERROR; continue; }
+        if (!stream.state) status = mmz_inflateInit2(&stream, pCtx->m_param); else mmz_inflateReset(&stream);
+        if (status != MMZ_OK) { pItem->m_status = status; continue; }
+        stream.next_in = pItem->m_pSource; stream.avail_in = (mmz_uint32)pItem->m_source_len;
+        stream.next_out = pItem->m_pDest; stream.avail_out = (mmz_uint32)pItem->m_dest_len;
+        status = mmz_inflate(&stream, MMZ_FINISH);
+        pItem->m_source_len = stream.total_in;
+        if (status == MMZ_STREAM_END) { pItem->m_dest_len = stream.total_out; pItem->m_status = MMZ_OK; }
+        else pItem->m_status = (((status == MMZ_BUF_ERROR) && (!stream.avail_in)) || (status == MMZ_NEED_DICT)) ? MMZ_DATA_ERROR : status;
+        status = MMZ_OK;
+    }
+    mmz_inflateEnd(&stream);
+}
+static int mmz_batch_run(mmz_par_task_func pTask, mmz_batch_item *pItems, size_t num_items, int param, int num_threads) {
+    mmz_batch_ctx ctx;
+    size_t i, total = 0;
+    if ((!pItems) && (num_items)) return MMZ_PARAM_ERROR;
+    for (i = 0; i < num_items; i++) {
+        if ((!pItems[i].m_pSource) && (pItems[i].m_source_len)) return MMZ_PARAM_ERROR;
+        if ((!pItems[i].m_pDest) && (pItems[i].m_dest_len)) return MMZ_PARAM_ERROR;
+        total += pItems[i].m_source_len;
+    }
+    if (num_threads <= 0) num_threads = mmz_par_default_threads();
+    ctx.m_pItems = pItems; ctx.m_num_items = num_items; ctx.m_param = param; ctx.m_next_item = 0;
+    mmz_par_run(pTask, &ctx, MMZ_MAX(MMZ_MIN(MMZ_MIN((size_t)num_threads, num_items), total / MMZ_BATCH_MIN_BYTES_PER_THREAD + 1), (size_t)1));
+    for (i = 0; i < num_items; i++)
+        if (pItems[i].m_status != MMZ_OK) return pItems[i].m_status;
+    return MMZ_OK;
+}
+int mmz_compress_batch(mmz_batch_item *pItems, size_t num_items, int level, int num_threads) {
+    return mmz_batch_run(mmz_compress_batch_task, pItems, num_items, level, num_threads);
+}
+int mmz_uncompress_batch(mmz_batch_item *pItems, size_t num_items, int window_bits, int num_threads) {
+    if (!mmz_inflate_window_log2(window_bits)) return MMZ_PARAM_ERROR;
+    return mmz_batch_run(mmz_uncompress_batch_task, pItems, num_items, window_bits, num_threads);
+}
+
+#ifndef MMZ_COMPRESS_PARALLEL_CHUNK_SIZE
+#define MMZ_COMPRESS_PARALLEL_CHUNK_SIZE (128 << 10)
+#endif
+typedef struct {
+    mmz_tdefl_output_buffer m_out;
+    mmz_uint32 m_adler32;
+    int m_status;
+} mmz_cpar_chunk;
+typedef struct {
+    const mmz_uint8 *m_pIn;
+    size_t m_in_len, m_num_chunks;
+    mmz_cpar_chunk *m_pChunks;
+    mmz_uint m_flags;
+#if defined(__cplusplus) && !defined(MMZ_NO_THREADS)
+    std::atomic<size_t> m_next_chunk;
+#else
+    size_t m_next_chunk;
+#endif
+} mmz_cpar_ctx;
+// Deflates whole chunks (raw, taking their Adler-32 on the way) until none are left, reusing one compressor.
+static void mmz_compress_parallel_task(void *pCtx_, size_t index) {
+    mmz_cpar_ctx *pCtx = (mmz_cpar_ctx *)pCtx_;
+    mmz_tdefl_compressor *pComp = (mmz_tdefl_compressor *)MMZ_MALLOC(sizeof(mmz_tdefl_compressor));
+    size_t i;
+    (void)index;
+    while ((i = pCtx->m_next_chunk++) < pCtx->m_num_chunks) {
+        mmz_cpar_chunk *pChunk = &pCtx->m_pChunks[i];
+        size_t ofs = i * MMZ_COMPRESS_PARALLEL_CHUNK_SIZE, len = MMZ_MIN(pCtx->m_in_len - ofs, (size_t)MMZ_COMPRESS_PARALLEL_CHUNK_SIZE);
+        mmz_bool last = (i + 1 == pCtx->m_num_chunks);
+        if (!pComp) { pChunk->m_status = MMZ_MEM_ERROR; continue; }
+        mmz_tdefl_init(pComp, mmz_tdefl_output_buffer_putter, &pChunk->m_out, (int)pCtx->m_flags);
+        mmz_tdefl_set_history(pComp, pCtx->m_pIn + ofs - MMZ_MIN(ofs, (size_t)MMZ_TDEFL_LZ_DICT_SIZE), MMZ_MIN(ofs, (size_t)MMZ_TDEFL_LZ_DICT_SIZE));
+        // Only the last chunk is final; the rest end byte aligned after an empty stored block so the next one can follow straight on.
+        if (mmz_tdefl_compress_buffer(pComp, pCtx->m_pIn + ofs, len, last ? MMZ_TDEFL_FINISH : MMZ_TDEFL_SYNC_FLUSH) != (last ? MMZ_TDEFL_STATUS_DONE : MMZ_TDEFL_STATUS_OKAY))
+            pChunk->m_status = MMZ_MEM_ERROR;
+        pChunk->m_adler32 = mmz_tdefl_get_adler32(pComp);
+    }
+    MMZ_FREE(pComp);
+}
+int mmz_compress_parallel(unsigned char *pDest, size_t *pDest_len, const unsigned char *pSource, size_t source_len, int level, int num_threads) {
+    mmz_cpar_ctx ctx;
+    size_t i, out_len = 2;
+    mmz_uint32 adler32 = 1;
+    int result = MMZ_OK;
+    if (!pDest_len) return MMZ_STREAM_ERROR;
+    if (((!pDest) && (*pDest_len)) || ((!pSource) && (source_len))) return MMZ_PARAM_ERROR;
+    if (num_threads <= 0) num_threads = mmz_par_default_threads();
+    ctx.m_pIn = pSource; ctx.m_in_len = source_len;
+    ctx.m_num_chunks = MMZ_MAX((source_len + MMZ_COMPRESS_PARALLEL_CHUNK_SIZE - 1) / MMZ_COMPRESS_PARALLEL_CHUNK_SIZE, (size_t)1);
+    ctx.m_flags = MMZ_TDEFL_COMPUTE_ADLER32 | mmz_tdefl_create_comp_flags_from_zip_params(level, -MMZ_DEFAULT_WINDOW_BITS, MMZ_DEFAULT_STRATEGY);
+    ctx.m_next_chunk = 0;
+    if (!(ctx.m_pChunks = (mmz_cpar_chunk *)MMZ_MALLOC(ctx.m_num_chunks * sizeof(mmz_cpar_chunk)))) return MMZ_MEM_ERROR;
+    memset(ctx.m_pChunks, 0, ctx.m_num_chunks * sizeof(mmz_cpar_chunk));
+    mmz_par_run(mmz_compress_parallel_task, &ctx, MMZ_MIN((size_t)num_threads, ctx.m_num_chunks));
+    // The zlib header (as mmz_compress2() writes it), the chunks in order, then the Adler-32 of the whole input combined from theirs.
+    if (*pDest_len >= 2) { pDest[0] = 0x78; pDest[1] = 0x01; }
+    for (i = 0; i < ctx.m_num_chunks; i++) {
+        mmz_cpar_chunk *pChunk = &ctx.m_pChunks[i];
+        if ((pChunk->m_status != MMZ_OK) && (result == MMZ_OK)) result = pChunk->m_status;
+        if ((result == MMZ_OK) && (out_len + pChunk->m_out.m_size <= *pDest_len)) memcpy(pDest + out_len, pChunk->m_out.m_pBuf, pChunk->m_out.m_size);
+        out_len += pChunk->m_out.m_size;
+        adler32 = mmz_adler32_combine(adler32, pChunk->m_adler32, MMZ_MIN(source_len - i * MMZ_COMPRESS_PARALLEL_CHUNK_SIZE, (size_t)MMZ_COMPRESS_PARALLEL_CHUNK_SIZE));
+        MMZ_FREE(pChunk->m_out.m_pBuf);
+    }
+    MMZ_FREE(ctx.m_pChunks);
+    if (result != MMZ_OK) return result;
+    if (out_len + 4 > *pDest_len) return MMZ_BUF_ERROR;
+    for (i = 0; i < 4; i++) pDest[out_len++] = (mmz_uint8)(adler32 >> (24 - 8 * i));
+    *pDest_len = out_len;
+    return MMZ_OK;
+}
+
 #ifdef __cplusplus
 }
 #endif
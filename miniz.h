@@ -29,6 +29,21 @@ typedef void *(*mz_alloc_func)(void *opaque, size_t items, size_t size);
 typedef void (*mz_free_func)(void *opaque, void *address);
 typedef void *(*mz_realloc_func)(void *opaque, void *address, size_t items, size_t size);
 
+// Arena (bump) allocator. Point a stream's zalloc/zfree at mz_arena_alloc_func/mz_arena_free_func with opaque set to the mz_arena, or pass them to
+// the *_ex helpers below. Allocations are carved out of the caller's buffer in 16 byte aligned pieces, freeing is a no-op, and mz_arena_reset()
+// releases everything at once. An allocation that doesn't fit fails, which the APIs report as MZ_MEM_ERROR (or a failed helper call).
+// An arena isn't thread safe: give each thread or request its own.
+typedef struct mz_arena_s
+{
+  unsigned char *m_pBuf;
+  size_t m_size;
+  size_t m_ofs;                     // bytes used so far, including alignment padding
+} mz_arena;
+void mz_arena_init(mz_arena *pArena, void *pBuf, size_t buf_size);
+void mz_arena_reset(mz_arena *pArena);
+void *mz_arena_alloc_func(void *opaque, size_t items, size_t size);
+void mz_arena_free_func(void *opaque, void *address);
+
 #define MZ_VERSION          "9.1.15"
 #define MZ_VERNUM           0x91F0
 #define MZ_VER_MAJOR        9
@@ -42,8 +57,9 @@ enum { MZ_NO_FLUSH = 0, MZ_PARTIAL_FLUSH = 1, MZ_SYNC_FLUSH = 2, MZ_FULL_FLUSH =
 // Return status codes. MZ_PARAM_ERROR is non-standard.
 enum { MZ_OK = 0, MZ_STREAM_END = 1, MZ_NEED_DICT = 2, MZ_ERRNO = -1, MZ_STREAM_ERROR = -2, MZ_DATA_ERROR = -3, MZ_MEM_ERROR = -4, MZ_BUF_ERROR = -5, MZ_VERSION_ERROR = -6, MZ_PARAM_ERROR = -10000 };
 
-// Compression levels: 0-9 are the standard zlib-style levels, 10 is best possible compression (not zlib compatible, and may be very slow), MZ_DEFAULT_COMPRESSION=MZ_DEFAULT_LEVEL.
-enum { MZ_NO_COMPRESSION = 0, MZ_BEST_SPEED = 1, MZ_BEST_COMPRESSION = 9, MZ_UBER_COMPRESSION = 10, MZ_DEFAULT_LEVEL = 6, MZ_DEFAULT_COMPRESSION = -1 };
+// Compression levels: 0-9 are the standard zlib-style levels, 10 is best possible compression (not zlib compatible, and may be very slow), 11 (and up) parses
+// optimally (much slower still, for data compressed once and read many times), MZ_DEFAULT_COMPRESSION=MZ_DEFAULT_LEVEL.
+enum { MZ_NO_COMPRESSION = 0, MZ_BEST_SPEED = 1, MZ_BEST_COMPRESSION = 9, MZ_UBER_COMPRESSION = 10, MZ_OPTIMAL_COMPRESSION = 11, MZ_DEFAULT_LEVEL = 6, MZ_DEFAULT_COMPRESSION = -1 };
 
 // Window bits
 #define MZ_DEFAULT_WINDOW_BITS 15
@@ -101,6 +117,11 @@ int mz_deflateInit2(mz_streamp pStream, int level, int method, int window_bits,
 // Quickly resets a compressor without having to reallocate anything. Same as calling mz_deflateEnd() followed by mz_deflateInit()/mz_deflateInit2().
 int mz_deflateReset(mz_streamp pStream);
 
+// mz_deflateSetDictionary() primes a freshly initialized or reset compressor with a preset dictionary (only its last 32KB are used), before any
+// input. zlib streams then get the FDICT flag and the dictionary's Adler-32 (also returned in adler) in their header, so the decompressor needs the
+// same dictionary. To share one dictionary between many streams without hashing it each time, see tdefl_init_dictionary() and mz_deflateSetSharedDictionary().
+int mz_deflateSetDictionary(mz_streamp pStream, const unsigned char *pDictionary, unsigned int dict_length);
+
 // mz_deflate() compresses the input to output, consuming as much of the input and producing as much output as possible.
 // Parameters:
 //   pStream is the stream to read from and write to. You must initialize/update the next_in, avail_in, next_out, and avail_out members.
@@ -209,6 +230,7 @@ const char *mz_error(int err);
 //  #define deflateInit           mz_deflateInit
 //  #define deflateInit2          mz_deflateInit2
 //  #define deflateReset          mz_deflateReset
+//  #define deflateSetDictionary  mz_deflateSetDictionary
 //  #define deflate               mz_deflate
 //  #define deflateEnd            mz_deflateEnd
 //  #define deflateBound          mz_deflateBound
@@ -262,12 +284,15 @@ typedef int mz_bool;
 // TINFL_FLAG_HAS_MORE_INPUT: If set, there are more input bytes available beyond the end of the supplied input buffer. If clear, the input buffer contains all remaining input.
 // TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF: If set, the output buffer is large enough to hold the entire decompressed stream. If clear, the output buffer is at least the size of the dictionary (typically 32KB).
 // TINFL_FLAG_COMPUTE_ADLER32: Force adler-32 checksum computation of the decompressed bytes.
+// TINFL_FLAG_MULTI_MEMBER: Only used by the tinfl_decompress_mem_to_*() helpers below. If set, input left over after the end of a stream is decoded as another
+//  stream (with its own zlib header and adler-32 if TINFL_FLAG_PARSE_ZLIB_HEADER is set) and appended to the same output. tinfl_decompress() ignores it.
 enum
 {
   TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
   TINFL_FLAG_HAS_MORE_INPUT = 2,
   TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
-  TINFL_FLAG_COMPUTE_ADLER32 = 8
+  TINFL_FLAG_COMPUTE_ADLER32 = 8,
+  TINFL_FLAG_MULTI_MEMBER = 16
 };
 
 // High level decompression functions:
@@ -289,6 +314,8 @@ size_t tinfl_decompress_mem_to_mem(void *pOut_buf, size_t out_buf_len, const voi
 // Returns 1 on success or 0 on failure.
 typedef int (*tinfl_put_buf_func_ptr)(const void* pBuf, int len, void *pUser);
 int tinfl_decompress_mem_to_callback(const void *pIn_buf, size_t *pIn_buf_size, tinfl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags);
+// tinfl_decompress_mem_to_callback_ex() is the same, but allocates its 32KB buffer through pAlloc/pFree (e.g. mz_arena_alloc_func) instead of malloc(). NULL pAlloc/pFree mean malloc()/free().
+int tinfl_decompress_mem_to_callback_ex(const void *pIn_buf, size_t *pIn_buf_size, tinfl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags, mz_alloc_func pAlloc, mz_free_func pFree, void *pAlloc_opaque);
 
 struct tinfl_decompressor_tag; typedef struct tinfl_decompressor_tag tinfl_decompressor;
 
@@ -368,6 +395,10 @@ enum
 // TDEFL_FILTER_MATCHES: Discards matches <= 5 chars if enabled.
 // TDEFL_FORCE_ALL_STATIC_BLOCKS: Disable usage of optimized Huffman tables.
 // TDEFL_FORCE_ALL_RAW_BLOCKS: Only use raw (uncompressed) deflate blocks.
+// TDEFL_BT_MATCHES: Find matches with binary trees (as in LZMA's BT4) instead of hash chains, the probe count limiting the depth of each search. The
+// search cost no longer grows with how repetitive the data is, but every byte must be inserted, so it's slower than the chains at levels 1-10 (which don't set it).
+// TDEFL_OPTIMAL_PARSING: Choose between the matches the binary trees find (it implies TDEFL_BT_MATCHES) by their cost in bits, a few passes at a time as in
+// Zopfli, instead of greedily or lazily. Much slower; used by level 11.
 // The low 12 bits are reserved to control the max # of hash probes per dictionary lookup (see TDEFL_MAX_PROBES_MASK).
 enum
 {
@@ -378,7 +409,9 @@ enum
   TDEFL_RLE_MATCHES                   = 0x10000,
   TDEFL_FILTER_MATCHES                = 0x20000,
   TDEFL_FORCE_ALL_STATIC_BLOCKS       = 0x40000,
-  TDEFL_FORCE_ALL_RAW_BLOCKS          = 0x80000
+  TDEFL_FORCE_ALL_RAW_BLOCKS          = 0x80000,
+  TDEFL_BT_MATCHES                    = 0x100000,
+  TDEFL_OPTIMAL_PARSING               = 0x200000
 };
 
 // High level compression functions:
@@ -415,15 +448,36 @@ typedef mz_bool (*tdefl_put_buf_func_ptr)(const void* pBuf, int len, void *pUser
 // tdefl_compress_mem_to_output() compresses a block to an output stream. The above helpers use this function internally.
 mz_bool tdefl_compress_mem_to_output(const void *pBuf, size_t buf_len, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags);
 
+// The _ex variants allocate the tdefl_compressor through pAlloc/pFree (e.g. mz_arena_alloc_func) instead of malloc(). NULL pAlloc/pFree mean malloc()/free().
+mz_bool tdefl_compress_mem_to_output_ex(const void *pBuf, size_t buf_len, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags, mz_alloc_func pAlloc, mz_free_func pFree, void *pAlloc_opaque);
+size_t tdefl_compress_mem_to_mem_ex(void *pOut_buf, size_t out_buf_len, const void *pSrc_buf, size_t src_buf_len, int flags, mz_alloc_func pAlloc, mz_free_func pFree, void *pAlloc_opaque);
+
 enum { TDEFL_MAX_HUFF_TABLES = 3, TDEFL_MAX_HUFF_SYMBOLS_0 = 288, TDEFL_MAX_HUFF_SYMBOLS_1 = 32, TDEFL_MAX_HUFF_SYMBOLS_2 = 19, TDEFL_LZ_DICT_SIZE = 32768, TDEFL_LZ_DICT_SIZE_MASK = TDEFL_LZ_DICT_SIZE - 1, TDEFL_MIN_MATCH_LEN = 3, TDEFL_MAX_MATCH_LEN = 258 };
 
+// TDEFL_LZ_HASH_BITS sets the number of hash chain heads (1 << bits, at least 4096 since the level 1 compressor shares the table). Chains are keyed
+// on 4 bytes, so 3 byte matches are found through a separate table of 1 << TDEFL_LZ_HASH3_BITS heads without chains (0 disables it and with it
+// 3 byte matches).
+#ifndef TDEFL_LZ_HASH_BITS
+  #define TDEFL_LZ_HASH_BITS (TDEFL_LESS_MEMORY ? 12 : 15)
+#endif
+#ifndef TDEFL_LZ_HASH3_BITS
+  #define TDEFL_LZ_HASH3_BITS (TDEFL_LESS_MEMORY ? 11 : 14)
+#endif
+#if (TDEFL_LZ_HASH_BITS < 12) || (TDEFL_LZ_HASH_BITS > 16) || (TDEFL_LZ_HASH3_BITS < 0) || (TDEFL_LZ_HASH3_BITS > 16)
+  #error TDEFL_LZ_HASH_BITS must be 12-16 and TDEFL_LZ_HASH3_BITS 0-16
+#endif
+
 // TDEFL_OUT_BUF_SIZE MUST be large enough to hold a single entire compressed output block (using static/fixed Huffman codes).
 #if TDEFL_LESS_MEMORY
-enum { TDEFL_LZ_CODE_BUF_SIZE = 24 * 1024, TDEFL_OUT_BUF_SIZE = (TDEFL_LZ_CODE_BUF_SIZE * 13 ) / 10, TDEFL_MAX_HUFF_SYMBOLS = 288, TDEFL_LZ_HASH_BITS = 12, TDEFL_LEVEL1_HASH_SIZE_MASK = 4095, TDEFL_LZ_HASH_SHIFT = (TDEFL_LZ_HASH_BITS + 2) / 3, TDEFL_LZ_HASH_SIZE = 1 << TDEFL_LZ_HASH_BITS };
+enum { TDEFL_LZ_CODE_BUF_SIZE = 24 * 1024, TDEFL_OUT_BUF_SIZE = (TDEFL_LZ_CODE_BUF_SIZE * 13 ) / 10, TDEFL_MAX_HUFF_SYMBOLS = 288, TDEFL_LEVEL1_HASH_SIZE_MASK = 4095, TDEFL_LZ_HASH_SIZE = 1 << TDEFL_LZ_HASH_BITS, TDEFL_LZ_HASH3_SIZE = 1 << TDEFL_LZ_HASH3_BITS };
 #else
-enum { TDEFL_LZ_CODE_BUF_SIZE = 64 * 1024, TDEFL_OUT_BUF_SIZE = (TDEFL_LZ_CODE_BUF_SIZE * 13 ) / 10, TDEFL_MAX_HUFF_SYMBOLS = 288, TDEFL_LZ_HASH_BITS = 15, TDEFL_LEVEL1_HASH_SIZE_MASK = 4095, TDEFL_LZ_HASH_SHIFT = (TDEFL_LZ_HASH_BITS + 2) / 3, TDEFL_LZ_HASH_SIZE = 1 << TDEFL_LZ_HASH_BITS };
+enum { TDEFL_LZ_CODE_BUF_SIZE = 64 * 1024, TDEFL_OUT_BUF_SIZE = (TDEFL_LZ_CODE_BUF_SIZE * 13 ) / 10, TDEFL_MAX_HUFF_SYMBOLS = 288, TDEFL_LEVEL1_HASH_SIZE_MASK = 4095, TDEFL_LZ_HASH_SIZE = 1 << TDEFL_LZ_HASH_BITS, TDEFL_LZ_HASH3_SIZE = 1 << TDEFL_LZ_HASH3_BITS };
 #endif
 
+// TDEFL_OPTIMAL_PARSING parses up to TDEFL_OPT_CHUNK_SIZE positions at a time (plus a match running past the end), caching up to TDEFL_OPT_MAX_MATCHES
+// (len, dist) pairs for them.
+enum { TDEFL_OPT_CHUNK_SIZE = TDEFL_LZ_CODE_BUF_SIZE / 16, TDEFL_OPT_MAX_POS = TDEFL_OPT_CHUNK_SIZE + TDEFL_MAX_MATCH_LEN, TDEFL_OPT_MAX_MATCHES = TDEFL_OPT_CHUNK_SIZE * 4 };
+
 // The low-level tdefl functions below may be used directly if the above helper functions aren't flexible enough. The low-level functions don't make any heap allocations, unlike the above helper functions.
 typedef enum
 {
@@ -460,6 +514,7 @@ typedef struct
   tdefl_flush m_flush;
   const mz_uint8 *m_pSrc;
   size_t m_src_buf_left, m_out_buf_ofs;
+  mz_uint m_preset_dict_adler32, m_has_preset_dict;
   mz_uint8 m_dict[TDEFL_LZ_DICT_SIZE + TDEFL_MAX_MATCH_LEN - 1];
   mz_uint16 m_huff_count[TDEFL_MAX_HUFF_TABLES][TDEFL_MAX_HUFF_SYMBOLS];
   mz_uint16 m_huff_codes[TDEFL_MAX_HUFF_TABLES][TDEFL_MAX_HUFF_SYMBOLS];
@@ -467,9 +522,21 @@ typedef struct
   mz_uint8 m_lz_code_buf[TDEFL_LZ_CODE_BUF_SIZE];
   mz_uint16 m_next[TDEFL_LZ_DICT_SIZE];
   mz_uint16 m_hash[TDEFL_LZ_HASH_SIZE];
+  mz_uint16 m_hash3[TDEFL_LZ_HASH3_SIZE];
+  mz_uint m_opt_num_pos, m_opt_num_matches;
   mz_uint8 m_output_buf[TDEFL_OUT_BUF_SIZE];
+  // Only TDEFL_BT_MATCHES uses m_bt_right, and only TDEFL_OPTIMAL_PARSING the rest, so they come last (see tdefl_compressor_size()).
+  mz_uint16 m_bt_right[TDEFL_LZ_DICT_SIZE];
+  mz_uint16 m_opt_pos_matches[TDEFL_OPT_MAX_POS];
+  mz_uint16 m_opt_matches[TDEFL_OPT_MAX_MATCHES * 2];
+  mz_uint32 m_opt_cost[TDEFL_OPT_MAX_POS + 1], m_opt_arrival[TDEFL_OPT_MAX_POS + 1];
 } tdefl_compressor;
 
+// tdefl_compressor_size() returns how many bytes of a tdefl_compressor tdefl_init() with these flags will touch: the whole structure with
+// TDEFL_OPTIMAL_PARSING, without the optimal parser's arrays (about 106KB) with just TDEFL_BT_MATCHES, and without m_bt_right (64KB more) otherwise.
+// A heap allocated compressor may be that size, as long as it's never initialized with flags needing more.
+size_t tdefl_compressor_size(int flags);
+
 // Initializes the compressor.
 // There is no corresponding deinit() function because the tdefl API's do not dynamically allocate memory.
 // pBut_buf_func: If NULL, output data will be supplied to the specified callback. In this case, the user should call the tdefl_compress_buffer() API for compression.
@@ -487,9 +554,28 @@ tdefl_status tdefl_compress_buffer(tdefl_compressor *d, const void *pIn_buf, siz
 tdefl_status tdefl_get_prev_return_status(tdefl_compressor *d);
 mz_uint32 tdefl_get_adler32(tdefl_compressor *d);
 
+// tdefl_set_dictionary() primes the compressor with a preset dictionary (its last TDEFL_LZ_DICT_SIZE bytes) right after tdefl_init(), before any
+// input. With TDEFL_WRITE_ZLIB_HEADER the header then carries FDICT and the dictionary's Adler-32.
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDictionary, size_t dict_len);
+
+// A preset dictionary hashed once by tdefl_init_dictionary() for both of tdefl's match finders. It is only read afterwards, so any number of
+// compressors on any threads can start from it with tdefl_set_shared_dictionary() (or mz_deflateSetSharedDictionary()) for the cost of a few memcpy()s.
+typedef struct
+{
+  mz_uint m_size, m_adler32;
+  mz_uint8 m_dict[TDEFL_LZ_DICT_SIZE + TDEFL_MAX_MATCH_LEN - 1];
+  mz_uint16 m_next[TDEFL_LZ_DICT_SIZE];
+  mz_uint16 m_hash[TDEFL_LZ_HASH_SIZE];
+  mz_uint16 m_hash3[TDEFL_LZ_HASH3_SIZE];
+  mz_uint16 m_level1_hash[TDEFL_LEVEL1_HASH_SIZE_MASK + 1];
+} tdefl_dictionary;
+void tdefl_init_dictionary(tdefl_dictionary *pDict, const void *pDictionary, size_t dict_len);
+tdefl_status tdefl_set_shared_dictionary(tdefl_compressor *d, const tdefl_dictionary *pDict);
+int mz_deflateSetSharedDictionary(mz_streamp pStream, const tdefl_dictionary *pDict);
+
 
 // Create tdefl_compress() flags given zlib-style compression parameters.
-// level may range from [0,10] (where 10 is absolute max compression, but may be much slower on some files)
+// level may range from [0,11] (where 10 is absolute max compression, but may be much slower on some files, and 11 parses optimally, slower still)
 // window_bits may be -15 (raw deflate) or 15 (zlib)
 // strategy may be either MZ_DEFAULT_STRATEGY, MZ_FILTERED, MZ_HUFFMAN_ONLY, MZ_RLE, or MZ_FIXED
 mz_uint tdefl_create_comp_flags_from_zip_params(int level, int window_bits, int strategy);
@@ -510,8 +596,25 @@ typedef unsigned char mz_validate_uint32[sizeof(mz_uint32)==4 ? 1 : -1];
 typedef unsigned char mz_validate_uint64[sizeof(mz_uint64)==8 ? 1 : -1];
 
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
 
+// Adler-32 has SSSE3 and AVX2 kernels on x86, picked at runtime from the CPU's feature bits. Define MINIZ_NO_SIMD_ADLER32 to only use the scalar loop.
+#ifndef MINIZ_NO_SIMD_ADLER32
+  #if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define MINIZ_SIMD_ADLER32 1
+    #define MZ_TARGET_SSSE3 __attribute__((target("ssse3")))
+    #define MZ_TARGET_AVX2 __attribute__((target("avx2")))
+  #elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #include <immintrin.h>
+    #define MINIZ_SIMD_ADLER32 1
+    #define MZ_TARGET_SSSE3
+    #define MZ_TARGET_AVX2
+  #endif
+#endif
+
 #define MZ_ASSERT(x) assert(x)
 
   #define MZ_MALLOC(x) malloc(x)
@@ -539,10 +642,107 @@ typedef unsigned char mz_validate_uint64[sizeof(mz_uint64)==8 ? 1 : -1];
 
 // ------------------- zlib-style API's
 
+#ifdef MINIZ_SIMD_ADLER32
+enum { MZ_CPU_SSSE3 = 1, MZ_CPU_AVX2 = 2 };
+static int mz_cpu_features(void)
+{
+#ifdef _MSC_VER
+  // Benign race: every thread computes the same value.
+  static volatile int s_features = -1; int features = s_features;
+  if (features < 0)
+  {
+    int regs[4]; features = 0;
+    __cpuid(regs, 1);
+    if (regs[2] & (1 << 9)) features |= MZ_CPU_SSSE3;
+    // AVX2 also needs the OS to save the YMM registers (OSXSAVE set and XCR0 bits 1-2 enabled).
+    if ((regs[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6)) { __cpuidex(regs, 7, 0); if (regs[1] & (1 << 5)) features |= MZ_CPU_AVX2; }
+    s_features = features;
+  }
+  return features;
+#else
+  return (__builtin_cpu_supports("ssse3") ? MZ_CPU_SSSE3 : 0) | (__builtin_cpu_supports("avx2") ? MZ_CPU_AVX2 : 0);
+#endif
+}
+
+// Both kernels sum 32 byte blocks: s1 gets the byte sums (psadbw) and s2 the sums weighted 32..1 (pmaddubsw), plus 32 times the s1 value at the start
+// of each block, which is collected in v_ps. At most 5552 bytes go by between the modulos, as in the scalar loop. The tail is left to the caller.
+static MZ_TARGET_SSSE3 mz_uint32 mz_adler32_ssse3(mz_uint32 adler, const mz_uint8 **pPtr, size_t num_blocks)
+{
+  const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17), tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+  const mz_uint8 *ptr = *pPtr; mz_uint32 s1 = adler & 0xffff, s2 = adler >> 16;
+  while (num_blocks)
+  {
+    size_t n = MZ_MIN(num_blocks, 5552 / 32);
+    __m128i v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n)), v_s1 = zero, v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+    num_blocks -= n;
+    do
+    {
+      const __m128i bytes1 = _mm_loadu_si128((const __m128i *)ptr), bytes2 = _mm_loadu_si128((const __m128i *)(ptr + 16));
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+      ptr += 32;
+    } while (--n);
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1))); v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1))); v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 = (s1 + (mz_uint32)_mm_cvtsi128_si32(v_s1)) % 65521U; s2 = (mz_uint32)_mm_cvtsi128_si32(v_s2) % 65521U;
+  }
+  *pPtr = ptr;
+  return (s2 << 16) + s1;
+}
+
+static MZ_TARGET_AVX2 mz_uint32 mz_adler32_avx2(mz_uint32 adler, const mz_uint8 **pPtr, size_t num_blocks)
+{
+  const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m256i zero = _mm256_setzero_si256(), ones = _mm256_set1_epi16(1);
+  const mz_uint8 *ptr = *pPtr; mz_uint32 s1 = adler & 0xffff, s2 = adler >> 16;
+  while (num_blocks)
+  {
+    size_t n = MZ_MIN(num_blocks, 5552 / 32);
+    __m256i v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0), v_s1 = zero, v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+    __m128i s1_sum, s2_sum;
+    num_blocks -= n;
+    do
+    {
+      const __m256i bytes = _mm256_loadu_si256((const __m256i *)ptr);
+      v_ps = _mm256_add_epi32(v_ps, v_s1);
+      v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+      v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+      ptr += 32;
+    } while (--n);
+    v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+    s1_sum = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+    s2_sum = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+    s1_sum = _mm_add_epi32(s1_sum, _mm_shuffle_epi32(s1_sum, _MM_SHUFFLE(2, 3, 0, 1))); s1_sum = _mm_add_epi32(s1_sum, _mm_shuffle_epi32(s1_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    s2_sum = _mm_add_epi32(s2_sum, _mm_shuffle_epi32(s2_sum, _MM_SHUFFLE(2, 3, 0, 1))); s2_sum = _mm_add_epi32(s2_sum, _mm_shuffle_epi32(s2_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 = (s1 + (mz_uint32)_mm_cvtsi128_si32(s1_sum)) % 65521U; s2 = (mz_uint32)_mm_cvtsi128_si32(s2_sum) % 65521U;
+  }
+  *pPtr = ptr;
+  return (s2 << 16) + s1;
+}
+#endif // MINIZ_SIMD_ADLER32
+
 mz_ulong mz_adler32(mz_ulong adler, const unsigned char *ptr, size_t buf_len)
 {
-  mz_uint32 i, s1 = (mz_uint32)(adler & 0xffff), s2 = (mz_uint32)(adler >> 16); size_t block_len = buf_len % 5552;
+  mz_uint32 i, s1, s2; size_t block_len;
   if (!ptr) return MZ_ADLER32_INIT;
+#ifdef MINIZ_SIMD_ADLER32
+  if (buf_len >= 64)
+  {
+    int features = mz_cpu_features();
+    if (features & (MZ_CPU_SSSE3 | MZ_CPU_AVX2))
+    {
+      const mz_uint8 *pEnd = ptr + buf_len;
+      adler = (features & MZ_CPU_AVX2) ? mz_adler32_avx2((mz_uint32)adler, &ptr, buf_len / 32) : mz_adler32_ssse3((mz_uint32)adler, &ptr, buf_len / 32);
+      buf_len = pEnd - ptr;
+    }
+  }
+#endif
+  s1 = (mz_uint32)(adler & 0xffff), s2 = (mz_uint32)(adler >> 16); block_len = buf_len % 5552;
   while (buf_len) {
     for (i = 0; i + 7 < block_len; i += 8, ptr += 8) {
       s1 += ptr[0], s2 += s1; s1 += ptr[1], s2 += s1; s1 += ptr[2], s2 += s1; s1 += ptr[3], s2 += s1;
@@ -576,6 +776,34 @@ static void *def_alloc_func(void *opaque, size_t items, size_t size) { (void)opa
 static void def_free_func(void *opaque, void *address) { (void)opaque, (void)address; MZ_FREE(address); }
 static void *def_realloc_func(void *opaque, void *address, size_t items, size_t size) { (void)opaque, (void)address, (void)items, (void)size; return MZ_REALLOC(address, items * size); }
 
+void mz_arena_init(mz_arena *pArena, void *pBuf, size_t buf_size)
+{
+  pArena->m_pBuf = (unsigned char *)pBuf; pArena->m_size = pBuf ? buf_size : 0; pArena->m_ofs = 0;
+}
+
+void mz_arena_reset(mz_arena *pArena)
+{
+  pArena->m_ofs = 0;
+}
+
+void *mz_arena_alloc_func(void *opaque, size_t items, size_t size)
+{
+  mz_arena *pArena = (mz_arena *)opaque; size_t ofs, avail;
+  if ((size) && (items > ((size_t)-1) / size)) return NULL;
+  // Pad so the block starts on a 16 byte boundary of the actual address, whatever the alignment of the arena's buffer.
+  ofs = pArena->m_ofs + ((0 - (size_t)(pArena->m_pBuf + pArena->m_ofs)) & 15);
+  if (ofs > pArena->m_size) return NULL;
+  avail = pArena->m_size - ofs;
+  if (items * size > avail) return NULL;
+  pArena->m_ofs = ofs + items * size;
+  return pArena->m_pBuf + ofs;
+}
+
+void mz_arena_free_func(void *opaque, void *address)
+{
+  (void)opaque, (void)address;
+}
+
 const char *mz_version(void)
 {
   return MZ_VERSION;
@@ -603,7 +831,7 @@ int mz_deflateInit2(mz_streamp pStream, int level, int method, int window_bits,
   if (!pStream->zalloc) pStream->zalloc = def_alloc_func;
   if (!pStream->zfree) pStream->zfree = def_free_func;
 
-  pComp = (tdefl_compressor *)pStream->zalloc(pStream->opaque, 1, sizeof(tdefl_compressor));
+  pComp = (tdefl_compressor *)pStream->zalloc(pStream->opaque, 1, tdefl_compressor_size((int)comp_flags));
   if (!pComp)
     return MZ_MEM_ERROR;
 
@@ -626,6 +854,24 @@ int mz_deflateReset(mz_streamp pStream)
   return MZ_OK;
 }
 
+int mz_deflateSetDictionary(mz_streamp pStream, const unsigned char *pDictionary, unsigned int dict_length)
+{
+  tdefl_compressor *d;
+  if ((!pStream) || (!pStream->state)) return MZ_STREAM_ERROR;
+  d = (tdefl_compressor*)pStream->state;
+  if (tdefl_set_dictionary(d, pDictionary, dict_length) != TDEFL_STATUS_OKAY) return MZ_STREAM_ERROR;
+  if (d->m_flags & TDEFL_WRITE_ZLIB_HEADER) pStream->adler = d->m_preset_dict_adler32;
+  return MZ_OK;
+}
+
+int mz_deflateSetSharedDictionary(mz_streamp pStream, const tdefl_dictionary *pDict)
+{
+  if ((!pStream) || (!pStream->state) || (!pDict)) return MZ_STREAM_ERROR;
+  if (tdefl_set_shared_dictionary((tdefl_compressor*)pStream->state, pDict) != TDEFL_STATUS_OKAY) return MZ_STREAM_ERROR;
+  if (((tdefl_compressor*)pStream->state)->m_flags & TDEFL_WRITE_ZLIB_HEADER) pStream->adler = pDict->m_adler32;
+  return MZ_OK;
+}
+
 int mz_deflate(mz_streamp pStream, int flush)
 {
   size_t in_bytes, out_bytes;
@@ -1238,23 +1484,17 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
   TINFL_CR_FINISH
 
 common_exit:
+  // The bit buffer may have read whole bytes past the end of the stream, so hand them back to the caller.
+  if (status == TINFL_STATUS_DONE)
+  {
+    while ((pIn_buf_cur > pIn_buf_next) && (num_bits >= 8)) { pIn_buf_cur--; num_bits -= 8; }
+  }
   r->m_num_bits = num_bits; r->m_bit_buf = bit_buf; r->m_dist = dist; r->m_counter = counter; r->m_num_extra = num_extra; r->m_dist_from_out_buf_start = dist_from_out_buf_start;
   *pIn_buf_size = pIn_buf_cur - pIn_buf_next; *pOut_buf_size = pOut_buf_cur - pOut_buf_next;
   if ((decomp_flags & (TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32)) && (status >= 0))
   {
-    const mz_uint8 *ptr = pOut_buf_next; size_t buf_len = *pOut_buf_size;
-    mz_uint32 i, s1 = r->m_check_adler32 & 0xffff, s2 = r->m_check_adler32 >> 16; size_t block_len = buf_len % 5552;
-    while (buf_len)
-    {
-      for (i = 0; i + 7 < block_len; i += 8, ptr += 8)
-      {
-        s1 += ptr[0], s2 += s1; s1 += ptr[1], s2 += s1; s1 += ptr[2], s2 += s1; s1 += ptr[3], s2 += s1;
-        s1 += ptr[4], s2 += s1; s1 += ptr[5], s2 += s1; s1 += ptr[6], s2 += s1; s1 += ptr[7], s2 += s1;
-      }
-      for ( ; i < block_len; ++i) s1 += *ptr++, s2 += s1;
-      s1 %= 65521U, s2 %= 65521U; buf_len -= block_len; block_len = 5552;
-    }
-    r->m_check_adler32 = (s2 << 16) + s1; if ((status == TINFL_STATUS_DONE) && (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) && (r->m_check_adler32 != r->m_z_adler32)) status = TINFL_STATUS_ADLER32_MISMATCH;
+    if (*pOut_buf_size) r->m_check_adler32 = (mz_uint32)mz_adler32(r->m_check_adler32, pOut_buf_next, *pOut_buf_size);
+    if ((status == TINFL_STATUS_DONE) && (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) && (r->m_check_adler32 != r->m_z_adler32)) status = TINFL_STATUS_ADLER32_MISMATCH;
   }
   return status;
 }
@@ -1262,13 +1502,13 @@ common_exit:
 // Higher level helper functions.
 void *tinfl_decompress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, size_t *pOut_len, int flags)
 {
-  tinfl_decompressor decomp; void *pBuf = NULL, *pNew_buf; size_t src_buf_ofs = 0, out_buf_capacity = 0;
+  tinfl_decompressor decomp; void *pBuf = NULL, *pNew_buf; size_t src_buf_ofs = 0, out_buf_capacity = 0, member_ofs = 0;
   *pOut_len = 0;
   tinfl_init(&decomp);
   for ( ; ; )
   {
     size_t src_buf_size = src_buf_len - src_buf_ofs, dst_buf_size = out_buf_capacity - *pOut_len, new_out_buf_capacity;
-    tinfl_status status = tinfl_decompress(&decomp, (const mz_uint8*)pSrc_buf + src_buf_ofs, &src_buf_size, (mz_uint8*)pBuf, pBuf ? (mz_uint8*)pBuf + *pOut_len : NULL, &dst_buf_size,
+    tinfl_status status = tinfl_decompress(&decomp, (const mz_uint8*)pSrc_buf + src_buf_ofs, &src_buf_size, pBuf ? (mz_uint8*)pBuf + member_ofs : NULL, pBuf ? (mz_uint8*)pBuf + *pOut_len : NULL, &dst_buf_size,
       (flags & ~TINFL_FLAG_HAS_MORE_INPUT) | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
     if ((status < 0) || (status == TINFL_STATUS_NEEDS_MORE_INPUT))
     {
@@ -1276,7 +1516,12 @@ void *tinfl_decompress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, siz
     }
     src_buf_ofs += src_buf_size;
     *pOut_len += dst_buf_size;
-    if (status == TINFL_STATUS_DONE) break;
+    if (status == TINFL_STATUS_DONE)
+    {
+      if ((!(flags & TINFL_FLAG_MULTI_MEMBER)) || (src_buf_ofs == src_buf_len)) break;
+      tinfl_init(&decomp); member_ofs = *pOut_len;
+      continue;
+    }
     new_out_buf_capacity = out_buf_capacity * 2; if (new_out_buf_capacity < 128) new_out_buf_capacity = 128;
     pNew_buf = MZ_REALLOC(pBuf, new_out_buf_capacity);
     if (!pNew_buf)
@@ -1290,16 +1535,31 @@ void *tinfl_decompress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, siz
 
 size_t tinfl_decompress_mem_to_mem(void *pOut_buf, size_t out_buf_len, const void *pSrc_buf, size_t src_buf_len, int flags)
 {
-  tinfl_decompressor decomp; tinfl_status status; tinfl_init(&decomp);
-  status = tinfl_decompress(&decomp, (const mz_uint8*)pSrc_buf, &src_buf_len, (mz_uint8*)pOut_buf, (mz_uint8*)pOut_buf, &out_buf_len, (flags & ~TINFL_FLAG_HAS_MORE_INPUT) | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
-  return (status != TINFL_STATUS_DONE) ? TINFL_DECOMPRESS_MEM_TO_MEM_FAILED : out_buf_len;
+  tinfl_decompressor decomp; tinfl_status status; size_t src_buf_ofs = 0, out_buf_ofs = 0;
+  do
+  {
+    size_t src_buf_size = src_buf_len - src_buf_ofs, dst_buf_size = out_buf_len - out_buf_ofs;
+    tinfl_init(&decomp);
+    status = tinfl_decompress(&decomp, (const mz_uint8*)pSrc_buf + src_buf_ofs, &src_buf_size, (mz_uint8*)pOut_buf + out_buf_ofs, (mz_uint8*)pOut_buf + out_buf_ofs, &dst_buf_size, (flags & ~TINFL_FLAG_HAS_MORE_INPUT) | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+    if (status != TINFL_STATUS_DONE) return TINFL_DECOMPRESS_MEM_TO_MEM_FAILED;
+    src_buf_ofs += src_buf_size; out_buf_ofs += dst_buf_size;
+  } while ((flags & TINFL_FLAG_MULTI_MEMBER) && (src_buf_ofs < src_buf_len));
+  return out_buf_ofs;
 }
 
 int tinfl_decompress_mem_to_callback(const void *pIn_buf, size_t *pIn_buf_size, tinfl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags)
+{
+  return tinfl_decompress_mem_to_callback_ex(pIn_buf, pIn_buf_size, pPut_buf_func, pPut_buf_user, flags, NULL, NULL, NULL);
+}
+
+int tinfl_decompress_mem_to_callback_ex(const void *pIn_buf, size_t *pIn_buf_size, tinfl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags, mz_alloc_func pAlloc, mz_free_func pFree, void *pAlloc_opaque)
 {
   int result = 0;
   tinfl_decompressor decomp;
-  mz_uint8 *pDict = (mz_uint8*)MZ_MALLOC(TINFL_LZ_DICT_SIZE); size_t in_buf_ofs = 0, dict_ofs = 0;
+  mz_uint8 *pDict; size_t in_buf_ofs = 0, dict_ofs = 0;
+  if (!pAlloc) pAlloc = def_alloc_func;
+  if (!pFree) pFree = def_free_func;
+  pDict = (mz_uint8*)pAlloc(pAlloc_opaque, 1, TINFL_LZ_DICT_SIZE);
   if (!pDict)
     return TINFL_STATUS_FAILED;
   tinfl_init(&decomp);
@@ -1311,14 +1571,19 @@ int tinfl_decompress_mem_to_callback(const void *pIn_buf, size_t *pIn_buf_size,
     in_buf_ofs += in_buf_size;
     if ((dst_buf_size) && (!(*pPut_buf_func)(pDict + dict_ofs, (int)dst_buf_size, pPut_buf_user)))
       break;
+    dict_ofs = (dict_ofs + dst_buf_size) & (TINFL_LZ_DICT_SIZE - 1);
+    if ((status == TINFL_STATUS_DONE) && (flags & TINFL_FLAG_MULTI_MEMBER) && (in_buf_ofs < *pIn_buf_size))
+    {
+      tinfl_init(&decomp);
+      continue;
+    }
     if (status != TINFL_STATUS_HAS_MORE_OUTPUT)
     {
       result = (status == TINFL_STATUS_DONE);
       break;
     }
-    dict_ofs = (dict_ofs + dst_buf_size) & (TINFL_LZ_DICT_SIZE - 1);
   }
-  MZ_FREE(pDict);
+  pFree(pAlloc_opaque, pDict);
   *pIn_buf_size = in_buf_ofs;
   return result;
 }
@@ -1696,7 +1961,9 @@ static int tdefl_flush_block(tdefl_compressor *d, int flush)
 
   if ((d->m_flags & TDEFL_WRITE_ZLIB_HEADER) && (!d->m_block_index))
   {
-    TDEFL_PUT_BITS(0x78, 8); TDEFL_PUT_BITS(0x01, 8);
+    // With a preset dictionary: FDICT set (0x7820 is a multiple of 31 already), then the dictionary's Adler-32.
+    TDEFL_PUT_BITS(0x78, 8); TDEFL_PUT_BITS(d->m_has_preset_dict ? 0x20 : 0x01, 8);
+    if (d->m_has_preset_dict) { mz_uint i, a = d->m_preset_dict_adler32; for (i = 0; i < 4; i++) { TDEFL_PUT_BITS((a >> 24) & 0xFF, 8); a <<= 8; } }
   }
 
   TDEFL_PUT_BITS(flush == TDEFL_FINISH, 1);
@@ -1814,6 +2081,16 @@ static MZ_FORCEINLINE void tdefl_find_match(tdefl_compressor *d, mz_uint lookahe
 }
 
 
+#define TDEFL_USES_FAST_PATH(flags) ((((flags) & TDEFL_MAX_PROBES_MASK) == 1) && (((flags) & TDEFL_GREEDY_PARSING_FLAG) != 0) && (((flags) & (TDEFL_FILTER_MATCHES | TDEFL_FORCE_ALL_RAW_BLOCKS | TDEFL_RLE_MATCHES)) == 0))
+#define TDEFL_USES_OPTIMAL_PARSING(flags) ((((flags) & TDEFL_OPTIMAL_PARSING) != 0) && (((flags) & TDEFL_MAX_PROBES_MASK) != 0) && (((flags) & (TDEFL_FORCE_ALL_RAW_BLOCKS | TDEFL_RLE_MATCHES)) == 0))
+#define TDEFL_LEVEL1_HASH(trigram) (((trigram) ^ ((trigram) >> (24 - (TDEFL_LZ_HASH_BITS - 8)))) & TDEFL_LEVEL1_HASH_SIZE_MASK)
+// Multiplicative hashes of the 4 (chains) and 3 (m_hash3) bytes packed into the low bits of seq, first byte highest.
+#define TDEFL_READ_SEQ3(p) (((mz_uint32)(p)[0] << 16) | ((mz_uint32)(p)[1] << 8) | (mz_uint32)(p)[2])
+#define TDEFL_LZ_HASH4(seq) (((mz_uint32)(seq) * 2654435761U) >> (32 - TDEFL_LZ_HASH_BITS))
+#if TDEFL_LZ_HASH3_BITS
+#define TDEFL_LZ_HASH3(seq) ((((mz_uint32)(seq) & 0xFFFFFF) * 2654435761U) >> (32 - TDEFL_LZ_HASH3_BITS))
+#endif
+
 static mz_bool tdefl_compress_fast(tdefl_compressor *d)
 {
   // Faster, minimally featured LZRW1-style match+parse loop with better register utilization. Intended for applications where raw throughput is valued more highly than ratio.
@@ -1848,7 +2125,7 @@ static mz_bool tdefl_compress_fast(tdefl_compressor *d)
       mz_uint cur_match_dist, cur_match_len = 1;
       mz_uint8 *pCur_dict = d->m_dict + cur_pos;
       mz_uint first_trigram = (*(const mz_uint32 *)pCur_dict) & 0xFFFFFF;
-      mz_uint hash = (first_trigram ^ (first_trigram >> (24 - (TDEFL_LZ_HASH_BITS - 8)))) & TDEFL_LEVEL1_HASH_SIZE_MASK;
+      mz_uint hash = TDEFL_LEVEL1_HASH(first_trigram);
       mz_uint probe_pos = d->m_hash[hash];
       d->m_hash[hash] = (mz_uint16)lookahead_pos;
 
@@ -1981,6 +2258,87 @@ static MZ_FORCEINLINE void tdefl_record_match(tdefl_compressor *d, mz_uint match
   if (match_len >= TDEFL_MIN_MATCH_LEN) d->m_huff_count[0][s_tdefl_len_sym[match_len - TDEFL_MIN_MATCH_LEN]]++;
 }
 
+// Length of the common prefix of p and q, from len (already known to match) up to max_len.
+static MZ_FORCEINLINE mz_uint tdefl_match_len(const mz_uint8 *p, const mz_uint8 *q, mz_uint len, mz_uint max_len)
+{
+  while ((len + 4 <= max_len) && (MZ_READ_LE32(p + len) == MZ_READ_LE32(q + len))) len += 4;
+  while ((len < max_len) && (p[len] == q[len])) len++;
+  return len;
+}
+
+// Binary tree match finder (TDEFL_BT_MATCHES). Each m_hash head roots a tree of the earlier positions with the same 4 byte hash, ordered by the
+// strings that follow them, with m_next and m_bt_right holding each node's lesser and greater child. Inserting lookahead_pos walks down from the
+// root, splitting the tree around the new string, which becomes the root. The nodes passed on the way are the closest strings to it from either
+// side, so they include the longest match there is. Every match longer than the previous one goes in pMatches (if not NULL) as a (len, dist)
+// pair; returns the number of matches. Nodes farther than max_dist or beyond the search depth are cut off, as is the rest of the tree when the
+// lookahead runs out, and a match of the nice length replaces its node, so a search never costs more than the depth.
+#define TDEFL_BT_NICE_LEN(depth) MZ_MIN((mz_uint)TDEFL_MAX_MATCH_LEN, 16 + (depth))
+static mz_uint tdefl_bt_find_matches(tdefl_compressor *d, mz_uint lookahead_pos, mz_uint max_dist, mz_uint max_match_len, mz_uint16 *pMatches)
+{
+  mz_uint pos = lookahead_pos & TDEFL_LZ_DICT_SIZE_MASK, depth = d->m_flags & TDEFL_MAX_PROBES_MASK, nice_len = TDEFL_BT_NICE_LEN(depth);
+  mz_uint cmp_len = pMatches ? max_match_len : MZ_MIN(max_match_len, nice_len);
+  mz_uint less_len = 0, greater_len = 0, best_len = TDEFL_MIN_MATCH_LEN - 1, num_matches = 0;
+  const mz_uint8 *s = d->m_dict + pos;
+  mz_uint hash = TDEFL_LZ_HASH4((TDEFL_READ_SEQ3(s) << 8) | s[3]), cur = d->m_hash[hash];
+  mz_uint16 *pLess = &d->m_next[pos], *pGreater = &d->m_bt_right[pos];
+  MZ_ASSERT((max_match_len > TDEFL_MIN_MATCH_LEN) && (max_match_len <= TDEFL_MAX_MATCH_LEN));
+  d->m_hash[hash] = (mz_uint16)lookahead_pos;
+  for ( ; ; )
+  {
+    mz_uint dist = (mz_uint16)(lookahead_pos - cur), probe_pos = cur & TDEFL_LZ_DICT_SIZE_MASK, len;
+    const mz_uint8 *p = d->m_dict + probe_pos;
+    if ((!cur) || (!dist) || (dist > max_dist) || (!depth--))
+    {
+      *pLess = *pGreater = 0; break;
+    }
+    len = tdefl_match_len(s, p, MZ_MIN(less_len, greater_len), cmp_len);
+    if (len > best_len)
+    {
+      if (pMatches) { pMatches[num_matches * 2] = (mz_uint16)len; pMatches[num_matches * 2 + 1] = (mz_uint16)dist; }
+      best_len = len; num_matches++;
+    }
+    if (len >= nice_len)
+    {
+      // The node's children are within the window of the node, not necessarily of the new string, and positions are only kept mod 64K.
+      mz_uint lesser = d->m_next[probe_pos], greater = d->m_bt_right[probe_pos];
+      *pLess = (mz_uint16)(((mz_uint16)(lookahead_pos - lesser) <= max_dist) ? lesser : 0);
+      *pGreater = (mz_uint16)(((mz_uint16)(lookahead_pos - greater) <= max_dist) ? greater : 0);
+      break;
+    }
+    if (len >= max_match_len)
+    {
+      // Out of lookahead (flushing), so there's no telling which side of the node the string goes: drop the rest to keep the tree sorted.
+      *pLess = *pGreater = 0; break;
+    }
+    if (p[len] < s[len])
+    {
+      *pLess = (mz_uint16)cur; pLess = &d->m_bt_right[probe_pos]; cur = *pLess; less_len = len;
+    }
+    else
+    {
+      *pGreater = (mz_uint16)cur; pGreater = &d->m_next[probe_pos]; cur = *pGreater; greater_len = len;
+    }
+  }
+  return num_matches;
+}
+
+// Builds the trees over the first size bytes of m_dict (a preset dictionary), as tdefl_compress_normal() would have while compressing them.
+static void tdefl_bt_hash_dictionary(tdefl_compressor *d, mz_uint size)
+{
+  mz_uint i;
+  for (i = 0; i + TDEFL_MIN_MATCH_LEN < size; i++)
+    tdefl_bt_find_matches(d, i, i, MZ_MIN(size - i, (mz_uint)TDEFL_MAX_MATCH_LEN), NULL);
+}
+
+// Moves the lookahead forward by len_to_move bytes, which join the dictionary.
+static MZ_FORCEINLINE void tdefl_move_lookahead(tdefl_compressor *d, mz_uint len_to_move)
+{
+  d->m_lookahead_pos += len_to_move;
+  MZ_ASSERT(d->m_lookahead_size >= len_to_move);
+  d->m_lookahead_size -= len_to_move;
+  d->m_dict_size = MZ_MIN(d->m_dict_size + len_to_move, (mz_uint)TDEFL_LZ_DICT_SIZE);
+}
+
 static mz_bool tdefl_compress_normal(tdefl_compressor *d)
 {
   const mz_uint8 *pSrc = d->m_pSrc; size_t src_buf_left = d->m_src_buf_left;
@@ -1989,11 +2347,11 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
   while ((src_buf_left) || ((flush) && (d->m_lookahead_size)))
   {
     mz_uint len_to_move, cur_match_dist, cur_match_len, cur_pos;
-    // Update dictionary and hash chains. Keeps the lookahead size equal to TDEFL_MAX_MATCH_LEN.
-    if ((d->m_lookahead_size + d->m_dict_size) >= (TDEFL_MIN_MATCH_LEN - 1))
+    // Update dictionary and hash chains. Keeps the lookahead size equal to TDEFL_MAX_MATCH_LEN. A position is chained once its 4th byte arrives.
+    if (d->m_flags & TDEFL_BT_MATCHES)
     {
-      mz_uint dst_pos = (d->m_lookahead_pos + d->m_lookahead_size) & TDEFL_LZ_DICT_SIZE_MASK, ins_pos = d->m_lookahead_pos + d->m_lookahead_size - 2;
-      mz_uint hash = (d->m_dict[ins_pos & TDEFL_LZ_DICT_SIZE_MASK] << TDEFL_LZ_HASH_SHIFT) ^ d->m_dict[(ins_pos + 1) & TDEFL_LZ_DICT_SIZE_MASK];
+      // The binary trees are updated by the parser instead, since inserting a position is also what searches them.
+      mz_uint dst_pos = (d->m_lookahead_pos + d->m_lookahead_size) & TDEFL_LZ_DICT_SIZE_MASK;
       mz_uint num_bytes_to_process = (mz_uint)MZ_MIN(src_buf_left, TDEFL_MAX_MATCH_LEN - d->m_lookahead_size);
       const mz_uint8 *pSrc_end = pSrc + num_bytes_to_process;
       src_buf_left -= num_bytes_to_process;
@@ -2001,7 +2359,21 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
       while (pSrc != pSrc_end)
       {
         mz_uint8 c = *pSrc++; d->m_dict[dst_pos] = c; if (dst_pos < (TDEFL_MAX_MATCH_LEN - 1)) d->m_dict[TDEFL_LZ_DICT_SIZE + dst_pos] = c;
-        hash = ((hash << TDEFL_LZ_HASH_SHIFT) ^ c) & (TDEFL_LZ_HASH_SIZE - 1);
+        dst_pos = (dst_pos + 1) & TDEFL_LZ_DICT_SIZE_MASK;
+      }
+    }
+    else if ((d->m_lookahead_size + d->m_dict_size) >= TDEFL_MIN_MATCH_LEN)
+    {
+      mz_uint dst_pos = (d->m_lookahead_pos + d->m_lookahead_size) & TDEFL_LZ_DICT_SIZE_MASK, ins_pos = d->m_lookahead_pos + d->m_lookahead_size - 3;
+      mz_uint32 seq = TDEFL_READ_SEQ3(d->m_dict + (ins_pos & TDEFL_LZ_DICT_SIZE_MASK));
+      mz_uint num_bytes_to_process = (mz_uint)MZ_MIN(src_buf_left, TDEFL_MAX_MATCH_LEN - d->m_lookahead_size);
+      const mz_uint8 *pSrc_end = pSrc + num_bytes_to_process;
+      src_buf_left -= num_bytes_to_process;
+      d->m_lookahead_size += num_bytes_to_process;
+      while (pSrc != pSrc_end)
+      {
+        mz_uint8 c = *pSrc++; mz_uint hash; d->m_dict[dst_pos] = c; if (dst_pos < (TDEFL_MAX_MATCH_LEN - 1)) d->m_dict[TDEFL_LZ_DICT_SIZE + dst_pos] = c;
+        seq = (seq << 8) | c; hash = TDEFL_LZ_HASH4(seq);
         d->m_next[ins_pos & TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mz_uint16)(ins_pos);
         dst_pos = (dst_pos + 1) & TDEFL_LZ_DICT_SIZE_MASK; ins_pos++;
       }
@@ -2016,10 +2388,10 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
         d->m_dict[dst_pos] = c;
         if (dst_pos < (TDEFL_MAX_MATCH_LEN - 1))
           d->m_dict[TDEFL_LZ_DICT_SIZE + dst_pos] = c;
-        if ((++d->m_lookahead_size + d->m_dict_size) >= TDEFL_MIN_MATCH_LEN)
+        if ((++d->m_lookahead_size + d->m_dict_size) > TDEFL_MIN_MATCH_LEN)
         {
-          mz_uint ins_pos = d->m_lookahead_pos + (d->m_lookahead_size - 1) - 2;
-          mz_uint hash = ((d->m_dict[ins_pos & TDEFL_LZ_DICT_SIZE_MASK] << (TDEFL_LZ_HASH_SHIFT * 2)) ^ (d->m_dict[(ins_pos + 1) & TDEFL_LZ_DICT_SIZE_MASK] << TDEFL_LZ_HASH_SHIFT) ^ c) & (TDEFL_LZ_HASH_SIZE - 1);
+          mz_uint ins_pos = d->m_lookahead_pos + (d->m_lookahead_size - 1) - 3;
+          mz_uint hash = TDEFL_LZ_HASH4((TDEFL_READ_SEQ3(d->m_dict + (ins_pos & TDEFL_LZ_DICT_SIZE_MASK)) << 8) | c);
           d->m_next[ins_pos & TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mz_uint16)(ins_pos);
         }
       }
@@ -2039,9 +2411,34 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
         if (cur_match_len < TDEFL_MIN_MATCH_LEN) cur_match_len = 0; else cur_match_dist = 1;
       }
     }
-    else
+    else if (d->m_max_probes[0] > 1)
     {
-      tdefl_find_match(d, d->m_lookahead_pos, d->m_dict_size, d->m_lookahead_size, &cur_match_dist, &cur_match_len);
+      // Only positions with 4 bytes of lookahead are chained, so 3 byte matches come from m_hash3. It only remembers the last occurrence of each
+      // 3 bytes, but 3 byte matches farther than 8KB are dropped below anyway.
+      if ((d->m_lookahead_size > TDEFL_MIN_MATCH_LEN) && (d->m_flags & TDEFL_BT_MATCHES))
+      {
+        mz_uint16 matches[TDEFL_MAX_MATCH_LEN * 2];
+        mz_uint num_matches = tdefl_bt_find_matches(d, d->m_lookahead_pos, d->m_dict_size, d->m_lookahead_size, matches);
+        if ((num_matches) && (matches[num_matches * 2 - 2] > cur_match_len))
+        {
+          cur_match_len = matches[num_matches * 2 - 2]; cur_match_dist = matches[num_matches * 2 - 1];
+        }
+      }
+      else if (d->m_lookahead_size > TDEFL_MIN_MATCH_LEN)
+        tdefl_find_match(d, d->m_lookahead_pos, d->m_dict_size, d->m_lookahead_size, &cur_match_dist, &cur_match_len);
+#if TDEFL_LZ_HASH3_BITS
+      if (d->m_lookahead_size >= TDEFL_MIN_MATCH_LEN)
+      {
+        const mz_uint8 *p = d->m_dict + cur_pos, *q;
+        mz_uint hash = TDEFL_LZ_HASH3(TDEFL_READ_SEQ3(p)), dist = (mz_uint16)(d->m_lookahead_pos - d->m_hash3[hash]);
+        d->m_hash3[hash] = (mz_uint16)d->m_lookahead_pos;
+        if ((cur_match_len < TDEFL_MIN_MATCH_LEN) && (dist) && (dist <= d->m_dict_size) && (dist < 8U*1024U))
+        {
+          q = d->m_dict + ((d->m_lookahead_pos - dist) & TDEFL_LZ_DICT_SIZE_MASK);
+          if ((p[0] == q[0]) && (p[1] == q[1]) && (p[2] == q[2])) { cur_match_len = TDEFL_MIN_MATCH_LEN; cur_match_dist = dist; }
+        }
+      }
+#endif
     }
     if (((cur_match_len == TDEFL_MIN_MATCH_LEN) && (cur_match_dist >= 8U*1024U)) || (cur_pos == cur_match_dist) || ((d->m_flags & TDEFL_FILTER_MATCHES) && (cur_match_len <= 5)))
     {
@@ -2079,11 +2476,22 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
     {
       d->m_saved_lit = d->m_dict[MZ_MIN(cur_pos, sizeof(d->m_dict) - 1)]; d->m_saved_match_dist = cur_match_dist; d->m_saved_match_len = cur_match_len;
     }
-    // Move the lookahead forward by len_to_move bytes.
-    d->m_lookahead_pos += len_to_move;
-    MZ_ASSERT(d->m_lookahead_size >= len_to_move);
-    d->m_lookahead_size -= len_to_move;
-    d->m_dict_size = MZ_MIN(d->m_dict_size + len_to_move, TDEFL_LZ_DICT_SIZE);
+    // The positions skipped over still go into the trees and the 3 byte table (the hash chains already have them).
+    if ((len_to_move > 1) && (d->m_max_probes[0] > 1) && (!(d->m_flags & (TDEFL_RLE_MATCHES | TDEFL_FORCE_ALL_RAW_BLOCKS))))
+    {
+      mz_uint i;
+      for (i = 1; i < len_to_move; i++)
+      {
+        mz_uint ins_pos = d->m_lookahead_pos + i, lookahead_left = d->m_lookahead_size - i;
+        if ((d->m_flags & TDEFL_BT_MATCHES) && (lookahead_left > TDEFL_MIN_MATCH_LEN))
+          tdefl_bt_find_matches(d, ins_pos, d->m_dict_size + i, lookahead_left, NULL);
+#if TDEFL_LZ_HASH3_BITS
+        if (lookahead_left >= TDEFL_MIN_MATCH_LEN)
+          d->m_hash3[TDEFL_LZ_HASH3(TDEFL_READ_SEQ3(d->m_dict + (ins_pos & TDEFL_LZ_DICT_SIZE_MASK)))] = (mz_uint16)ins_pos;
+#endif
+      }
+    }
+    tdefl_move_lookahead(d, len_to_move);
     // Check if it's time to flush the current LZ codes to the internal output buffer.
     if ( (d->m_pLZ_code_buf > &d->m_lz_code_buf[TDEFL_LZ_CODE_BUF_SIZE - 8]) ||
          ( (d->m_total_lz_bytes > 31*1024) && (((((mz_uint)(d->m_pLZ_code_buf - d->m_lz_code_buf) * 115) >> 7) >= d->m_total_lz_bytes) || (d->m_flags & TDEFL_FORCE_ALL_RAW_BLOCKS))) )
@@ -2099,6 +2507,196 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
   return MZ_TRUE;
 }
 
+// The passes tdefl_opt_parse_chunk() makes over each chunk. The first prices symbols with the static codes (or the block's codes so far), each
+// later one with the codes the previous pass's path would get, stopping early once a pass doesn't change the path's symbol counts.
+#ifndef TDEFL_OPT_NUM_PASSES
+#define TDEFL_OPT_NUM_PASSES 4
+#endif
+
+// Costs in bits of the symbols of Huffman table table_num, from the code sizes the block's counts plus pCounts (if not NULL) would get. Symbols
+// that wouldn't get a code cost a bit more than the longest one. Table 2 is scratch space until tdefl_start_dynamic_block() rebuilds it.
+static void tdefl_opt_symbol_costs(tdefl_compressor *d, int table_num, int table_len, const mz_uint32 *pCounts, mz_uint8 *pCosts)
+{
+  int i; mz_uint max_code_size = 0, total = 0;
+  for (i = 0; i < table_len; i++)
+  {
+    mz_uint count = d->m_huff_count[table_num][i] + (pCounts ? pCounts[i] : 0);
+    d->m_huff_count[2][i] = (mz_uint16)MZ_MIN(count, 0xFFFFU); total += count;
+  }
+  if (!total)
+  {
+    // Nothing to go on yet: use the static codes.
+    for (i = 0; i < table_len; i++) pCosts[i] = (mz_uint8)(table_num ? 5 : ((i <= 143) ? 8 : (i <= 255) ? 9 : (i <= 279) ? 7 : 8));
+    return;
+  }
+  tdefl_optimize_huffman_table(d, 2, table_len, 15, MZ_FALSE);
+  for (i = 0; i < table_len; i++) max_code_size = MZ_MAX(max_code_size, d->m_huff_code_sizes[2][i]);
+  for (i = 0; i < table_len; i++) pCosts[i] = (mz_uint8)(d->m_huff_code_sizes[2][i] ? d->m_huff_code_sizes[2][i] : MZ_MIN(max_code_size + 1, 15U));
+}
+
+// Chooses how to code the m_opt_num_pos positions before m_lookahead_pos from the matches cached for each one (m_opt_pos_matches[] pairs each)
+// and records them. Forward dynamic programming finds the cheapest path: m_opt_cost[i] is the fewest bits that reach position i and
+// m_opt_arrival[i] the last step taken (len | dist << 16, len 1 being a literal). Every length from 3 up to each match's is tried at its distance.
+static void tdefl_opt_parse_chunk(tdefl_compressor *d)
+{
+  mz_uint num_pos = d->m_opt_num_pos, start = d->m_lookahead_pos - num_pos, min_len = (d->m_flags & TDEFL_FILTER_MATCHES) ? 6 : TDEFL_MIN_MATCH_LEN;
+  mz_uint num_passes = (d->m_flags & TDEFL_FORCE_ALL_STATIC_BLOCKS) ? 1 : TDEFL_OPT_NUM_PASSES, pass, i, j;
+  mz_uint32 *pCost = d->m_opt_cost, *pArrival = d->m_opt_arrival, len_costs[TDEFL_MAX_MATCH_LEN + 1];
+  mz_uint32 lit_counts[TDEFL_MAX_HUFF_SYMBOLS_0], dist_counts[TDEFL_MAX_HUFF_SYMBOLS_1], prev_counts[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1];
+  mz_uint8 lit_costs[TDEFL_MAX_HUFF_SYMBOLS_0], dist_costs[TDEFL_MAX_HUFF_SYMBOLS_1];
+  MZ_CLEAR_OBJ(lit_counts); MZ_CLEAR_OBJ(dist_counts);
+
+  for (pass = 0; pass < num_passes; pass++)
+  {
+    const mz_uint16 *pMatches = d->m_opt_matches;
+    if ((!pass) && (d->m_flags & TDEFL_FORCE_ALL_STATIC_BLOCKS))
+    {
+      for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_0; i++) lit_costs[i] = (mz_uint8)((i <= 143) ? 8 : (i <= 255) ? 9 : (i <= 279) ? 7 : 8);
+      memset(dist_costs, 5, sizeof(dist_costs));
+    }
+    else
+    {
+      tdefl_opt_symbol_costs(d, 0, TDEFL_MAX_HUFF_SYMBOLS_0, pass ? lit_counts : NULL, lit_costs);
+      tdefl_opt_symbol_costs(d, 1, TDEFL_MAX_HUFF_SYMBOLS_1, pass ? dist_counts : NULL, dist_costs);
+    }
+    for (i = TDEFL_MIN_MATCH_LEN; i <= TDEFL_MAX_MATCH_LEN; i++) len_costs[i] = lit_costs[s_tdefl_len_sym[i - TDEFL_MIN_MATCH_LEN]] + s_tdefl_len_extra[i - TDEFL_MIN_MATCH_LEN];
+
+    pCost[0] = 0; for (i = 1; i <= num_pos; i++) pCost[i] = 0xFFFFFFFFU;
+    for (i = 0; i < num_pos; i++)
+    {
+      mz_uint32 cost = pCost[i] + lit_costs[d->m_dict[(start + i) & TDEFL_LZ_DICT_SIZE_MASK]];
+      mz_uint num_matches = d->m_opt_pos_matches[i], len = min_len, max_len = num_pos - i;
+      if (cost < pCost[i + 1]) { pCost[i + 1] = cost; pArrival[i + 1] = 1; }
+      for (j = 0; j < num_matches; j++, pMatches += 2)
+      {
+        mz_uint match_len = MZ_MIN(pMatches[0], max_len), dist = pMatches[1], d1 = dist - 1;
+        mz_uint32 dist_cost = pCost[i] + ((d1 < 512) ? (dist_costs[s_tdefl_small_dist_sym[d1]] + s_tdefl_small_dist_extra[d1]) : (dist_costs[s_tdefl_large_dist_sym[d1 >> 8]] + s_tdefl_large_dist_extra[d1 >> 8]));
+        for ( ; len <= match_len; len++)
+        {
+          cost = dist_cost + len_costs[len];
+          if (cost < pCost[i + len]) { pCost[i + len] = cost; pArrival[i + len] = len | (dist << 16); }
+        }
+      }
+    }
+
+    // Walk the path back from the end, leaving each step in m_opt_cost[] at the position it starts from (and counting its symbols for the next pass).
+    memcpy(prev_counts, lit_counts, sizeof(lit_counts)); memcpy(prev_counts + TDEFL_MAX_HUFF_SYMBOLS_0, dist_counts, sizeof(dist_counts));
+    memset(lit_counts, 0, sizeof(lit_counts)); memset(dist_counts, 0, sizeof(dist_counts)); lit_counts[256] = 1;
+    for (i = num_pos; i; i -= j)
+    {
+      mz_uint32 step = pArrival[i];
+      j = step & 0xFFFF; pCost[i - j] = step;
+      if (j == 1)
+        lit_counts[d->m_dict[(start + i - 1) & TDEFL_LZ_DICT_SIZE_MASK]]++;
+      else
+      {
+        mz_uint d1 = (step >> 16) - 1;
+        lit_counts[s_tdefl_len_sym[j - TDEFL_MIN_MATCH_LEN]]++; dist_counts[(d1 < 512) ? s_tdefl_small_dist_sym[d1] : s_tdefl_large_dist_sym[d1 >> 8]]++;
+      }
+    }
+    // Another pass with the same costs would find the same path.
+    if ((pass) && (!memcmp(prev_counts, lit_counts, sizeof(lit_counts))) && (!memcmp(prev_counts + TDEFL_MAX_HUFF_SYMBOLS_0, dist_counts, sizeof(dist_counts))))
+      break;
+  }
+
+  for (i = 0; i < num_pos; i += j)
+  {
+    mz_uint32 step = pCost[i];
+    j = step & 0xFFFF;
+    if (j == 1)
+      tdefl_record_literal(d, d->m_dict[(start + i) & TDEFL_LZ_DICT_SIZE_MASK]);
+    else
+      tdefl_record_match(d, j, step >> 16);
+  }
+  d->m_opt_num_pos = d->m_opt_num_matches = 0;
+}
+
+static mz_bool tdefl_compress_optimal(tdefl_compressor *d)
+{
+  const mz_uint8 *pSrc = d->m_pSrc; size_t src_buf_left = d->m_src_buf_left;
+  tdefl_flush flush = d->m_flush;
+  mz_uint nice_len = TDEFL_BT_NICE_LEN(d->m_flags & TDEFL_MAX_PROBES_MASK);
+
+  while ((src_buf_left) || ((flush) && ((d->m_lookahead_size) || (d->m_opt_num_pos))))
+  {
+    // Update the dictionary. Positions go into the binary trees as they're searched.
+    mz_uint dst_pos = (d->m_lookahead_pos + d->m_lookahead_size) & TDEFL_LZ_DICT_SIZE_MASK;
+    mz_uint num_bytes_to_process = (mz_uint)MZ_MIN(src_buf_left, TDEFL_MAX_MATCH_LEN - d->m_lookahead_size);
+    const mz_uint8 *pSrc_end = pSrc + num_bytes_to_process;
+    src_buf_left -= num_bytes_to_process;
+    d->m_lookahead_size += num_bytes_to_process;
+    while (pSrc != pSrc_end)
+    {
+      mz_uint8 c = *pSrc++; d->m_dict[dst_pos] = c; if (dst_pos < (TDEFL_MAX_MATCH_LEN - 1)) d->m_dict[TDEFL_LZ_DICT_SIZE + dst_pos] = c;
+      dst_pos = (dst_pos + 1) & TDEFL_LZ_DICT_SIZE_MASK;
+    }
+    d->m_dict_size = MZ_MIN(TDEFL_LZ_DICT_SIZE - d->m_lookahead_size, d->m_dict_size);
+    if ((!flush) && (d->m_lookahead_size < TDEFL_MAX_MATCH_LEN))
+      break;
+
+    // Cache the matches at the next position.
+    if (d->m_lookahead_size)
+    {
+      mz_uint16 *pMatches = &d->m_opt_matches[d->m_opt_num_matches * 2];
+      mz_uint num_matches = 0, len_to_move = 1, i;
+      if (d->m_lookahead_size > TDEFL_MIN_MATCH_LEN)
+        num_matches = tdefl_bt_find_matches(d, d->m_lookahead_pos, d->m_dict_size, d->m_lookahead_size, pMatches);
+#if TDEFL_LZ_HASH3_BITS
+      if (d->m_lookahead_size >= TDEFL_MIN_MATCH_LEN)
+      {
+        // The trees only hold positions with the same 4 bytes, so a closer 3 byte match goes in front.
+        const mz_uint8 *p = d->m_dict + (d->m_lookahead_pos & TDEFL_LZ_DICT_SIZE_MASK), *q;
+        mz_uint hash = TDEFL_LZ_HASH3(TDEFL_READ_SEQ3(p)), dist = (mz_uint16)(d->m_lookahead_pos - d->m_hash3[hash]);
+        d->m_hash3[hash] = (mz_uint16)d->m_lookahead_pos;
+        q = d->m_dict + ((d->m_lookahead_pos - dist) & TDEFL_LZ_DICT_SIZE_MASK);
+        if ((dist) && (dist <= d->m_dict_size) && ((!num_matches) || (pMatches[1] > dist)) && (p[0] == q[0]) && (p[1] == q[1]) && (p[2] == q[2]))
+        {
+          memmove(pMatches + 2, pMatches, num_matches * 2 * sizeof(mz_uint16));
+          pMatches[0] = TDEFL_MIN_MATCH_LEN; pMatches[1] = (mz_uint16)dist; num_matches++;
+        }
+      }
+#endif
+      d->m_opt_pos_matches[d->m_opt_num_pos] = (mz_uint16)num_matches; d->m_opt_num_matches += num_matches;
+      // Rather than search inside a match of the nice length, take it: the positions it covers only go into the trees (with no matches).
+      if ((num_matches) && (pMatches[num_matches * 2 - 2] >= nice_len))
+      {
+        len_to_move = pMatches[num_matches * 2 - 2];
+        for (i = 1; i < len_to_move; i++)
+        {
+          mz_uint ins_pos = d->m_lookahead_pos + i, lookahead_left = d->m_lookahead_size - i;
+          if (lookahead_left > TDEFL_MIN_MATCH_LEN)
+            tdefl_bt_find_matches(d, ins_pos, d->m_dict_size + i, lookahead_left, NULL);
+#if TDEFL_LZ_HASH3_BITS
+          if (lookahead_left >= TDEFL_MIN_MATCH_LEN)
+            d->m_hash3[TDEFL_LZ_HASH3(TDEFL_READ_SEQ3(d->m_dict + (ins_pos & TDEFL_LZ_DICT_SIZE_MASK)))] = (mz_uint16)ins_pos;
+#endif
+          d->m_opt_pos_matches[d->m_opt_num_pos + i] = 0;
+        }
+      }
+      d->m_opt_num_pos += len_to_move;
+      tdefl_move_lookahead(d, len_to_move);
+    }
+
+    // Parse the chunk once it's full (or the input is flushed), then check if it's time to flush the current LZ codes to the internal output
+    // buffer. There must always be room left for a chunk of literals.
+    if ((d->m_opt_num_pos >= TDEFL_OPT_CHUNK_SIZE) || (d->m_opt_num_matches > TDEFL_OPT_MAX_MATCHES - TDEFL_MAX_MATCH_LEN) || ((flush) && (!d->m_lookahead_size) && (!src_buf_left)))
+    {
+      tdefl_opt_parse_chunk(d);
+      if ( (d->m_pLZ_code_buf > &d->m_lz_code_buf[TDEFL_LZ_CODE_BUF_SIZE - 8 - (TDEFL_OPT_MAX_POS * 9) / 8]) ||
+           ( (d->m_total_lz_bytes > 31*1024) && ((((mz_uint)(d->m_pLZ_code_buf - d->m_lz_code_buf) * 115) >> 7) >= d->m_total_lz_bytes) ) )
+      {
+        int n;
+        d->m_pSrc = pSrc; d->m_src_buf_left = src_buf_left;
+        if ((n = tdefl_flush_block(d, 0)) != 0)
+          return (n < 0) ? MZ_FALSE : MZ_TRUE;
+      }
+    }
+  }
+
+  d->m_pSrc = pSrc; d->m_src_buf_left = src_buf_left;
+  return MZ_TRUE;
+}
+
 static tdefl_status tdefl_flush_output_buffer(tdefl_compressor *d)
 {
   if (d->m_pIn_buf_size)
@@ -2147,13 +2745,16 @@ tdefl_status tdefl_compress(tdefl_compressor *d, const void *pIn_buf, size_t *pI
   if ((d->m_output_flush_remaining) || (d->m_finished))
     return (d->m_prev_return_status = tdefl_flush_output_buffer(d));
 
-  if (((d->m_flags & TDEFL_MAX_PROBES_MASK) == 1) &&
-      ((d->m_flags & TDEFL_GREEDY_PARSING_FLAG) != 0) &&
-      ((d->m_flags & (TDEFL_FILTER_MATCHES | TDEFL_FORCE_ALL_RAW_BLOCKS | TDEFL_RLE_MATCHES)) == 0))
+  if (TDEFL_USES_FAST_PATH(d->m_flags))
   {
     if (!tdefl_compress_fast(d))
       return d->m_prev_return_status;
   }
+  else if (TDEFL_USES_OPTIMAL_PARSING(d->m_flags))
+  {
+    if (!tdefl_compress_optimal(d))
+      return d->m_prev_return_status;
+  }
   else
   {
     if (!tdefl_compress_normal(d))
@@ -2168,7 +2769,7 @@ tdefl_status tdefl_compress(tdefl_compressor *d, const void *pIn_buf, size_t *pI
     if (tdefl_flush_block(d, flush) < 0)
       return d->m_prev_return_status;
     d->m_finished = (flush == TDEFL_FINISH);
-    if (flush == TDEFL_FULL_FLUSH) { MZ_CLEAR_OBJ(d->m_hash); MZ_CLEAR_OBJ(d->m_next); d->m_dict_size = 0; }
+    if (flush == TDEFL_FULL_FLUSH) { MZ_CLEAR_OBJ(d->m_hash); MZ_CLEAR_OBJ(d->m_hash3); MZ_CLEAR_OBJ(d->m_next); d->m_dict_size = 0; }
   }
 
   return (d->m_prev_return_status = tdefl_flush_output_buffer(d));
@@ -2179,20 +2780,27 @@ tdefl_status tdefl_compress_buffer(tdefl_compressor *d, const void *pIn_buf, siz
   MZ_ASSERT(d->m_pPut_buf_func); return tdefl_compress(d, pIn_buf, &in_buf_size, NULL, NULL, flush);
 }
 
+size_t tdefl_compressor_size(int flags)
+{
+  if (flags & TDEFL_OPTIMAL_PARSING) return sizeof(tdefl_compressor);
+  return (flags & TDEFL_BT_MATCHES) ? offsetof(tdefl_compressor, m_opt_pos_matches) : offsetof(tdefl_compressor, m_bt_right);
+}
+
 tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags)
 {
   d->m_pPut_buf_func = pPut_buf_func; d->m_pPut_buf_user = pPut_buf_user;
-  d->m_flags = (mz_uint)(flags); d->m_max_probes[0] = 1 + ((flags & 0xFFF) + 2) / 3; d->m_greedy_parsing = (flags & TDEFL_GREEDY_PARSING_FLAG) != 0;
+  d->m_flags = (mz_uint)(flags) | ((flags & TDEFL_OPTIMAL_PARSING) ? TDEFL_BT_MATCHES : 0); d->m_max_probes[0] = 1 + ((flags & 0xFFF) + 2) / 3; d->m_greedy_parsing = (flags & TDEFL_GREEDY_PARSING_FLAG) != 0;
   d->m_max_probes[1] = 1 + (((flags & 0xFFF) >> 2) + 2) / 3;
-  if (!(flags & TDEFL_NONDETERMINISTIC_PARSING_FLAG)) MZ_CLEAR_OBJ(d->m_hash);
+  if (!(flags & TDEFL_NONDETERMINISTIC_PARSING_FLAG)) { MZ_CLEAR_OBJ(d->m_hash); MZ_CLEAR_OBJ(d->m_hash3); }
   d->m_lookahead_pos = d->m_lookahead_size = d->m_dict_size = d->m_total_lz_bytes = d->m_lz_code_buf_dict_pos = d->m_bits_in = 0;
   d->m_output_flush_ofs = d->m_output_flush_remaining = d->m_finished = d->m_block_index = d->m_bit_buffer = d->m_wants_to_finish = 0;
   d->m_pLZ_code_buf = d->m_lz_code_buf + 1; d->m_pLZ_flags = d->m_lz_code_buf; d->m_num_flags_left = 8;
   d->m_pOutput_buf = d->m_output_buf; d->m_pOutput_buf_end = d->m_output_buf; d->m_prev_return_status = TDEFL_STATUS_OKAY;
-  d->m_saved_match_dist = d->m_saved_match_len = d->m_saved_lit = 0; d->m_adler32 = 1;
+  d->m_saved_match_dist = d->m_saved_match_len = d->m_saved_lit = 0; d->m_adler32 = 1; d->m_opt_num_pos = d->m_opt_num_matches = 0;
   d->m_pIn_buf = NULL; d->m_pOut_buf = NULL;
   d->m_pIn_buf_size = NULL; d->m_pOut_buf_size = NULL;
   d->m_flush = TDEFL_NO_FLUSH; d->m_pSrc = NULL; d->m_src_buf_left = 0; d->m_out_buf_ofs = 0;
+  d->m_preset_dict_adler32 = 0; d->m_has_preset_dict = 0;
   memset(&d->m_huff_count[0][0], 0, sizeof(d->m_huff_count[0][0]) * TDEFL_MAX_HUFF_SYMBOLS_0);
   memset(&d->m_huff_count[1][0], 0, sizeof(d->m_huff_count[1][0]) * TDEFL_MAX_HUFF_SYMBOLS_1);
   return TDEFL_STATUS_OKAY;
@@ -2203,18 +2811,118 @@ tdefl_status tdefl_get_prev_return_status(tdefl_compressor *d)
   return d->m_prev_return_status;
 }
 
+// Copies the dictionary's last dict_len bytes (at most TDEFL_LZ_DICT_SIZE) to the start of pDict_buf and inserts every position into the chains
+// (pHash/pNext, if four bytes follow it) and 3 byte table (pHash3) as tdefl_compress_normal() would have, and/or into the level 1 table (as
+// tdefl_compress_fast() might have).
+static mz_uint tdefl_hash_dictionary(mz_uint8 *pDict_buf, mz_uint16 *pNext, mz_uint16 *pHash, mz_uint16 *pHash3, mz_uint16 *pLevel1_hash, const mz_uint8 *pDictionary, size_t dict_len)
+{
+  mz_uint size = (mz_uint)MZ_MIN(dict_len, (size_t)TDEFL_LZ_DICT_SIZE), i;
+#if !TDEFL_LZ_HASH3_BITS
+  (void)pHash3;
+#endif
+  if (!size) return 0;
+  memcpy(pDict_buf, pDictionary + dict_len - size, size);
+  memcpy(pDict_buf + TDEFL_LZ_DICT_SIZE, pDict_buf, MZ_MIN(size, (mz_uint)(TDEFL_MAX_MATCH_LEN - 1)));
+  for (i = 0; i + 2 < size; i++)
+  {
+    mz_uint32 seq = TDEFL_READ_SEQ3(pDict_buf + i);
+    if ((pHash) && (i + 3 < size))
+    {
+      mz_uint hash = TDEFL_LZ_HASH4((seq << 8) | pDict_buf[i + 3]);
+      pNext[i] = pHash[hash]; pHash[hash] = (mz_uint16)i;
+    }
+#if TDEFL_LZ_HASH3_BITS
+    if (pHash3)
+      pHash3[TDEFL_LZ_HASH3(seq)] = (mz_uint16)i;
+#endif
+    if (pLevel1_hash)
+    {
+      mz_uint trigram = pDict_buf[i] | (pDict_buf[i + 1] << 8) | (pDict_buf[i + 2] << 16);
+      pLevel1_hash[TDEFL_LEVEL1_HASH(trigram)] = (mz_uint16)i;
+    }
+  }
+  return size;
+}
+
+void tdefl_init_dictionary(tdefl_dictionary *pDict, const void *pDictionary, size_t dict_len)
+{
+  MZ_CLEAR_OBJ(pDict->m_hash); MZ_CLEAR_OBJ(pDict->m_hash3); MZ_CLEAR_OBJ(pDict->m_level1_hash);
+  pDict->m_adler32 = (mz_uint)mz_adler32(MZ_ADLER32_INIT, (const mz_uint8 *)pDictionary, dict_len);
+  pDict->m_size = tdefl_hash_dictionary(pDict->m_dict, pDict->m_next, pDict->m_hash, pDict->m_hash3, pDict->m_level1_hash, (const mz_uint8 *)pDictionary, dict_len);
+}
+
+// The dictionary is just history in front of the input: the first input byte goes at position size, as if the dictionary had been compressed already.
+static void tdefl_start_after_dictionary(tdefl_compressor *d, mz_uint size, mz_uint adler32)
+{
+  d->m_lookahead_pos = d->m_dict_size = d->m_lz_code_buf_dict_pos = size;
+  d->m_preset_dict_adler32 = adler32; d->m_has_preset_dict = 1;
+}
+
+static mz_bool tdefl_can_set_dictionary(tdefl_compressor *d)
+{
+  return (d->m_prev_return_status == TDEFL_STATUS_OKAY) && (!d->m_lookahead_pos) && (!d->m_lookahead_size) && (!d->m_block_index) && (!d->m_total_lz_bytes) && (!d->m_wants_to_finish);
+}
+
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDictionary, size_t dict_len)
+{
+  mz_uint size;
+  if ((!d) || ((!pDictionary) && (dict_len)) || (!tdefl_can_set_dictionary(d))) return TDEFL_STATUS_BAD_PARAM;
+  // tdefl_init() already cleared the hash table (unless nondeterministic parsing was asked for, where stale entries are allowed anyway).
+  if (TDEFL_USES_FAST_PATH(d->m_flags))
+    size = tdefl_hash_dictionary(d->m_dict, NULL, NULL, NULL, d->m_hash, (const mz_uint8 *)pDictionary, dict_len);
+  else if (d->m_flags & TDEFL_BT_MATCHES)
+  {
+    size = tdefl_hash_dictionary(d->m_dict, NULL, NULL, d->m_hash3, NULL, (const mz_uint8 *)pDictionary, dict_len);
+    tdefl_bt_hash_dictionary(d, size);
+  }
+  else
+    size = tdefl_hash_dictionary(d->m_dict, d->m_next, d->m_hash, d->m_hash3, NULL, (const mz_uint8 *)pDictionary, dict_len);
+  tdefl_start_after_dictionary(d, size, (mz_uint)mz_adler32(MZ_ADLER32_INIT, (const mz_uint8 *)pDictionary, dict_len));
+  return TDEFL_STATUS_OKAY;
+}
+
+tdefl_status tdefl_set_shared_dictionary(tdefl_compressor *d, const tdefl_dictionary *pDict)
+{
+  if ((!d) || (!pDict) || (!tdefl_can_set_dictionary(d))) return TDEFL_STATUS_BAD_PARAM;
+  memcpy(d->m_dict, pDict->m_dict, pDict->m_size);
+  memcpy(d->m_dict + TDEFL_LZ_DICT_SIZE, pDict->m_dict + TDEFL_LZ_DICT_SIZE, MZ_MIN(pDict->m_size, (mz_uint)(TDEFL_MAX_MATCH_LEN - 1)));
+  if (TDEFL_USES_FAST_PATH(d->m_flags))
+    memcpy(d->m_hash, pDict->m_level1_hash, sizeof(pDict->m_level1_hash));
+  else if (d->m_flags & TDEFL_BT_MATCHES)
+  {
+    // The trees depend on the search depth, so they're built here rather than shared.
+    memcpy(d->m_hash3, pDict->m_hash3, sizeof(d->m_hash3));
+    tdefl_bt_hash_dictionary(d, pDict->m_size);
+  }
+  else
+  {
+    memcpy(d->m_hash, pDict->m_hash, sizeof(d->m_hash));
+    memcpy(d->m_hash3, pDict->m_hash3, sizeof(d->m_hash3));
+    memcpy(d->m_next, pDict->m_next, pDict->m_size * sizeof(d->m_next[0]));
+  }
+  tdefl_start_after_dictionary(d, pDict->m_size, pDict->m_adler32);
+  return TDEFL_STATUS_OKAY;
+}
+
 mz_uint32 tdefl_get_adler32(tdefl_compressor *d)
 {
   return d->m_adler32;
 }
 
 mz_bool tdefl_compress_mem_to_output(const void *pBuf, size_t buf_len, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags)
+{
+  return tdefl_compress_mem_to_output_ex(pBuf, buf_len, pPut_buf_func, pPut_buf_user, flags, NULL, NULL, NULL);
+}
+
+mz_bool tdefl_compress_mem_to_output_ex(const void *pBuf, size_t buf_len, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags, mz_alloc_func pAlloc, mz_free_func pFree, void *pAlloc_opaque)
 {
   tdefl_compressor *pComp; mz_bool succeeded; if (((buf_len) && (!pBuf)) || (!pPut_buf_func)) return MZ_FALSE;
-  pComp = (tdefl_compressor*)MZ_MALLOC(sizeof(tdefl_compressor)); if (!pComp) return MZ_FALSE;
+  if (!pAlloc) pAlloc = def_alloc_func;
+  if (!pFree) pFree = def_free_func;
+  pComp = (tdefl_compressor*)pAlloc(pAlloc_opaque, 1, tdefl_compressor_size(flags)); if (!pComp) return MZ_FALSE;
   succeeded = (tdefl_init(pComp, pPut_buf_func, pPut_buf_user, flags) == TDEFL_STATUS_OKAY);
   succeeded = succeeded && (tdefl_compress_buffer(pComp, pBuf, buf_len, TDEFL_FINISH) == TDEFL_STATUS_DONE);
-  MZ_FREE(pComp); return succeeded;
+  pFree(pAlloc_opaque, pComp); return succeeded;
 }
 
 typedef struct
@@ -2249,21 +2957,27 @@ void *tdefl_compress_mem_to_heap(const void *pSrc_buf, size_t src_buf_len, size_
 }
 
 size_t tdefl_compress_mem_to_mem(void *pOut_buf, size_t out_buf_len, const void *pSrc_buf, size_t src_buf_len, int flags)
+{
+  return tdefl_compress_mem_to_mem_ex(pOut_buf, out_buf_len, pSrc_buf, src_buf_len, flags, NULL, NULL, NULL);
+}
+
+size_t tdefl_compress_mem_to_mem_ex(void *pOut_buf, size_t out_buf_len, const void *pSrc_buf, size_t src_buf_len, int flags, mz_alloc_func pAlloc, mz_free_func pFree, void *pAlloc_opaque)
 {
   tdefl_output_buffer out_buf; MZ_CLEAR_OBJ(out_buf);
   if (!pOut_buf) return 0;
   out_buf.m_pBuf = (mz_uint8*)pOut_buf; out_buf.m_capacity = out_buf_len;
-  if (!tdefl_compress_mem_to_output(pSrc_buf, src_buf_len, tdefl_output_buffer_putter, &out_buf, flags)) return 0;
+  if (!tdefl_compress_mem_to_output_ex(pSrc_buf, src_buf_len, tdefl_output_buffer_putter, &out_buf, flags, pAlloc, pFree, pAlloc_opaque)) return 0;
   return out_buf.m_size;
 }
 
 
-static const mz_uint s_tdefl_num_probes[11] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500 };
+static const mz_uint s_tdefl_num_probes[12] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500, 64 };
 
 // level may actually range from [0,10] (10 is a "hidden" max level, where we want a bit more compression and it's fine if throughput to fall off a cliff on some files).
+// Levels 11 and up parse optimally, the probe count being the depth of the binary tree searches.
 mz_uint tdefl_create_comp_flags_from_zip_params(int level, int window_bits, int strategy)
 {
-  mz_uint comp_flags = s_tdefl_num_probes[(level >= 0) ? MZ_MIN(10, level) : MZ_DEFAULT_LEVEL] | ((level <= 3) ? TDEFL_GREEDY_PARSING_FLAG : 0);
+  mz_uint comp_flags = s_tdefl_num_probes[(level >= 0) ? MZ_MIN(11, level) : MZ_DEFAULT_LEVEL] | ((level <= 3) ? TDEFL_GREEDY_PARSING_FLAG : 0) | ((level >= 11) ? TDEFL_OPTIMAL_PARSING : 0);
   if (window_bits > 0) comp_flags |= TDEFL_WRITE_ZLIB_HEADER;
 
   if (!level) comp_flags |= TDEFL_FORCE_ALL_RAW_BLOCKS;
@@ -0,0 +1,458 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "miniz.h"
+#include "miniminiz.h"
+typedef unsigned char uint8;
+typedef unsigned int uint;
+typedef std::vector<uint8> bytes;
+static int s_num_failed;
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); s_num_failed++; return; } } while (0)
+static uint s_seed = 1;
+static uint rnd() { s_seed = s_seed * 1103515245U + 12345U; return s_seed >> 8; }
+// Text like data with some random bytes, runs and far repeats mixed in.
+static bytes make_data(size_t len, uint seed) {
+    static const char *s_words[] = { "Good ", "morning ", "Dr. ", "Chandra. ", "This ", "is ", "Hal. ", "I ", "am ", "ready ", "for ", "my ", "first ", "lesson. " };
+    bytes data;
+    s_seed = seed;
+    while (data.size() < len) {
+        uint kind = rnd() % 16, i, n;
+        if (kind < 10) {
+            const char *p = s_words[rnd() % 14];
+            data.insert(data.end(), p, p + strlen(p));
+        } else if (kind < 12) {
+            for (i = 0, n = rnd() % 64; i < n; i++) data.push_back((uint8)rnd());
+        } else if (kind < 14) {
+            data.insert(data.end(), rnd() % 300, (uint8)rnd());
+        } else if (data.size() > 1000) {
+            size_t from = rnd() % (data.size() - 500);
+            for (i = 0, n = 3 + rnd() % 400; i < n; i++) data.push_back(data[from + i]);
+        }
+    }
+    data.resize(len);
+    return data;
+}
+static bytes compress(const bytes &src, int level, int window_bits) {
+    mz_stream stream;
+    bytes out(mz_compressBound((mz_ulong)src.size()) + 64);
+    memset(&stream, 0, sizeof(stream));
+    if (mz_deflateInit2(&stream, level, MZ_DEFLATED, window_bits, 9, MZ_DEFAULT_STRATEGY) != MZ_OK) return bytes();
+    stream.next_in = src.data(); stream.avail_in = (uint)src.size();
+    stream.next_out = out.data(); stream.avail_out = (uint)out.size();
+    if (mz_deflate(&stream, MZ_FINISH) != MZ_STREAM_END) out.clear(); else out.resize(stream.total_out);
+    mz_deflateEnd(&stream);
+    return out;
+}
+static bytes make_gzip(const bytes &src) {
+    static const uint8 s_header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3 };
+    bytes raw = compress(src, 6, -15), out(s_header, s_header + 10);
+    mz_ulong crc = mz_crc32(MZ_CRC32_INIT, src.data(), src.size());
+    uint i;
+    out.insert(out.end(), raw.begin(), raw.end());
+    for (i = 0; i < 4; i++) out.push_back((uint8)(crc >> (i * 8)));
+    for (i = 0; i < 4; i++) out.push_back((uint8)(src.size() >> (i * 8)));
+    return out;
+}
+// Inflates all of src into a buffer of dest_len bytes, feeding at most max_in bytes and making room for at most max_out bytes per call.
+static int inflate_chunked(const bytes &src, bytes &dest, size_t dest_len, int window_bits, int options, uint max_in, uint max_out) {
+    mmz_stream stream;
+    int status = MMZ_OK, calls;
+    memset(&stream, 0, sizeof(stream));
+    dest.assign(dest_len, 0);
+    if (mmz_inflateInit2(&stream, window_bits) != MMZ_OK) return MMZ_STREAM_ERROR;
+    mmz_inflateSetOptions(&stream, options);
+    for (calls = 0; calls < 1000000; calls++) {
+        // MMZ_MIN() evaluates its arguments twice, so draw the chunk sizes first.
+        size_t in_left = src.size() - stream.total_in, out_left = dest_len - stream.total_out, in_chunk = 1 + rnd() % max_in, out_chunk = 1 + rnd() % max_out;
+        stream.next_in = src.data() + stream.total_in; stream.avail_in = (uint)MMZ_MIN(in_left, in_chunk);
+        stream.next_out = dest.data() + stream.total_out; stream.avail_out = (uint)MMZ_MIN(out_left, out_chunk);
+        status = mmz_inflate(&stream, MMZ_NO_FLUSH);
+        if ((status == MMZ_STREAM_END) && (stream.total_in == src.size())) break;
+        if ((status != MMZ_OK) && (status != MMZ_STREAM_END)) break;
+    }
+    dest.resize(stream.total_out);
+    mmz_inflateEnd(&stream);
+    return status;
+}
+static size_t read_mem(void *pUser, mmz_uint64 ofs, void *pBuf, size_t len) {
+    const bytes *pSrc = (const bytes *)pUser;
+    if (ofs >= pSrc->size()) return 0;
+    len = MMZ_MIN(len, (size_t)(pSrc->size() - ofs));
+    memcpy(pBuf, pSrc->data() + ofs, len);
+    return len;
+}
+
+static void test_uncompress_levels() {
+    bytes data = make_data(300000, 1), dest(data.size());
+    int level;
+    for (level = 0; level <= 11; level++) {
+        bytes comp = compress(data, level, MZ_DEFAULT_WINDOW_BITS);
+        mmz_ulong dest_len = (mmz_ulong)dest.size();
+        CHECK(comp.size());
+        CHECK(mmz_uncompress(dest.data(), &dest_len, comp.data(), (mmz_ulong)comp.size()) == MMZ_OK);
+        CHECK((dest_len == data.size()) && (dest == data));
+    }
+}
+static void test_fixed_blocks() {
+    bytes data = make_data(100000, 2), comp(mz_compressBound((mz_ulong)data.size())), dest(data.size());
+    mz_stream stream;
+    mmz_ulong dest_len = (mmz_ulong)dest.size();
+    memset(&stream, 0, sizeof(stream));
+    CHECK(mz_deflateInit2(&stream, 6, MZ_DEFLATED, MZ_DEFAULT_WINDOW_BITS, 9, MZ_FIXED) == MZ_OK);
+    stream.next_in = data.data(); stream.avail_in = (uint)data.size(); stream.next_out = comp.data(); stream.avail_out = (uint)comp.size();
+    CHECK(mz_deflate(&stream, MZ_FINISH) == MZ_STREAM_END);
+    comp.resize(stream.total_out); mz_deflateEnd(&stream);
+    CHECK(mmz_uncompress(dest.data(), &dest_len, comp.data(), (mmz_ulong)comp.size()) == MMZ_OK);
+    CHECK(dest == data);
+}
+static void test_streaming_random_chunks() {
+    bytes data = make_data(200000, 3), comp = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), dest;
+    uint seed;
+    for (seed = 1; seed <= 20; seed++) {
+        s_seed = seed;
+        CHECK(inflate_chunked(comp, dest, data.size(), MMZ_DEFAULT_WINDOW_BITS, 0, 777, 4096) == MMZ_STREAM_END);
+        CHECK(dest == data);
+        CHECK(inflate_chunked(comp, dest, data.size(), MMZ_DEFAULT_WINDOW_BITS, MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT, 777, 4096) == MMZ_STREAM_END);
+        CHECK(dest == data);
+    }
+}
+static void test_reset() {
+    bytes data = make_data(50000, 4), zlib = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), raw = compress(data, 6, -MZ_DEFAULT_WINDOW_BITS), dest(data.size());
+    mmz_stream stream;
+    int i;
+    memset(&stream, 0, sizeof(stream));
+    CHECK(mmz_inflateInit(&stream) == MMZ_OK);
+    for (i = 0; i < 3; i++) {
+        const bytes &src = (i == 2) ? raw : zlib;
+        if (i == 1) CHECK(mmz_inflateReset(&stream) == MMZ_OK);
+        if (i == 2) CHECK(mmz_inflateReset2(&stream, -MMZ_DEFAULT_WINDOW_BITS) == MMZ_OK);
+        stream.next_in = src.data(); stream.avail_in = (uint)src.size(); stream.next_out = dest.data(); stream.avail_out = (uint)dest.size();
+        CHECK(mmz_inflate(&stream, MMZ_FINISH) == MMZ_STREAM_END);
+        CHECK((stream.total_out == data.size()) && (dest == data));
+    }
+    CHECK(mmz_inflateEnd(&stream) == MMZ_OK);
+    // Pooled states are reused by the next init and can be released.
+    for (i = 0; i < 20; i++) { CHECK(mmz_inflateInit(&stream) == MMZ_OK); CHECK(mmz_inflateEnd(&stream) == MMZ_OK); }
+    mmz_inflate_pool_release();
+}
+static void test_window_bits() {
+    bytes data = make_data(50000, 5), zlib = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), raw = compress(data, 6, -MZ_DEFAULT_WINDOW_BITS), dest(data.size());
+    mmz_ulong dest_len = (mmz_ulong)dest.size(), src_len = (mmz_ulong)zlib.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, zlib.data(), &src_len, 0, 0) == MMZ_OK);
+    CHECK((dest_len == data.size()) && (src_len == zlib.size()) && (dest == data));
+    // The header asks for a 32 KB window.
+    dest_len = (mmz_ulong)dest.size(); src_len = (mmz_ulong)zlib.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, zlib.data(), &src_len, 9, 0) == MMZ_DATA_ERROR);
+    dest_len = (mmz_ulong)dest.size(); src_len = (mmz_ulong)zlib.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, zlib.data(), &src_len, 9, MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT) == MMZ_DATA_ERROR);
+    // A raw stream has no header to check, so its matches farther back than 512 bytes fail instead.
+    s_seed = 5;
+    CHECK(inflate_chunked(raw, dest, data.size(), -9, 0, 777, 4096) == MMZ_DATA_ERROR);
+    CHECK(inflate_chunked(raw, dest, data.size(), -9, MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT, 777, 4096) == MMZ_DATA_ERROR);
+}
+static void test_gzip() {
+    bytes data = make_data(80000, 6), gz = make_gzip(data), zlib = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), dest(data.size());
+    mmz_ulong dest_len = (mmz_ulong)dest.size(), src_len = (mmz_ulong)gz.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, gz.data(), &src_len, 16 + MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_OK);
+    CHECK(dest == data);
+    dest_len = (mmz_ulong)dest.size(); src_len = (mmz_ulong)gz.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, gz.data(), &src_len, 32 + MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_OK);
+    CHECK(dest == data);
+    dest_len = (mmz_ulong)dest.size(); src_len = (mmz_ulong)zlib.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, zlib.data(), &src_len, 32 + MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_OK);
+    CHECK(dest == data);
+    // A bad CRC-32.
+    gz[gz.size() - 8] ^= 1;
+    dest_len = (mmz_ulong)dest.size(); src_len = (mmz_ulong)gz.size();
+    CHECK(mmz_uncompress2(dest.data(), &dest_len, gz.data(), &src_len, 16 + MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_DATA_ERROR);
+}
+static void test_multi_member() {
+    bytes a = make_data(70000, 7), b = make_data(50000, 8), comp = compress(a, 6, MZ_DEFAULT_WINDOW_BITS), comp_b = compress(b, 9, MZ_DEFAULT_WINDOW_BITS), both = a, dest;
+    uint seed;
+    comp.insert(comp.end(), comp_b.begin(), comp_b.end()); both.insert(both.end(), b.begin(), b.end());
+    // Streaming with the bit buffer reading ahead into the second member at arbitrary call boundaries.
+    for (seed = 1; seed <= 40; seed++) {
+        s_seed = seed;
+        CHECK(inflate_chunked(comp, dest, both.size(), MMZ_DEFAULT_WINDOW_BITS, MMZ_INFLATE_OPT_MULTI_MEMBER | MMZ_INFLATE_OPT_CONTIGUOUS_OUTPUT, 777, 4096) == MMZ_STREAM_END);
+        CHECK(dest == both);
+        CHECK(inflate_chunked(comp, dest, both.size(), MMZ_DEFAULT_WINDOW_BITS, MMZ_INFLATE_OPT_MULTI_MEMBER, 777, 4096) == MMZ_STREAM_END);
+        CHECK(dest == both);
+    }
+    {
+        mmz_ulong dest_len = (mmz_ulong)both.size(), src_len = (mmz_ulong)comp.size();
+        dest.assign(both.size(), 0);
+        CHECK(mmz_uncompress2(dest.data(), &dest_len, comp.data(), &src_len, MMZ_DEFAULT_WINDOW_BITS, MMZ_INFLATE_OPT_MULTI_MEMBER) == MMZ_OK);
+        CHECK((dest_len == both.size()) && (src_len == comp.size()) && (dest == both));
+        // Without the option only the first member is decoded.
+        dest_len = (mmz_ulong)both.size(); src_len = (mmz_ulong)comp.size();
+        CHECK(mmz_uncompress2(dest.data(), &dest_len, comp.data(), &src_len, MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_OK);
+        CHECK((dest_len == a.size()) && (src_len == comp.size() - comp_b.size()));
+    }
+}
+static void test_skip_validate() {
+    bytes data = make_data(120000, 9), comp = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), dest(data.size());
+    mmz_ulong dest_len = 0, src_len = (mmz_ulong)comp.size(), skip = 50001;
+    mmz_stream stream;
+    int status = MMZ_OK, calls;
+    CHECK(mmz_validate(&dest_len, comp.data(), &src_len, MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_OK);
+    CHECK((dest_len == data.size()) && (src_len == comp.size()));
+    memset(&stream, 0, sizeof(stream));
+    CHECK(mmz_inflateInit(&stream) == MMZ_OK);
+    stream.next_in = comp.data(); stream.avail_in = (uint)comp.size();
+    CHECK(mmz_inflateSkip(&stream, &skip, MMZ_NO_FLUSH) == MMZ_OK);
+    CHECK((!skip) && (stream.total_out == 50001));
+    stream.next_out = dest.data(); stream.avail_out = (uint)dest.size();
+    // Like miniz, the first call only drains what the skip left in the dictionary.
+    for (calls = 0; (calls < 10) && ((status = mmz_inflate(&stream, MMZ_FINISH)) == MMZ_OK); calls++) { }
+    CHECK(status == MMZ_STREAM_END);
+    CHECK((stream.total_out == data.size()) && (!memcmp(dest.data(), data.data() + 50001, data.size() - 50001)));
+    mmz_inflateEnd(&stream);
+    // A bad Adler-32 is still caught.
+    comp.back() ^= 1;
+    src_len = (mmz_ulong)comp.size();
+    CHECK(mmz_validate(&dest_len, comp.data(), &src_len, MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_DATA_ERROR);
+}
+static void test_index() {
+    bytes data = make_data(1000000, 10), comp = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), dest(70000);
+    mmz_index *pIndex = NULL, *pCopy = NULL;
+    unsigned char *pBuf = NULL; size_t buf_len = 0;
+    static const size_t s_ofs[] = { 0, 1, 65535, 300001, 999000 };
+    size_t i;
+    CHECK(mmz_index_build(&pIndex, read_mem, &comp, MMZ_DEFAULT_WINDOW_BITS, 100000) == MMZ_OK);
+    CHECK((pIndex->m_num_points > 2) && (pIndex->m_total_out == data.size()));
+    CHECK(mmz_index_serialize(pIndex, &pBuf, &buf_len) == MMZ_OK);
+    CHECK(mmz_index_deserialize(&pCopy, pBuf, buf_len) == MMZ_OK);
+    mmz_free(pBuf);
+    for (i = 0; i < sizeof(s_ofs) / sizeof(s_ofs[0]); i++) {
+        size_t dest_len = dest.size(), expect = MMZ_MIN(dest.size(), data.size() - s_ofs[i]);
+        CHECK(mmz_index_extract(pCopy, read_mem, &comp, s_ofs[i], dest.data(), &dest_len) == MMZ_OK);
+        CHECK((dest_len == expect) && (!memcmp(dest.data(), data.data() + s_ofs[i], expect)));
+    }
+    mmz_index_free(pIndex); mmz_index_free(pCopy);
+}
+static void test_parallel() {
+    bytes data = make_data(4000000, 11), comp = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), raw = compress(data, 6, -MZ_DEFAULT_WINDOW_BITS), dest(data.size());
+    size_t dest_len = dest.size(), src_len = comp.size();
+    CHECK(mmz_uncompress_parallel(dest.data(), &dest_len, comp.data(), &src_len, MMZ_DEFAULT_WINDOW_BITS, 4) == MMZ_OK);
+    CHECK((dest_len == data.size()) && (src_len == comp.size()) && (dest == data));
+    dest_len = dest.size(); src_len = raw.size();
+    CHECK(mmz_uncompress_parallel(dest.data(), &dest_len, raw.data(), &src_len, -MMZ_DEFAULT_WINDOW_BITS, 4) == MMZ_OK);
+    CHECK(dest == data);
+    // The stream has matches farther back than a 512 byte window allows, in every chunk.
+    dest_len = dest.size(); src_len = raw.size();
+    CHECK(mmz_uncompress_parallel(dest.data(), &dest_len, raw.data(), &src_len, -9, 4) == MMZ_DATA_ERROR);
+    // Parallel compression still writes one zlib stream.
+    comp.assign(mmz_compressBound((mmz_ulong)data.size()), 0);
+    dest_len = comp.size();
+    CHECK(mmz_compress_parallel(comp.data(), &dest_len, data.data(), data.size(), 6, 4) == MMZ_OK);
+    comp.resize(dest_len);
+    {
+        mmz_ulong out_len = (mmz_ulong)dest.size();
+        CHECK(mmz_uncompress(dest.data(), &out_len, comp.data(), (mmz_ulong)comp.size()) == MMZ_OK);
+        CHECK((out_len == data.size()) && (dest == data));
+    }
+}
+static void test_batch() {
+    std::vector<bytes> src, comp, dest;
+    std::vector<mmz_batch_item> items(100);
+    size_t i;
+    for (i = 0; i < items.size(); i++) {
+        src.push_back(make_data(1 + (i * 997) % 20000, (uint)i));
+        comp.push_back(bytes(mmz_compressBound((mmz_ulong)src[i].size())));
+        items[i].m_pSource = src[i].data(); items[i].m_source_len = src[i].size(); items[i].m_pDest = comp[i].data(); items[i].m_dest_len = comp[i].size();
+    }
+    CHECK(mmz_compress_batch(items.data(), items.size(), 6, 4) == MMZ_OK);
+    for (i = 0; i < items.size(); i++) {
+        dest.push_back(bytes(src[i].size()));
+        items[i].m_pSource = comp[i].data(); items[i].m_source_len = items[i].m_dest_len; items[i].m_pDest = dest[i].data(); items[i].m_dest_len = dest[i].size();
+    }
+    CHECK(mmz_uncompress_batch(items.data(), items.size(), MMZ_DEFAULT_WINDOW_BITS, 4) == MMZ_OK);
+    for (i = 0; i < items.size(); i++) CHECK((items[i].m_status == MMZ_OK) && (dest[i] == src[i]));
+}
+static void test_dictionary() {
+    bytes dict = make_data(30000, 12), data = make_data(20000, 12), comp(mz_compressBound((mz_ulong)data.size())), dest(data.size());
+    int window_bits;
+    for (window_bits = -MZ_DEFAULT_WINDOW_BITS; window_bits <= MZ_DEFAULT_WINDOW_BITS; window_bits += 2 * MZ_DEFAULT_WINDOW_BITS) {
+        mz_stream stream;
+        mmz_stream inf;
+        int status;
+        memset(&stream, 0, sizeof(stream));
+        CHECK(mz_deflateInit2(&stream, 6, MZ_DEFLATED, window_bits, 9, MZ_DEFAULT_STRATEGY) == MZ_OK);
+        CHECK(mz_deflateSetDictionary(&stream, dict.data(), (uint)dict.size()) == MZ_OK);
+        stream.next_in = data.data(); stream.avail_in = (uint)data.size(); stream.next_out = comp.data(); stream.avail_out = (uint)comp.size();
+        CHECK(mz_deflate(&stream, MZ_FINISH) == MZ_STREAM_END);
+        mz_deflateEnd(&stream);
+        // The data is all in the dictionary, so it should be all long matches.
+        CHECK(stream.total_out < 1000);
+        memset(&inf, 0, sizeof(inf));
+        CHECK(mmz_inflateInit2(&inf, window_bits) == MMZ_OK);
+        if (window_bits < 0) CHECK(mmz_inflateSetDictionary(&inf, dict.data(), (uint)dict.size()) == MMZ_OK);
+        inf.next_in = comp.data(); inf.avail_in = (uint)stream.total_out; inf.next_out = dest.data(); inf.avail_out = (uint)dest.size();
+        status = mmz_inflate(&inf, MMZ_FINISH);
+        if (window_bits > 0) {
+            CHECK(status == MMZ_NEED_DICT);
+            CHECK(mmz_inflateSetDictionary(&inf, dict.data(), (uint)dict.size() - 1) == MMZ_DATA_ERROR);
+            CHECK(mmz_inflateSetDictionary(&inf, dict.data(), (uint)dict.size()) == MMZ_OK);
+            status = mmz_inflate(&inf, MMZ_FINISH);
+        }
+        CHECK((status == MMZ_STREAM_END) && (inf.total_out == data.size()) && (dest == data));
+        mmz_inflateEnd(&inf);
+    }
+}
+static void test_mmz_deflate() {
+    bytes data = make_data(300000, 13), comp(mmz_compressBound((mmz_ulong)data.size())), dest(data.size());
+    int level;
+    for (level = 0; level <= 10; level++) {
+        mmz_ulong comp_len = (mmz_ulong)comp.size();
+        mz_ulong dest_len = (mz_ulong)dest.size();
+        CHECK(mmz_compress2(comp.data(), &comp_len, data.data(), (mmz_ulong)data.size(), level) == MMZ_OK);
+        CHECK(mz_uncompress(dest.data(), &dest_len, comp.data(), comp_len) == MZ_OK);
+        CHECK((dest_len == data.size()) && (dest == data));
+    }
+    // Streaming in small pieces with a sync flush in the middle.
+    {
+        mmz_stream stream;
+        mmz_ulong dest_len = (mmz_ulong)dest.size();
+        int status, synced = 0, calls;
+        memset(&stream, 0, sizeof(stream));
+        CHECK(mmz_deflateInit(&stream, 6) == MMZ_OK);
+        s_seed = 14;
+        for (calls = 0; calls < 1000000; calls++) {
+            size_t limit = synced ? data.size() : (data.size() / 2);
+            size_t in_chunk = 1 + rnd() % 5000, out_chunk = 1 + rnd() % 3000;
+            int flush = (stream.total_in < limit) ? MMZ_NO_FLUSH : synced ? MMZ_FINISH : MMZ_SYNC_FLUSH;
+            stream.next_in = data.data() + stream.total_in; stream.avail_in = (uint)MMZ_MIN(limit - stream.total_in, in_chunk);
+            stream.next_out = comp.data() + stream.total_out; stream.avail_out = (uint)MMZ_MIN(comp.size() - stream.total_out, out_chunk);
+            status = mmz_deflate(&stream, flush);
+            if ((status != MMZ_OK) && (status != MMZ_BUF_ERROR)) break;
+            // A sync flush is complete once it returns with output space left.
+            if ((flush == MMZ_SYNC_FLUSH) && (stream.avail_out)) synced = 1;
+        }
+        CHECK(status == MMZ_STREAM_END);
+        CHECK(mmz_uncompress(dest.data(), &dest_len, comp.data(), stream.total_out) == MMZ_OK);
+        CHECK((dest_len == data.size()) && (dest == data));
+        mmz_deflateEnd(&stream);
+    }
+}
+static void test_bt_and_optimal() {
+    bytes data = make_data(200000, 15), dest(data.size());
+    static const int s_flags[] = { 128 | TDEFL_BT_MATCHES, 1500 | TDEFL_BT_MATCHES | TDEFL_WRITE_ZLIB_HEADER, 64 | TDEFL_OPTIMAL_PARSING, 64 | TDEFL_OPTIMAL_PARSING | TDEFL_WRITE_ZLIB_HEADER };
+    size_t i, level9_len = compress(data, 9, MZ_DEFAULT_WINDOW_BITS).size();
+    CHECK(tdefl_compressor_size(0) < tdefl_compressor_size(TDEFL_BT_MATCHES));
+    CHECK(tdefl_compressor_size(TDEFL_BT_MATCHES) < tdefl_compressor_size(TDEFL_OPTIMAL_PARSING));
+    CHECK(tdefl_compressor_size(TDEFL_OPTIMAL_PARSING) == sizeof(tdefl_compressor));
+    for (i = 0; i < sizeof(s_flags) / sizeof(s_flags[0]); i++) {
+        size_t comp_len = 0, dest_len;
+        void *pComp = tdefl_compress_mem_to_heap(data.data(), data.size(), &comp_len, s_flags[i]);
+        CHECK(pComp);
+        dest_len = tinfl_decompress_mem_to_mem(dest.data(), dest.size(), pComp, comp_len, (s_flags[i] & TDEFL_WRITE_ZLIB_HEADER) ? TINFL_FLAG_PARSE_ZLIB_HEADER : 0);
+        free(pComp);
+        CHECK((dest_len == data.size()) && (dest == data));
+    }
+    // Level 11 parses optimally; it should never do much worse than level 9.
+    {
+        bytes comp = compress(data, MZ_OPTIMAL_COMPRESSION, MZ_DEFAULT_WINDOW_BITS);
+        mmz_ulong dest_len = (mmz_ulong)dest.size();
+        CHECK(comp.size() && (comp.size() <= level9_len + level9_len / 100));
+        CHECK(mmz_uncompress(dest.data(), &dest_len, comp.data(), (mmz_ulong)comp.size()) == MMZ_OK);
+        CHECK(dest == data);
+    }
+}
+static void test_arena() {
+    bytes data = make_data(30000, 16), arena_buf(1 << 20);
+    mz_arena arena;
+    mz_stream stream;
+    bytes comp(mz_compressBound((mz_ulong)data.size()));
+    mz_arena_init(&arena, arena_buf.data(), arena_buf.size());
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = mz_arena_alloc_func; stream.zfree = mz_arena_free_func; stream.opaque = &arena;
+    CHECK(mz_deflateInit(&stream, 6) == MZ_OK);
+    CHECK(arena.m_ofs <= tdefl_compressor_size(0) + 16);
+    stream.next_in = data.data(); stream.avail_in = (uint)data.size(); stream.next_out = comp.data(); stream.avail_out = (uint)comp.size();
+    CHECK(mz_deflate(&stream, MZ_FINISH) == MZ_STREAM_END);
+    mz_deflateEnd(&stream);
+    mz_arena_reset(&arena);
+    CHECK(!arena.m_ofs);
+    // Too small for a compressor.
+    mz_arena_init(&arena, arena_buf.data(), 1000);
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = mz_arena_alloc_func; stream.zfree = mz_arena_free_func; stream.opaque = &arena;
+    CHECK(mz_deflateInit(&stream, 6) == MZ_MEM_ERROR);
+}
+static void test_adler32() {
+    bytes data = make_data(100000, 17);
+    size_t i;
+    for (i = 0; i < 200; i++) {
+        size_t ofs = rnd() % 64, len = (i < 100) ? i : (rnd() % (data.size() - 64));
+        mz_ulong s1 = 1 + i, s2 = 0, j;
+        for (j = 0; j < len; j++) { s1 = (s1 + data[ofs + j]) % 65521; s2 = (s2 + s1) % 65521; }
+        CHECK(mz_adler32(1 + i, data.data() + ofs, len) == ((s2 << 16) | s1));
+    }
+}
+static void test_corrupt_input() {
+    // An incomplete lit/len code whose unused codes the stream then uses: it must fail, not loop on zero bit literals.
+    static const uint8 s_incomplete[9] = { 0x48, 0x89, 0x75, 0x04, 0x00, 0x00, 0xC2, 0x00, 0x42 };
+    bytes incomplete(s_incomplete, s_incomplete + 9), data = make_data(100000, 18), comp = compress(data, 6, MZ_DEFAULT_WINDOW_BITS), dest(data.size());
+    mmz_ulong dest_len = (mmz_ulong)dest.size(), src_len = 9, skip = ~(mmz_ulong)0;
+    mmz_stream stream;
+    mmz_index *pIndex = NULL;
+    uint i;
+    CHECK(mmz_validate(&dest_len, s_incomplete, &src_len, MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_DATA_ERROR);
+    dest_len = (mmz_ulong)dest.size();
+    CHECK(mmz_uncompress(dest.data(), &dest_len, s_incomplete, 9) == MMZ_DATA_ERROR);
+    memset(&stream, 0, sizeof(stream));
+    CHECK(mmz_inflateInit(&stream) == MMZ_OK);
+    stream.next_in = s_incomplete; stream.avail_in = 9;
+    CHECK(mmz_inflateSkip(&stream, &skip, MMZ_FINISH) == MMZ_DATA_ERROR);
+    mmz_inflateEnd(&stream);
+    CHECK(mmz_index_build(&pIndex, read_mem, &incomplete, MMZ_DEFAULT_WINDOW_BITS, 1000) == MMZ_DATA_ERROR);
+    // Truncated streams fail under MMZ_FINISH.
+    dest_len = (mmz_ulong)dest.size();
+    CHECK(mmz_uncompress(dest.data(), &dest_len, comp.data(), (mmz_ulong)comp.size() / 2) == MMZ_DATA_ERROR);
+    dest_len = (mmz_ulong)dest.size(); src_len = (mmz_ulong)comp.size() - 1;
+    CHECK(mmz_validate(&dest_len, comp.data(), &src_len, MMZ_DEFAULT_WINDOW_BITS, 0) == MMZ_DATA_ERROR);
+    // Damaged streams must fail or decode consistently, whichever decoder runs.
+    s_seed = 19;
+    for (i = 0; i < 300; i++) {
+        bytes bad = comp;
+        mmz_ulong out_len = (mmz_ulong)dest.size(), valid_len = 0, in_len;
+        size_t par_len = dest.size(), par_in;
+        int status, valid_status, par_status;
+        bad[2 + rnd() % (MMZ_MIN(bad.size(), (size_t)2000) - 2)] ^= (uint8)(1 + rnd() % 255);
+        in_len = (mmz_ulong)bad.size(); par_in = bad.size();
+        status = mmz_uncompress(dest.data(), &out_len, bad.data(), (mmz_ulong)bad.size());
+        valid_status = mmz_validate(&valid_len, bad.data(), &in_len, MMZ_DEFAULT_WINDOW_BITS, 0);
+        CHECK((status == MMZ_OK) == (valid_status == MMZ_OK));
+        if (status == MMZ_OK) CHECK(out_len == valid_len);
+        par_status = mmz_uncompress_parallel(dest.data(), &par_len, bad.data(), &par_in, MMZ_DEFAULT_WINDOW_BITS, 2);
+        CHECK((par_status == MMZ_OK) == (valid_status == MMZ_OK) || (par_status == MMZ_BUF_ERROR));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    (void)argc, (void)argv;
+    test_uncompress_levels();
+    test_fixed_blocks();
+    test_streaming_random_chunks();
+    test_reset();
+    test_window_bits();
+    test_gzip();
+    test_multi_member();
+    test_skip_validate();
+    test_index();
+    test_parallel();
+    test_batch();
+    test_dictionary();
+    test_mmz_deflate();
+    test_bt_and_optimal();
+    test_arena();
+    test_adler32();
+    test_corrupt_input();
+    mmz_inflate_pool_release();
+    if (s_num_failed) {
+        printf("%d checks failed\n", s_num_failed);
+        return EXIT_FAILURE;
+    }
+    printf("All tests passed\n");
+    return EXIT_SUCCESS;
+}